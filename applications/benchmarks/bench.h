@@ -1,29 +1,296 @@
 #include <sstream>
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <math.h>
 #include <assert.h>
-#include <sys/time.h>
-#include <ctime>
 
 #include "plumbing/defs.h"
+#include "plumbing/cmdline.h"
 #include "datatypes/matrix.h"
-#include "datatypes/sun.h"
+#include "datatypes/sun_matrix.h"
 //#include "datatypes/wilson_vector.h"
 #include "plumbing/field.h"
 //#include "dirac/staggered.h"
 //#include "dirac/wilson.h"
 
-// Minimum time to run each benchmark
-// in microseconds
-constexpr double mintime = 1000;
+#if defined(OPENMP)
+#include <omp.h>
+#endif
 
-// Direct output to stdout
-// std::ostream &hila::out = std::cout;
+///////////////////////////////////////////////////////////////////////////////
+/// Benchmark harness.  A kernel is timed with the loop
+///
+///     hila::bench bench("bench_field");
+///     for (bench.start("double multiply", 3 * sizeof(double), 1); bench.running();) {
+///         dfield1[ALL] = dfield2[X] * dfield3[X];
+///     }
+///     ...
+///     bench.report();
+///
+/// The loop body is the kernel.  It is first run -bench-warmup times, and the warm-up
+/// time fixes how many calls go into one sample.  Then -bench-samples samples are
+/// timed, together taking about -bench-time seconds.  The result is the median time
+/// per call and its median absolute deviation (MAD) over the samples.  The bytes and
+/// flops given to start() are per lattice site and call, and give GB/s and GFLOP/s.
+///
+/// The site loops stay in the caller, so that hilapp sees them as normal loops.
+///
+/// Command line (call hila::bench::add_flags() before hila::initialize()):
+///     -bench-lattice <nx> <ny> ..   lattice size, default given in the program
+///     -bench-samples <n>            number of timed samples (default 9)
+///     -bench-warmup <n>             number of warm-up calls (default 2)
+///     -bench-time <seconds>         target time of all samples of a kernel (default 1)
+///     -bench-json <file>            write the results to JSON file
+///     -bench-only <substring>       run only kernels whose name contains the string
+///
+/// Sweeps over lattice size and rank count are run by benchmark.sh, and
+/// bench_compare.py compares the JSON files against a stored baseline.
+///////////////////////////////////////////////////////////////////////////////
 
-// Calculate time difference in milliseconds
-static inline double timediff(timeval start, timeval end) {
-    long long t1 = (long long)(start.tv_usec) + 1000000 * (long long)(start).tv_sec;
-    long long t2 = (long long)(end.tv_usec) + 1000000 * (long long)(end).tv_sec;
-    return 1e-3 * (double)(t2 - t1);
-}
+namespace hila {
+
+class bench {
+  public:
+    struct result {
+        std::string name;
+        int samples;
+        int64_t calls_per_sample;
+        double median, mad, min, max; // seconds per call
+        double gbytes_per_s, gflops_per_s;
+    };
+
+  private:
+    std::string suite;
+    std::vector<result> results;
+
+    // options
+    int n_samples = 9;
+    int n_warmup = 2;
+    double target_time = 1.0;
+    std::string json_file;
+    std::string only;
+
+    // state of the kernel being timed
+    enum class phase { idle, warmup, sampling };
+    phase ph = phase::idle;
+    std::string name;
+    double bytes_per_site, flops_per_site;
+    int64_t calls, batch;
+    double t0;
+    std::vector<double> times;
+
+    static double median_of(std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        int n = v.size();
+        if (n == 0)
+            return 0;
+        return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+    }
+
+    static std::string json_escape(const std::string &s) {
+        std::string r;
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                r += '\\';
+            r += c;
+        }
+        return r;
+    }
+
+    static const char *target_name() {
+#if defined(CUDA)
+        return "cuda";
+#elif defined(HIP)
+        return "hip";
+#elif defined(AVX)
+        return "avx";
+#else
+        return "cpu";
+#endif
+    }
+
+    static int n_threads() {
+#if defined(OPENMP)
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    void finish_kernel() {
+        result r;
+        r.name = name;
+        r.samples = times.size();
+        r.calls_per_sample = batch;
+        r.median = median_of(times);
+        std::vector<double> dev(times.size());
+        for (int i = 0; i < times.size(); i++)
+            dev[i] = fabs(times[i] - r.median);
+        r.mad = median_of(dev);
+        r.min = *std::min_element(times.begin(), times.end());
+        r.max = *std::max_element(times.begin(), times.end());
+        double vol = lattice.volume();
+        r.gbytes_per_s = (r.median > 0) ? 1e-9 * bytes_per_site * vol / r.median : 0;
+        r.gflops_per_s = (r.median > 0) ? 1e-9 * flops_per_site * vol / r.median : 0;
+        results.push_back(r);
+
+        hila::out0 << std::left << std::setw(40) << r.name << std::right << std::fixed
+                   << std::setprecision(4) << std::setw(12) << 1e3 * r.median << " ms  +- "
+                   << std::setw(9) << 1e3 * r.mad << " ms" << std::setprecision(2)
+                   << std::setw(10) << r.gbytes_per_s << " GB/s" << std::setw(10)
+                   << r.gflops_per_s << " GFLOP/s\n";
+        hila::out0 << std::defaultfloat;
+
+        ph = phase::idle;
+    }
+
+  public:
+    /// Command line flags of the harness, call before hila::initialize()
+    static void add_flags() {
+        hila::cmdline.add_flag("-bench-lattice", "lattice size of the benchmark",
+                               "<n_x> <n_y> ...");
+        hila::cmdline.add_flag("-bench-samples", "number of timed samples per kernel (default 9)",
+                               "<n>", 1);
+        hila::cmdline.add_flag("-bench-warmup", "number of warm-up calls per kernel (default 2)",
+                               "<n>", 1);
+        hila::cmdline.add_flag("-bench-time", "target time of one kernel in seconds (default 1)",
+                               "<seconds>", 1);
+        hila::cmdline.add_flag("-bench-json", "write benchmark results to JSON file",
+                               "<filename>", 1);
+        hila::cmdline.add_flag("-bench-only", "run only kernels whose name contains <string>",
+                               "<string>", 1);
+    }
+
+    /// Lattice size from -bench-lattice, or the default.  A single number gives
+    /// the same size to all directions
+    static CoordinateVector lattice_size(const CoordinateVector &def) {
+        CoordinateVector size = def;
+        int n = hila::cmdline.flag_set("-bench-lattice");
+        if (n == 1) {
+            foralldir(d) size[d] = hila::cmdline.get_int("-bench-lattice");
+        } else if (n == NDIM) {
+            foralldir(d) size[d] = hila::cmdline.get_int("-bench-lattice", d);
+        } else if (n != 0) {
+            hila::out0 << "-bench-lattice needs 1 or " << NDIM << " sizes\n";
+            hila::finishrun();
+        }
+        return size;
+    }
+
+    bench(const std::string &suite_name) : suite(suite_name) {
+        if (hila::cmdline.flag_present("-bench-samples"))
+            n_samples = std::max<long>(1, hila::cmdline.get_int("-bench-samples"));
+        if (hila::cmdline.flag_present("-bench-warmup"))
+            n_warmup = std::max<long>(1, hila::cmdline.get_int("-bench-warmup"));
+        if (hila::cmdline.flag_present("-bench-time"))
+            target_time = hila::cmdline.get_double("-bench-time");
+        if (hila::cmdline.flag_present("-bench-json"))
+            json_file = hila::cmdline.get_string("-bench-json");
+        if (hila::cmdline.flag_present("-bench-only"))
+            only = hila::cmdline.get_string("-bench-only");
+
+        hila::print_dashed_line("Benchmark " + suite);
+        hila::out0 << n_samples << " samples, " << n_warmup << " warm-up calls, target time "
+                   << target_time << " s per kernel\n";
+        hila::out0 << std::left << std::setw(40) << "kernel" << std::right << std::setw(15)
+                   << "median" << std::setw(15) << "MAD" << '\n';
+    }
+
+    /// Start timing kernel.  Bytes and flops are per lattice site and per call
+    void start(const std::string &kernel_name, double bytes = 0, double flops = 0) {
+        name = kernel_name;
+        bytes_per_site = bytes;
+        flops_per_site = flops;
+        times.clear();
+        calls = 0;
+        batch = n_warmup;
+        if (only.size() > 0 && name.find(only) == std::string::npos) {
+            ph = phase::idle;
+            return;
+        }
+        ph = phase::warmup;
+        hila::synchronize();
+        t0 = hila::gettime();
+    }
+
+    /// Loop condition: returns true while the kernel should be called again
+    bool running() {
+        if (ph == phase::idle)
+            return false;
+
+        if (calls < batch) {
+            calls++;
+            return true;
+        }
+
+        // batch of calls done
+        hila::synchronize();
+        double t = hila::gettime() - t0;
+
+        if (ph == phase::warmup) {
+            // calls per sample from the warm-up time, decided on rank 0
+            double per_call = t / n_warmup;
+            double sample_time = target_time / n_samples;
+            batch = (per_call > 0) ? (int64_t)(sample_time / per_call) : 1;
+            batch = hila::broadcast(std::max<int64_t>(batch, 1));
+            ph = phase::sampling;
+        } else {
+            times.push_back(t / batch);
+            if (times.size() >= n_samples) {
+                finish_kernel();
+                return false;
+            }
+        }
+
+        calls = 1;
+        hila::synchronize();
+        t0 = hila::gettime();
+        return true;
+    }
+
+    const std::vector<result> &get_results() const {
+        return results;
+    }
+
+    /// Print the closing line and write the JSON file, if requested
+    void report() const {
+        hila::print_dashed_line();
+        if (json_file.size() == 0 || hila::myrank() != 0)
+            return;
+
+        std::ofstream out(json_file, std::ios::out | std::ios::trunc);
+        if (out.fail()) {
+            hila::out0 << "Cannot open benchmark output file " << json_file << '\n';
+            return;
+        }
+        out << std::setprecision(8);
+        out << "{\n  \"suite\": \"" << json_escape(suite) << "\",\n";
+#if defined(GIT_SHA_VALUE)
+#define bench_xstr(s) bench_str(s)
+#define bench_str(s) #s
+        out << "  \"git\": \"" << bench_xstr(GIT_SHA_VALUE) << "\",\n";
+#endif
+        out << "  \"target\": \"" << target_name() << "\",\n";
+        out << "  \"ndim\": " << NDIM << ",\n  \"lattice\": [";
+        foralldir(d) out << (d > 0 ? ", " : "") << lattice.size(d);
+        out << "],\n  \"ranks\": " << hila::number_of_nodes() << ",\n";
+        out << "  \"threads\": " << n_threads() << ",\n";
+        out << "  \"kernels\": [";
+        for (int i = 0; i < results.size(); i++) {
+            const result &r = results[i];
+            out << (i > 0 ? ",\n" : "\n") << "    {\"name\": \"" << json_escape(r.name)
+                << "\", \"samples\": " << r.samples << ", \"calls_per_sample\": "
+                << r.calls_per_sample << ", \"median_s\": " << r.median
+                << ", \"mad_s\": " << r.mad << ", \"min_s\": " << r.min
+                << ", \"max_s\": " << r.max << ", \"gbytes_per_s\": " << r.gbytes_per_s
+                << ", \"gflops_per_s\": " << r.gflops_per_s << "}";
+        }
+        out << "\n  ]\n}\n";
+        hila::out0 << "Benchmark results written to " << json_file << '\n';
+    }
+};
+
+} // namespace hila
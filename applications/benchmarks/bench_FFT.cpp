@@ -10,62 +10,54 @@
 const CoordinateVector latsize = {32, 32, 32, 32};
 
 int main(int argc, char **argv) {
-    int n_runs = 1;
-    struct timeval start, end;
-    double timing;
 
+    hila::bench::add_flags();
     hila::initialize(argc, argv);
 
-    lattice.setup(latsize);
+    lattice.setup(hila::bench::lattice_size(latsize));
 
     hila::seed_random(SEED);
 
+    hila::bench bench("bench_FFT");
+
     using T = Matrix<2, 2, Complex<double>>;
     using Tf = Matrix<2, 2, Complex<float>>;
 
+    // NDIM 1-dimensional complex FFTs of 4 components, 5 n log2(n) flops each
+    double fft_flops = 0;
+    foralldir(d) fft_flops += 4 * 5 * log2((double)lattice.size(d));
+
     Field<T> d, d2;
 
     // Generate a random field
-    onsites(ALL) { d[X].random(); }
+    onsites(ALL) {
+        d[X].random();
+    }
 
     // Run once to make sure everything is set up
     FFT_field(d, d2);
 
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            FFT_field(d, d2);
-        }
-        // // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("FFT double precision", 2 * NDIM * sizeof(T), fft_flops);
+         bench.running();) {
+        FFT_field(d, d2);
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "FFT double precision : " << timing << " ms \n";
 
     // Generate a random field
     Field<Tf> f, f2;
 
     // Generate a random field
-    onsites(ALL) { f[X].random(); }
-
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            FFT_field(f, f2);
-        }
-        // // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    onsites(ALL) {
+        f[X].random();
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "FFT single precision : " << timing << " ms \n";
+
+    FFT_field(f, f2);
+
+    for (bench.start("FFT single precision", 2 * NDIM * sizeof(Tf), fft_flops);
+         bench.running();) {
+        FFT_field(f, f2);
+    }
+
+    bench.report();
 
     hila::finishrun();
 }
@@ -0,0 +1,112 @@
+#include "bench.h"
+#include "plumbing/coordinates.h"
+
+#define N 3
+
+#ifndef SEED
+#define SEED 100
+#endif
+
+const CoordinateVector latsize = {32, 32, 32, 32};
+
+///////////////////////////////////////
+// benchmark communication: nearest neighbour
+// gathers, reductions and field I/O
+///////////////////////////////////////
+
+int main(int argc, char **argv) {
+
+    hila::bench::add_flags();
+    hila::initialize(argc, argv);
+
+    lattice.setup(hila::bench::lattice_size(latsize));
+
+    hila::seed_random(SEED);
+
+    hila::bench bench("bench_comm");
+
+    using mtype = SquareMatrix<N, Complex<double>>;
+
+    Field<mtype> matrix1, matrix2;
+    Field<double> dfield;
+    onsites(ALL) {
+        matrix1[X].random();
+        dfield[X] = hila::random();
+    }
+
+    // single direction gather, halo only
+    for (bench.start("Matrix gather e_x", sizeof(mtype)); bench.running();) {
+        matrix1.mark_changed(ALL);
+        matrix1.gather(e_x, ALL);
+    }
+
+    for (bench.start("Matrix gather -e_x", sizeof(mtype)); bench.running();) {
+        matrix1.mark_changed(ALL);
+        matrix1.gather(-e_x, ALL);
+    }
+
+    // last direction is usually the one divided first
+    for (bench.start("Matrix gather last direction", sizeof(mtype)); bench.running();) {
+        matrix1.mark_changed(ALL);
+        matrix1.gather((Direction)(NDIM - 1), ALL);
+    }
+
+    // gather and copy of the whole field
+    for (bench.start("Matrix shift copy", 2 * sizeof(mtype)); bench.running();) {
+        matrix1.mark_changed(ALL);
+        matrix2[ALL] = matrix1[X + e_x];
+    }
+
+    // all directions, started together
+    for (bench.start("Matrix gather all directions", NDIRS * sizeof(mtype)); bench.running();) {
+        matrix1.mark_changed(ALL);
+        for (int dir = 0; dir < NDIRS; dir++) {
+            matrix1.start_gather((Direction)dir, ALL);
+        }
+        for (int dir = 0; dir < NDIRS; dir++) {
+            matrix1.gather((Direction)dir, ALL);
+        }
+    }
+
+    // reductions
+    double dsum;
+    for (bench.start("double sum reduction", sizeof(double), 1); bench.running();) {
+        dsum = 0;
+        onsites(ALL) {
+            dsum += dfield[X];
+        }
+    }
+
+    mtype msum;
+    for (bench.start("Matrix sum reduction", sizeof(mtype), 2 * N * N); bench.running();) {
+        msum = 0;
+        onsites(ALL) {
+            msum += matrix1[X];
+        }
+    }
+
+    for (bench.start("Field::sum()", sizeof(mtype), 2 * N * N); bench.running();) {
+        msum = matrix1.sum();
+    }
+
+    for (bench.start("double max", sizeof(double), 1); bench.running();) {
+        dsum = dfield.max();
+    }
+
+    // I/O through the filesystem
+    std::string filename = "bench_comm_field.tmp";
+    for (bench.start("Matrix field write", sizeof(mtype)); bench.running();) {
+        matrix1.write(filename);
+    }
+
+    for (bench.start("Matrix field read", sizeof(mtype)); bench.running();) {
+        matrix2.read(filename);
+    }
+
+    if (hila::myrank() == 0)
+        std::remove(filename.c_str());
+
+    bench.report();
+
+    hila::finishrun();
+}
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Compare benchmark JSON results (written with -bench-json) against a baseline.
+
+Usage: bench_compare.py [options] <baseline> <current>
+
+<baseline> and <current> are JSON files or directories of them.  Kernels are
+matched by suite, kernel name, lattice size, rank and thread count and target.
+A kernel is flagged as a regression if its median time is more than the
+threshold slower than the baseline, and the difference exceeds the noise,
+estimated from the median absolute deviations.  Exit status is 1 if any
+regressions are found.
+"""
+
+import argparse
+import glob
+import json
+import math
+import os
+import sys
+
+
+def load(path):
+    files = sorted(glob.glob(os.path.join(path, "*.json"))) if os.path.isdir(path) else [path]
+    records = {}
+    for fn in files:
+        with open(fn) as f:
+            run = json.load(f)
+        for k in run["kernels"]:
+            key = (run["suite"], k["name"], tuple(run["lattice"]), run["ranks"], run["threads"],
+                   run["target"])
+            records[key] = k
+    return records
+
+
+def key_name(key):
+    suite, name, lat, ranks, threads, target = key
+    return "%s: %s [%s, %d ranks, %d threads, %s]" % (
+        suite, name, "x".join(str(l) for l in lat), ranks, threads, target)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("baseline")
+    ap.add_argument("current")
+    ap.add_argument("-t", "--threshold", type=float, default=0.05,
+                    help="relative slowdown to flag (default 0.05)")
+    ap.add_argument("-k", "--noise", type=float, default=3.0,
+                    help="required difference in units of the combined MAD (default 3)")
+    ap.add_argument("-a", "--all", action="store_true", help="print all kernels, not only changes")
+    args = ap.parse_args()
+
+    base = load(args.baseline)
+    cur = load(args.current)
+
+    regressions = 0
+    improvements = 0
+    compared = 0
+    for key in sorted(cur.keys()):
+        if key not in base:
+            if args.all:
+                print("NEW         %s" % key_name(key))
+            continue
+        compared += 1
+        b = base[key]
+        c = cur[key]
+        ratio = c["median_s"] / b["median_s"] if b["median_s"] > 0 else 1.0
+        # MAD -> standard deviation for normal distribution
+        noise = args.noise * 1.4826 * math.hypot(b["mad_s"], c["mad_s"])
+        diff = c["median_s"] - b["median_s"]
+
+        if ratio > 1 + args.threshold and diff > noise:
+            status = "REGRESSION"
+            regressions += 1
+        elif ratio < 1 - args.threshold and -diff > noise:
+            status = "faster"
+            improvements += 1
+        else:
+            status = "ok"
+
+        if status != "ok" or args.all:
+            print("%-11s %s\n            %.4g ms -> %.4g ms (%+.1f%%), GB/s %.3g -> %.3g"
+                  % (status, key_name(key), 1e3 * b["median_s"], 1e3 * c["median_s"],
+                     100 * (ratio - 1), b["gbytes_per_s"], c["gbytes_per_s"]))
+
+    missing = [k for k in base if k not in cur]
+    print("%d kernels compared, %d regressions, %d faster, %d in baseline only"
+          % (compared, regressions, improvements, len(missing)))
+
+    return 1 if regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -11,130 +11,88 @@
 const CoordinateVector latsize = {32, 32, 32, 32};
 
 int main(int argc, char **argv) {
-    int n_runs = 1;
-    double msecs;
-    struct timeval start, end;
-    double timing;
-    double sum;
-    float fsum;
 
+    hila::bench::add_flags();
     hila::initialize(argc, argv);
 
-    lattice.setup(latsize);
+    lattice.setup(hila::bench::lattice_size(latsize));
 
     hila::seed_random(SEED);
 
+    hila::bench bench("bench_fermion");
+
     // Define a gauge matrix
     Field<SU<N, double>> U[NDIM];
     Field<SU_vector<N, double>> sunvec1, sunvec2;
 
     foralldir(d) {
-        onsites(ALL) { U[d][X].random(); }
+        onsites(ALL) {
+            U[d][X].random();
+        }
     }
     onsites(ALL) {
         sunvec1[X].gaussian_random();
         sunvec2[X].gaussian_random();
     }
 
-    // Time staggered Dirac operator
-    timing = 0;
-
     using sunvec = SU_vector<N, double>;
     using sunmat = SU<N, double>;
     using dirac_stg = dirac_staggered<sunmat>;
     dirac_stg D_staggered(0.1, U);
     D_staggered.apply(sunvec1, sunvec2);
 
-    // synchronize();
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            sunvec1.mark_changed(ALL); // Ensure communication is included
-            D_staggered.apply(sunvec1, sunvec2);
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    // Per site: 2*NDIM matrix-vector products and their sum, reading the links
+    // and neighbour vectors once
+    constexpr double stg_flops = 2 * NDIM * (8 * N * N - 2 * N) + 2 * NDIM * 2 * N;
+    constexpr double stg_bytes = 2 * NDIM * sizeof(sunmat) + (2 * NDIM + 2) * sizeof(sunvec);
+
+    // Time staggered Dirac operator
+    for (bench.start("Dirac staggered", stg_bytes, stg_flops); bench.running();) {
+        sunvec1.mark_changed(ALL); // Ensure communication is included
+        D_staggered.apply(sunvec1, sunvec2);
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Dirac staggered: " << timing << "ms \n";
 
     // Conjugate gradient step
     CG<dirac_stg> stg_inverse(D_staggered, 1e-5, 1);
-    timing = 0;
     sunvec1[ALL] = 0;
     stg_inverse.apply(sunvec2, sunvec1);
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            sunvec1[ALL] = 0;
-            stg_inverse.apply(sunvec2, sunvec1);
-        }
-
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("Staggered CG iteration", 2 * stg_bytes, 2 * stg_flops); bench.running();) {
+        sunvec1[ALL] = 0;
+        stg_inverse.apply(sunvec2, sunvec1);
     }
 
-    timing = timing / (double)n_runs;
-    hila::out0 << "Staggered CG: " << timing << "ms / iteration\n";
-
     Field<Wilson_vector<N, double>> wvec1, wvec2;
     onsites(ALL) {
         wvec1[X].gaussian_random();
         wvec2[X].gaussian_random();
     }
-    // Time staggered Dirac operator
-    timing = 0;
-    // printf("node %d, dirac_staggered 0\n", hila::myrank());
+
     using Dirac_Wilson = Dirac_Wilson_evenodd<sunmat>;
     Dirac_Wilson D_wilson(0.05, U);
     D_wilson.apply(wvec1, wvec2);
 
-    // synchronize();
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            wvec1.mark_changed(ALL); // Ensure communication is included
-            D_wilson.apply(wvec1, wvec2);
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    // Per site: 2*NDIM half spinor projections, SU(N) products and reconstructions
+    constexpr double wil_flops = 2 * NDIM * (2 * (8 * N * N - 2 * N) + 12 * N) + 8 * N;
+    constexpr double wil_bytes =
+        2 * NDIM * sizeof(sunmat) + (2 * NDIM + 2) * sizeof(Wilson_vector<N, double>);
+
+    // Time Wilson Dirac operator
+    for (bench.start("Dirac Wilson", wil_bytes, wil_flops); bench.running();) {
+        wvec1.mark_changed(ALL); // Ensure communication is included
+        D_wilson.apply(wvec1, wvec2);
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Dirac Wilson: " << timing << "ms \n";
 
-    // Conjugate gradient step (set accuracy=1 to run only 1 step)
+    // Conjugate gradient, 5 iterations
     CG<Dirac_Wilson> w_inverse(D_wilson, 1e-12, 5);
-    timing = 0;
     wvec1[ALL] = 0;
     w_inverse.apply(wvec2, wvec1);
-    for (n_runs = 1; timing < mintime;) {
-
-        n_runs *= 2;
-
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            wvec1[ALL] = 0;
-            w_inverse.apply(wvec2, wvec1);
-        }
-
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("Dirac Wilson CG 5 iterations", 10 * wil_bytes, 10 * wil_flops);
+         bench.running();) {
+        wvec1[ALL] = 0;
+        w_inverse.apply(wvec2, wvec1);
     }
 
-    timing = timing / (double)n_runs;
-    hila::out0 << "Dirac Wilson CG: " << timing << "ms / iteration\n";
+    bench.report();
 
     hila::finishrun();
 }
@@ -1,3 +1,4 @@
+#include "bench.h"
 #include "plumbing/coordinates.h"
 #include "dirac/conjugate_gradient.h"
 
@@ -7,22 +8,21 @@
 #define SEED 100
 #endif
 
-CoordinateVector latsize = {32, 32, 32, 32};
+const CoordinateVector latsize = {32, 32, 32, 32};
 
 int main(int argc, char **argv) {
-    int n_runs = 1;
-    double msecs;
-    struct timeval start, end;
-    double timing;
     double sum;
     float fsum;
 
+    hila::bench::add_flags();
     hila::initialize(argc, argv);
 
-    lattice.setup(latsize);
+    lattice.setup(hila::bench::lattice_size(latsize));
 
     hila::seed_random(SEED);
 
+    hila::bench bench("bench_field");
+
     Field<double> dfield1, dfield2, dfield3;
     Field<float> ffield1, ffield2, ffield3;
     onsites(ALL) {
@@ -38,65 +38,21 @@ int main(int argc, char **argv) {
     }
 
     // Benchmark simple scalar Field operation (Memory bandwith)
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            dfield1[ALL] = dfield2[X] * dfield3[X];
-        }
-        // // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("double multiply", 3 * sizeof(double), 1); bench.running();) {
+        dfield1[ALL] = dfield2[X] * dfield3[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Double multiply : " << timing << " ms \n";
 
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            dfield1[ALL] = dfield2[X] + dfield3[X];
-        }
-        // // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("double add", 3 * sizeof(double), 1); bench.running();) {
+        dfield1[ALL] = dfield2[X] + dfield3[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Double add : " << timing << " ms \n";
 
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            ffield1[ALL] = ffield2[X] * ffield3[X];
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("float multiply", 3 * sizeof(float), 1); bench.running();) {
+        ffield1[ALL] = ffield2[X] * ffield3[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Float multiply : " << timing << " ms \n";
 
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            ffield1[ALL] = ffield2[X] + ffield3[X];
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("float add", 3 * sizeof(float), 1); bench.running();) {
+        ffield1[ALL] = ffield2[X] + ffield3[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Float add : " << timing << " ms \n";
 
     Field<SquareMatrix<N, Complex<double>>> matrix1;
     Field<SquareMatrix<N, Complex<double>>> matrix2;
@@ -126,145 +82,64 @@ int main(int argc, char **argv) {
         fvector2[X].random();
     }
 
+    // complex N x N matrix product: N^3 complex multiply-adds
+    constexpr double mm_flops = 8 * N * N * N - 2 * N * N;
+    constexpr double mv_flops = 8 * N * N - 2 * N;
+    constexpr int dmat = sizeof(SquareMatrix<N, Complex<double>>);
+    constexpr int fmat = sizeof(SquareMatrix<N, Complex<float>>);
+    constexpr int dvec = sizeof(Vector<N, Complex<double>>);
+    constexpr int fvec = sizeof(Vector<N, Complex<float>>);
+
     // Interesting case of using the same memory three times
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            matrix1[ALL] = matrix1[X] * matrix1[X];
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("Matrix1 = Matrix1 * Matrix1", 2 * dmat, mm_flops); bench.running();) {
+        matrix1[ALL] = matrix1[X] * matrix1[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Matrix1 = Matrix1 * Matrix1 : " << timing << " ms \n";
 
     // Time MATRIX * MATRIX
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            matrix3[ALL] = matrix1[X] * matrix2[X];
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("Matrix * Matrix", 3 * dmat, mm_flops); bench.running();) {
+        matrix3[ALL] = matrix1[X] * matrix2[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Matrix * Matrix: " << timing << "ms \n";
 
-    // Time MATRIX * MATRIX
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            fmatrix3[ALL] = fmatrix1[X] * fmatrix2[X];
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("Single Precision Matrix * Matrix", 3 * fmat, mm_flops);
+         bench.running();) {
+        fmatrix3[ALL] = fmatrix1[X] * fmatrix2[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Single Precision Matrix * Matrix: " << timing << "ms \n";
 
     // Time VECTOR * MATRIX
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            vector2[ALL] = matrix1[X] * vector1[X];
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
+    for (bench.start("Vector * Matrix", dmat + 2 * dvec, mv_flops); bench.running();) {
+        vector2[ALL] = matrix1[X] * vector1[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Vector * Matrix: " << timing << " ms \n";
 
-    // Time VECTOR * MATRIX
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-        for (int i = 0; i < n_runs; i++) {
-            fvector2[ALL] = fmatrix1[X] * fvector1[X];
-        }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
-        // hila::out0 << "timing " << timing << '\n';
+    for (bench.start("Single Precision Vector * Matrix", fmat + 2 * fvec, mv_flops);
+         bench.running();) {
+        fvector2[ALL] = fmatrix1[X] * fvector1[X];
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Single Precision Vector * Matrix: " << timing << " ms \n";
 
     // Time VECTOR NORM
-    timing = sum = 0;
-    onsites(ALL) { // Warm up. Why does this affect the time?
-        sum += vector1[X].squarenorm();
-    }
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
-
+    for (bench.start("Vector square sum", dvec, 4 * N); bench.running();) {
         sum = 0;
-        for (int i = 0; i < n_runs; i++) {
-            onsites(ALL) { sum += vector1[X].squarenorm(); }
+        onsites(ALL) {
+            sum += vector1[X].squarenorm();
         }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Vector square sum: " << timing << " ms \n";
 
     // Time FLOAT VECTOR NORM
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
+    for (bench.start("Single Precision vector square sum", fvec, 4 * N); bench.running();) {
         fsum = 0;
-        for (int i = 0; i < n_runs; i++) {
-            onsites(ALL) { fsum += fvector1[X].squarenorm(); }
+        onsites(ALL) {
+            fsum += fvector1[X].squarenorm();
         }
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
     }
-    timing = timing / (double)n_runs;
-    hila::out0 << "Single Precision vector square sum: " << timing << " ms \n";
-
-    // Time COMMUNICATION of a MATRIX
-    timing = 0;
-    for (n_runs = 1; timing < mintime;) {
-        n_runs *= 2;
-        gettimeofday(&start, NULL);
 
-        for (int i = 0; i < n_runs; i++) {
-            matrix1.mark_changed(ALL);
-            for (int dir = 0; dir < NDIRS; dir++) {
-                matrix1.gather((Direction)dir, ALL);
-            }
+    // Time COMMUNICATION of a MATRIX, all directions
+    for (bench.start("Matrix nearest neighbour communication", NDIRS * dmat); bench.running();) {
+        matrix1.mark_changed(ALL);
+        for (int dir = 0; dir < NDIRS; dir++) {
+            matrix1.gather((Direction)dir, ALL);
         }
-
-        // synchronize();
-        gettimeofday(&end, NULL);
-        timing = timediff(start, end);
-        hila::broadcast(timing);
     }
-    timing = timing / 2 / NDIRS / (double)n_runs;
-    hila::out0 << "Matrix nearest neighbour communication: " << timing << " ms \n";
+
+    bench.report();
 
     hila::finishrun();
 }
@@ -1,46 +1,62 @@
 #!/bin/bash
+#
+# Build and run benchmarks, sweeping over lattice sizes and MPI rank counts.
+# Each run writes a JSON result file, which can be compared against a
+# stored baseline with bench_compare.py.
+#
+# Usage: ./benchmark.sh [options] [bench_field bench_comm ...]
+#   -a <arch>          make ARCH (default vanilla)
+#   -l "<L1> <L2> .."  lattice sizes, each run uses L^NDIM (default 32)
+#   -n "<n1> <n2> .."  MPI rank counts (default 1)
+#   -r "<runner>"      MPI launcher, rank count is appended (default "mpirun -n")
+#   -o <dir>           directory of the JSON results (default bench_results/json)
+#   -x "<args>"        extra arguments to the benchmark programs, e.g. "-bench-time 2"
+#
+# Example:
+#   ./benchmark.sh -l "16 24 32" -n "1 2 4 8" bench_field bench_fermion
+#   ./bench_compare.py bench_results/baseline bench_results/json
 
-export MAKEFILE=Makefile
-export RUNNER="mpirun -n 1"
+ARCH=vanilla
+SIZES="32"
+RANKS="1"
+RUNNER="mpirun -n"
+OUTDIR=bench_results/json
+EXTRA=""
 
-for arg in "$@"
-do
-  if [ "$1" = "CUDA" ]; then
-    shift
-    export MAKEFILE=Makefile_gpu
-    export RUNNER=
-  fi
-  if [ "$1" = "AVX" ]; then
-    shift
-    export MAKEFILE=Makefile_avx
-  fi
-  if [ "$1" = "MPI" ]; then
-    shift
-    if [ "$1" = "-n" ]; then
-      shift
-      export RUNNER="mpirun -n $1"
-      shift
-    else
-      export RUNNER=mpirun 
-    fi
-  fi
+while getopts "a:l:n:r:o:x:" opt; do
+  case $opt in
+    a) ARCH=$OPTARG ;;
+    l) SIZES=$OPTARG ;;
+    n) RANKS=$OPTARG ;;
+    r) RUNNER=$OPTARG ;;
+    o) OUTDIR=$OPTARG ;;
+    x) EXTRA=$OPTARG ;;
+    *) sed -n '2,18p' $0 ; exit 1 ;;
+  esac
 done
-
+shift $((OPTIND-1))
 
 # Get a list from command line arguments or list all benchmark files
 if [ "$#" -gt 0 ]; then
     benchmarks=( "$@" )
 else
-    benchmarks=$(ls bench_*.cpp  )
+    benchmarks=( $(ls bench_*.cpp) )
 fi
 
-make cleanall
-for benchfile in $benchmarks; do
+mkdir -p $OUTDIR
+
+for benchfile in "${benchmarks[@]}"; do
     benchmark="${benchfile%.*}"
-    echo make -j -f $MAKEFILE -s ${benchmark}.exe
-    make -j -f $MAKEFILE -s ${benchmark}.exe 2>/dev/null
-    echo ${RUNNER} ./${benchmark}.exe
-    ${RUNNER} ./${benchmark}.exe 
+    echo make -j ARCH=$ARCH ${benchmark}
+    make -j ARCH=$ARCH ${benchmark} || exit 1
+
+    for L in $SIZES; do
+        for n in $RANKS; do
+            json=$OUTDIR/${benchmark}_L${L}_n${n}.json
+            echo ${RUNNER} ${n} build/${benchmark} -bench-lattice ${L} -bench-json ${json} ${EXTRA}
+            ${RUNNER} ${n} build/${benchmark} -bench-lattice ${L} -bench-json ${json} ${EXTRA}
+        done
+    done
 done
 
 exit 0
@@ -0,0 +1,59 @@
+#include "hila.h"
+#include "tools/multispin.h"
+
+// Multispin coded version of ising.cpp: 64 independent replicas in one Field<SpinWord>
+
+// Define some parameters for the simulation
+double beta = 0.44;
+int n_measurements = 100;
+int n_updates_per_measurement = 10;
+long seed = 123456;
+int NX = 64, NY = 64;
+int log_level = 2;
+
+int main(int argc, char **argv) {
+    // Basic setup
+    const CoordinateVector nd = {NX, NY};
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    // Set verbosity level
+    hila::log.set_verbosity(log_level);
+
+    // 64 spins per site
+    Field<SpinWord> spin;
+
+    hila::seed_random(seed);
+
+    // Acceptance table for the Metropolis update
+    hila::msc_table table(beta, hila::msc_update::metropolis);
+
+    // independent random start for all replicas
+    hila::msc_set_random(spin);
+
+    static hila::timer update_timer("MSC update");
+
+    // Run update-measure loop
+    for (int i = 0; i < n_measurements; i++) {
+
+        update_timer.start();
+        for (int j = 0; j < n_updates_per_measurement; j++) {
+            hila::msc_sweep(spin, table);
+        }
+        update_timer.stop();
+
+        // Measure magnetisation and energy, averaged over replicas
+        std::vector<double> mag, energy;
+        hila::msc_measure(spin, mag, energy);
+
+        double absm = 0, e = 0;
+        for (int r = 0; r < 64; r++) {
+            absm += fabs(mag[r]);
+            e += energy[r];
+        }
+        hila::log << "|Magnetisation| " << absm / 64 << " energy " << e / 64 << "\n";
+    }
+
+    hila::finishrun();
+    return 0;
+}
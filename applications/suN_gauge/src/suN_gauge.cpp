@@ -12,6 +12,7 @@
 #include "gauge/stout_smear.h"
 #include "gauge/sun_heatbath.h"
 #include "gauge/sun_overrelax.h"
+#include "gauge/staple_update.h"
 #include "tools/checkpoint.h"
 
 
@@ -86,8 +87,8 @@ void update(GaugeField<group> &U, const parameters &p, bool relax) {
 
 /**
  * @brief Wrapper function to updated GaugeField per direction
- * @details Computes first staplesum, then uses computed result to evolve GaugeField either with
- * over relaxation or heat bath
+ * @details Evolves GaugeField either with over relaxation or heat bath, computing the
+ * staple sum in the same site loop (staple_update)
  *
  * @tparam group
  * @param U GaugeField to evolve
@@ -102,34 +103,15 @@ void update_parity_dir(GaugeField<group> &U, const parameters &p, Parity par, Di
 
     static hila::timer hb_timer("Heatbath");
     static hila::timer or_timer("Overrelax");
-    static hila::timer staples_timer("Staplesum");
-
-    Field<group> staples;
-
-    staples_timer.start();
-
-    staplesum(U, staples, d, par);
-    staples_timer.stop();
 
+    // staple sum is fused into the update loop
     if (relax) {
-
         or_timer.start();
-
-        onsites(par) {
-#ifdef SUN_OVERRELAX_dFJ
-            suN_overrelax_dFJ(U[d][X], staples[X], p.beta);
-#else
-            suN_overrelax(U[d][X], staples[X]);
-#endif
-        }
+        staple_update(U, d, par, p.beta, true);
         or_timer.stop();
-
     } else {
-
         hb_timer.start();
-        onsites(par) {
-            suN_heatbath(U[d][X], staples[X], p.beta);
-        }
+        staple_update(U, d, par, p.beta, false);
         hb_timer.stop();
     }
 }
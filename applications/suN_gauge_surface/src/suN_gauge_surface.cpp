@@ -5,6 +5,7 @@
 
 #include "gauge/sun_heatbath.h"
 #include "gauge/sun_overrelax.h"
+#include "gauge/staple_update.h"
 #include "checkpoint.h"
 
 #include <fftw3.h>
@@ -487,13 +488,24 @@ void update_parity_dir(GaugeField<group> &U, const parameters &p, Parity par, Di
     static hila::timer or_timer("Overrelax");
     static hila::timer staples_timer("Staplesum");
 
+    if (p.deltab == 0) {
+        // staple sum is fused into the update loop
+        if (relax) {
+            or_timer.start();
+            staple_update(U, d, par, p.beta, true);
+            or_timer.stop();
+        } else {
+            hb_timer.start();
+            staple_update(U, d, par, p.beta, false);
+            hb_timer.stop();
+        }
+        return;
+    }
+
     Field<group> staples;
 
     staples_timer.start();
-    if (p.deltab != 0)
-        staplesum_db(U, staples, d, par, p.deltab);
-    else
-        staplesum(U, staples, d, par);
+    staplesum_db(U, staples, d, par, p.deltab);
     staples_timer.stop();
 
     if (relax) {
@@ -1,6 +1,7 @@
 #include "hila.h"
 #include "gauge/staples.h"
 #include "gauge/degauss.h"
+#include "gauge/realtime_evolution.h"
 
 #ifndef NSU
     #error "!!! Specify which SU(N) in Makefile: eg. -DNSU=3"
@@ -11,33 +12,6 @@ using SUN = SU<NSU, double>;
 // Output stream for results
 std::ofstream measureFile;
 
-///////////////////////////////////////////////////////////////////////////////////////////////
-/* Hamiltonian time evolution for gauge and electric fields. 'delta' is the time difference. */
-template <typename group>
-void update_E(const GaugeField<group> &U, VectorField<Algebra<group>> &E,
-              double delta) {
-
-    Field<group> staple;
-
-    foralldir (d) {
-        staplesum(U, staple, d);
-
-        onsites (ALL) {
-            E[d][X] -= delta * (U[d][X] * staple[X].dagger()).project_to_algebra();
-        }
-    }
-}
-
-template <typename group>
-void update_U(GaugeField<group> &U, const VectorField<Algebra<group>> &E,
-              double delta) {
-
-    foralldir (d) {
-        onsites (ALL)
-            U[d][X] = exp(E[d][X] * delta) * U[d][X];
-    }
-}
-
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename group>
@@ -145,6 +119,16 @@ void calc_topoCharge(const GaugeField<group> &U, const VectorField<Algebra<group
 
 static double degauss_quality = 1e-12;
 
+// Integration scheme of the time evolution, set from the parameter file
+static int evolution_scheme = 0;
+
+template <typename group>
+realtime_evolution<group> make_evolution() {
+    realtime_evolution<group> evol;
+    evol.scheme = static_cast<typename realtime_evolution<group>::integrator>(evolution_scheme);
+    return evol;
+}
+
 // Do the measurements. Here 't' labels the Hamiltonian time 
 template <typename group>
 void measure_stuff(GaugeField<group> &U, VectorField<Algebra<group>> &E, int trajectory, double t) {
@@ -159,9 +143,7 @@ void measure_stuff(GaugeField<group> &U, VectorField<Algebra<group>> &E, int tra
     // total energy ("action") times g^2 a T
     double energy = e2 + 2.0 * plaq;
 
-    Field<Algebra<group>> g;
-    get_gauss_violation(U, E, g);
-    auto viol = g.squarenorm();
+    auto viol = gauss_violation_squarenorm(U, E);
 
     /* Measure 'improved' or 'symmetrized' charge density: The way E_i appears in the EOM suggests
     * that we should identify E_i(x) as living at link midpoint, while the mag. field B_i(x) is local to x.
@@ -206,16 +188,8 @@ void thermalize(GaugeField<group> &U, VectorField<Algebra<group>> &E, double g2T
 
         degauss(U, E, degauss_quality);
 
-        // 1/2 timestep for U first
-        update_U(U, E, dt / 2);
-        // do 1 time unit of evolution with leapfrog
-        for (int steps = 0; steps < 1.0 / dt - 1; steps++) {
-            update_E(U, E, dt);
-            update_U(U, E, dt);
-        }
-        // and bring U and E to the same time value
-        update_E(U, E, dt);
-        update_U(U, E, dt / 2);
+        // do 1 time unit of evolution
+        make_evolution<group>().evolve(U, E, dt, (int)std::ceil(1.0 / dt - 1) + 1);
 
         /*
         double pl = measure_plaq(U);
@@ -242,17 +216,11 @@ void do_trajectory(GaugeField<group> &U, VectorField<Algebra<group>> &E, int tra
     measure_stuff(U, E, trajectory, t);
 
     // Then evolve until we reach t = trajlen*dt
+    auto evol = make_evolution<group>();
     for (int n = 0; n < trajlen; n += measure_interval) {
-        update_U(U, E, dt / 2);
-        // do 2 time units of evolution with leapfrog
-        for (int steps = 0; steps < measure_interval - 1; steps++) {
-            update_E(U, E, dt);
-            update_U(U, E, dt);
-        }
-        // and bring U and E to the same time value
-        update_E(U, E, dt);
-        update_U(U, E, dt / 2);
-        
+        // U and E are at the same time value after evolve()
+        evol.evolve(U, E, dt, measure_interval);
+
         t += dt * measure_interval;
         measure_stuff(U, E, trajectory, t);
     }
@@ -287,6 +255,15 @@ int main(int argc, char **argv) {
 
     double g2Ta = par.get("g^2 Ta");
     double dt = par.get("dt");
+    // the integrator is optional, leapfrog if not given
+    const std::vector<std::string> integrators = {"leapfrog", "omelyan", "forest-ruth"};
+    par.quiet();
+    evolution_scheme = par.get_item("integrator", integrators, false);
+    par.quiet(false);
+    hila::broadcast(evolution_scheme);
+    if (evolution_scheme < 0)
+        evolution_scheme = 0;
+    hila::out0 << "integrator           " << integrators[evolution_scheme] << '\n';
     int trajlen = par.get("trajectory length");
     int n_traj = par.get("number of trajectories");
     int measure_interval = par.get("measurement interval");
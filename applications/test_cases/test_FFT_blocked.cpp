@@ -0,0 +1,81 @@
+#include "test.h"
+#include "plumbing/fft.h"
+
+/////////////////////
+/// FFT on a blocked lattice, where the nodes are agglomerated with
+/// hila::set_block_min_volume() (command line -block-min-volume).
+/// With more than one rank, some ranks hold no sites of the blocked lattice
+/// and have to pass through the fft without pencils.
+/////////////////////
+
+int main(int argc, char **argv) {
+
+    using T = Complex<double>;
+
+#if NDIM == 2
+    const CoordinateVector nd = {32, 16};
+#elif NDIM == 3
+    const CoordinateVector nd = {16, 16, 8};
+#elif NDIM == 4
+    const CoordinateVector nd = {16, 8, 8, 8};
+#endif
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    CoordinateVector factor;
+    factor.fill(2);
+
+    // all sites of the blocked lattice on one rank
+    hila::set_block_min_volume(lattice.volume() / (1 << NDIM));
+    lattice.block(factor);
+
+    hila::out0 << "Blocked lattice " << lattice.size() << ", sites on rank 0 "
+               << lattice->mynode.volume << '\n';
+
+    Field<T> f, p, p2;
+
+    for (int iter = 0; iter < 2; iter++) {
+
+        // constant field transforms to volume at k = 0
+        f = 1;
+        p2 = 0;
+        p2[CoordinateVector(0)] = lattice.volume();
+
+        FFT_field(f, p);
+
+        double sum = 0;
+        onsites(ALL) sum += (p[X] - p2[X]).squarenorm();
+        hila::out0 << "Blocked FFT sum " << sum << '\n';
+        assert(sum < 1e-10 && "FFT of constant on blocked lattice");
+
+        // plane wave to e_x
+        onsites(ALL) {
+            double d = X.coordinate(e_x) * 2.0 * M_PI / lattice.size(e_x);
+            f[X] = T(cos(d), sin(d));
+        }
+
+        FFT_field(f, p);
+
+        p2 = 0;
+        CoordinateVector k1(0);
+        k1[e_x] = 1;
+        p2[k1] = lattice.volume();
+
+        sum = 0;
+        onsites(ALL) sum += (p[X] - p2[X]).squarenorm();
+        hila::out0 << "Blocked wave sum " << sum << '\n';
+        assert(sum < 1e-10 && "FFT of plane wave on blocked lattice");
+
+        // and back
+        FFT_field(p, p2, fft_direction::back);
+
+        sum = 0;
+        onsites(ALL) sum += (p2[X] - lattice.volume() * f[X]).squarenorm();
+        hila::out0 << "Blocked inverse sum " << sum << '\n';
+        assert(sum < 1e-10 * lattice.volume() && "inverse FFT on blocked lattice");
+    }
+
+    lattice.unblock();
+
+    hila::finishrun();
+}
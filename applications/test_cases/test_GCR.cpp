@@ -0,0 +1,82 @@
+#include "test.h"
+
+#include "dirac/wilson.h"
+#include "dirac/conjugate_gradient.h"
+#include "dirac/gcr.h"
+
+/////////////////////
+/// Flexible GCR on the Wilson Dirac operator: the residual |D x - b| of the
+/// solution, agreement with CG on D^dagger D, and reuse of the solver (and its
+/// search space) for another source.
+/////////////////////
+
+#define N 3
+
+int main(int argc, char **argv) {
+
+#if NDIM == 1
+    const CoordinateVector nd = {64};
+#elif NDIM == 2
+    const CoordinateVector nd = {32, 8};
+#elif NDIM == 3
+    const CoordinateVector nd = {16, 8, 8};
+#elif NDIM == 4
+    const CoordinateVector nd = {8, 8, 8, 8};
+#endif
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    hila::seed_random(3);
+
+    Field<SU<N, double>> U[NDIM];
+    foralldir(d) {
+        onsites(ALL) U[d][X].random();
+    }
+
+    using dirac = Dirac_Wilson<SU<N, double>>;
+    dirac D(0.1, U);
+    Field<Wilson_vector<N, double>> b, x, Dx, y;
+#if NDIM > 3
+    b.set_boundary_condition(e_t, hila::bc::ANTIPERIODIC);
+    x.copy_boundary_condition(b);
+    Dx.copy_boundary_condition(b);
+    y.copy_boundary_condition(b);
+#endif
+
+    GCR<dirac> gcr(D, 1e-10);
+
+    for (int source = 0; source < 2; source++) {
+        onsites(ALL) b[X].gaussian_random();
+        x[ALL] = 0;
+        gcr.apply(b, x);
+
+        D.apply(x, Dx);
+        double diff = 0, norm = 0;
+        onsites(ALL) {
+            diff += squarenorm(Dx[X] - b[X]);
+            norm += squarenorm(b[X]);
+        }
+        hila::out0 << "GCR source " << source << ": |D x - b| / |b| " << sqrt(diff / norm)
+                   << ", reported " << gcr.residue << '\n';
+        assert(diff < 1e-18 * norm && "GCR solves D x = b");
+        assert(fabs(gcr.residue - sqrt(diff / norm)) < 1e-9 && "GCR reports |r| / |b|");
+    }
+
+    // the same solution from CG on D^dagger D x = D^dagger b
+    CG<dirac> cg(D, 1e-12);
+    Field<Wilson_vector<N, double>> Ddb;
+    Ddb.copy_boundary_condition(b);
+    D.dagger(b, Ddb);
+    y[ALL] = 0;
+    cg.apply(Ddb, y);
+
+    double diff = 0, norm = 0;
+    onsites(ALL) {
+        diff += squarenorm(y[X] - x[X]);
+        norm += squarenorm(x[X]);
+    }
+    hila::out0 << "GCR vs CG: |x_GCR - x_CG|^2 / |x|^2 " << diff / norm << '\n';
+    assert(diff < 1e-14 * norm && "GCR agrees with CG");
+
+    hila::finishrun();
+}
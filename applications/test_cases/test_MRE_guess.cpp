@@ -0,0 +1,123 @@
+#include "test.h"
+
+#include "hmc/MRE_guess.h"
+
+/////////////////////
+/// The MRE initial guess against dense linear algebra in the span of the stored
+/// solutions.  A = D^dagger D with a site-local matrix and a hopping term.  After
+/// the window of stored solutions has moved, and with a linearly dependent
+/// solution in it, the guess has to
+///  - reproduce any combination of the stored solutions exactly,
+///  - leave a residual orthogonal to the stored solutions (Galerkin condition),
+///  - not reproduce a dropped solution.
+/////////////////////
+
+constexpr int N = 3;
+constexpr int window = 4;
+
+using vector_t = Vector<N, Complex<double>>;
+
+class site_operator {
+  public:
+    using vector_type = vector_t;
+    Parity par = ALL;
+    Field<SquareMatrix<N, Complex<double>>> M;
+
+    site_operator() {
+        onsites(ALL) {
+            M[X].gaussian_random();
+            M[X] += 4;
+        }
+    }
+
+    void apply(const Field<vector_t> &in, Field<vector_t> &out) {
+        onsites(par) out[X] = M[X] * in[X] + 0.2 * in[X + e_x];
+    }
+    void dagger(const Field<vector_t> &in, Field<vector_t> &out) {
+        onsites(par) out[X] = M[X].dagger() * in[X] + 0.2 * in[X - e_x];
+    }
+};
+
+Complex<double> dot(const Field<vector_t> &a, const Field<vector_t> &b) {
+    Complex<double> d = 0;
+    onsites(ALL) d += a[X].dot(b[X]);
+    return d;
+}
+
+void apply_A(site_operator &D, const Field<vector_t> &in, Field<vector_t> &out) {
+    Field<vector_t> tmp;
+    D.apply(in, tmp);
+    D.dagger(tmp, out);
+}
+
+int main(int argc, char **argv) {
+
+#if NDIM == 1
+    const CoordinateVector nd = {64};
+#elif NDIM == 2
+    const CoordinateVector nd = {16, 8};
+#elif NDIM == 3
+    const CoordinateVector nd = {8, 8, 8};
+#elif NDIM == 4
+    const CoordinateVector nd = {8, 8, 8, 8};
+#endif
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    hila::seed_random(5);
+
+    site_operator D;
+    MRE_basis<site_operator, window> mre;
+    mre.setup(window);
+
+    // 5 independent solutions, then one in the span of the last two and one more
+    // independent: the window holds s[3] ... s[6]
+    Field<vector_t> s[7];
+    for (int k = 0; k < 7; k++) {
+        if (k == 5)
+            onsites(ALL) s[k][X] = s[3][X] + Complex<double>(0, 2) * s[4][X];
+        else
+            onsites(ALL) s[k][X].gaussian_random();
+        mre.add(s[k], D);
+    }
+    hila::out0 << "MRE basis size " << mre.size() << '\n';
+    assert(mre.size() == window - 1 && "dependent solution does not add to the basis");
+
+    Field<vector_t> target, chi, psi, Apsi;
+
+    // a combination of the stored solutions is reproduced
+    target = 0;
+    for (int k = 3; k < 7; k++) {
+        Complex<double> c(k, 1 - k);
+        onsites(ALL) target[X] += s[k][X] * c;
+    }
+    apply_A(D, target, chi);
+    mre.guess(chi, psi, D);
+    double err = 0;
+    onsites(ALL) err += (psi[X] - target[X]).squarenorm();
+    err /= target.squarenorm();
+    hila::out0 << "stored combination: relative error " << err << '\n';
+    assert(err < 1e-20 && "MRE guess reproduces the stored solutions");
+
+    // the residual of a random source is orthogonal to the stored solutions
+    onsites(ALL) chi[X].gaussian_random();
+    mre.guess(chi, psi, D);
+    apply_A(D, psi, Apsi);
+    Field<vector_t> res = chi - Apsi;
+    double orth = 0;
+    for (int k = 3; k < 7; k++)
+        orth = std::max(orth, dot(s[k], res).abs() / sqrt(s[k].squarenorm() * chi.squarenorm()));
+    hila::out0 << "random source: largest residual overlap " << orth << '\n';
+    assert(orth < 1e-12 && "MRE residual is orthogonal to the stored solutions");
+
+    // the oldest solutions have been dropped
+    apply_A(D, s[0], chi);
+    mre.guess(chi, psi, D);
+    err = 0;
+    onsites(ALL) err += (psi[X] - s[0][X]).squarenorm();
+    err /= s[0].squarenorm();
+    hila::out0 << "dropped solution: relative error " << err << '\n';
+    assert(err > 1e-3 && "dropped solution is not in the basis");
+
+    hila::finishrun();
+}
@@ -0,0 +1,114 @@
+#include "test.h"
+#include "plumbing/gaugefield.h"
+
+/////////////////////
+/// Blocking Fields and GaugeFields to an agglomerated lattice, where the nodes
+/// are merged with hila::set_block_min_volume() and, with more than one rank,
+/// the sites are moved between ranks.  The blocked values have to be the ones
+/// of the non-agglomerated blocked lattice, site by site: f(2x) for a Field and
+/// the long link U_d(2x) U_d(2x + d) for a GaugeField, and unblocking has to put
+/// them back exactly.
+/////////////////////
+
+/// Label of site c, unique for each site
+double site_label(const CoordinateVector &c) {
+    double v = 0;
+    foralldir(d) v = v * 64 + c[d];
+    return v;
+}
+
+/// Link of direction d at site c, small integers so that products are exact
+Complex<double> link_value(const CoordinateVector &c, Direction d) {
+    int s = 0;
+    foralldir(k) s += (k + 2) * c[k];
+    return Complex<double>(s % 5 + 1, (int)d - s % 3);
+}
+
+int main(int argc, char **argv) {
+
+#if NDIM == 2
+    const CoordinateVector nd = {32, 16};
+#elif NDIM == 3
+    const CoordinateVector nd = {16, 16, 8};
+#elif NDIM == 4
+    const CoordinateVector nd = {16, 8, 8, 8};
+#endif
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    Field<double> f;
+    onsites(ALL) f[X] = site_label(X.coordinates());
+
+    GaugeField<Complex<double>> U, W;
+    foralldir(d) {
+        onsites(ALL) U[d][X] = link_value(X.coordinates(), d);
+        W[d] = 0;
+    }
+
+    CoordinateVector factor;
+    factor.fill(2);
+
+    // all sites of the blocked lattice on one rank
+    hila::set_block_min_volume(lattice.volume() / (1 << NDIM));
+    lattice.block(factor);
+
+    hila::out0 << "Blocked lattice " << lattice.size() << ", sites on rank 0 "
+               << lattice->mynode.volume << '\n';
+
+    // Field: blocked value is the value at 2x
+    Field<double> b;
+    b.block_from(f);
+    double diff = 0;
+    onsites(ALL) diff += squarenorm(b[X] - site_label(2 * X.coordinates()));
+    hila::out0 << "Field block_from deviation " << diff << '\n';
+    assert(diff == 0 && "block_from moves the blocked sites");
+
+    // GaugeField: long links
+    GaugeField<Complex<double>> V;
+    V.block_gauge(U);
+    diff = 0;
+    foralldir(d) {
+        onsites(ALL) {
+            CoordinateVector c = 2 * X.coordinates();
+            CoordinateVector cn = (c + d).mod(nd);
+            diff += squarenorm(V[d][X] - link_value(c, d) * link_value(cn, d));
+        }
+    }
+    hila::out0 << "GaugeField block_gauge deviation " << diff << '\n';
+    assert(diff == 0 && "block_gauge forms the long links");
+
+    // flip the sign of the blocked field and put both back
+    b[ALL] = -b[X];
+    b.unblock_to(f);
+    V.unblock_gauge(W);
+
+    lattice.unblock();
+
+    diff = 0;
+    onsites(ALL) {
+        double label = site_label(X.coordinates());
+        if (X.coordinates().is_divisible(factor))
+            diff += squarenorm(f[X] + label);
+        else
+            diff += squarenorm(f[X] - label);
+    }
+    hila::out0 << "Field unblock_to deviation " << diff << '\n';
+    assert(diff == 0 && "unblock_to restores the blocked sites, leaves the others");
+
+    diff = 0;
+    foralldir(d) {
+        onsites(ALL) {
+            if (X.coordinates().is_divisible(factor)) {
+                CoordinateVector cn = (X.coordinates() + d).mod(nd);
+                diff += squarenorm(W[d][X] -
+                                   link_value(X.coordinates(), d) * link_value(cn, d));
+            } else {
+                diff += squarenorm(W[d][X]);
+            }
+        }
+    }
+    hila::out0 << "GaugeField unblock_gauge deviation " << diff << '\n';
+    assert(diff == 0 && "unblock_gauge restores the long links");
+
+    hila::finishrun();
+}
@@ -0,0 +1,95 @@
+#include "test.h"
+#include "plumbing/block_file.h"
+#include <cstdio>
+
+/////////////////////
+/// Block file write/read round trip.  The field is written with block sizes which
+/// divide the lattice and which do not, so that there are smaller blocks at the
+/// edges and, with several ranks, blocks split between ranks.  Checks
+///  - read_block_file() of the whole field,
+///  - block_file::read() of a box, which leaves the rest of the field untouched,
+///  - block_file::read_subvolume() of the same box on every rank.
+/////////////////////
+
+using T = Complex<double>;
+
+/// Value stored at site c, unique for each site
+T site_value(const CoordinateVector &c) {
+    double v = 0;
+    foralldir(d) v = v * 64 + c[d];
+    return T(v, -v);
+}
+
+int main(int argc, char **argv) {
+
+#if NDIM == 2
+    const CoordinateVector nd = {32, 16};
+#elif NDIM == 3
+    const CoordinateVector nd = {16, 16, 8};
+#elif NDIM == 4
+    const CoordinateVector nd = {16, 8, 8, 8};
+#endif
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    const std::string fname = "test_block_file.blk";
+
+    Field<T> f, g;
+    onsites(ALL) f[X] = site_value(X.coordinates());
+
+    // a box which is not aligned with the blocks
+    CoordinateVector cmin, cmax;
+    foralldir(d) {
+        cmin[d] = 1;
+        cmax[d] = lattice.size(d) / 2 + 2;
+    }
+
+    for (int block : {8, 3}) {
+
+        hila::write_block_file(fname, f, block);
+
+        // whole field
+        g = 0;
+        hila::read_block_file(fname, g);
+        double diff = 0;
+        onsites(ALL) diff += squarenorm(g[X] - f[X]);
+        hila::out0 << "block " << block << ": field read back, |g - f|^2 " << diff << '\n';
+        assert(diff == 0 && "block file round trip");
+
+        // box only, the rest stays as it was
+        hila::block_file<T> bf(fname);
+        assert(bf.is_open() && "block file opened");
+        g = -1;
+        bf.read(g, cmin, cmax);
+        diff = 0;
+        onsites(ALL) {
+            bool inside = true;
+            foralldir(d) inside = inside && X.coordinate(d) >= cmin[d] &&
+                                  X.coordinate(d) <= cmax[d];
+            if (inside)
+                diff += squarenorm(g[X] - f[X]);
+            else
+                diff += squarenorm(g[X] + 1);
+        }
+        hila::out0 << "block " << block << ": box read, deviation " << diff << '\n';
+        assert(diff == 0 && "block file box read");
+
+        // the same box as a vector, independently on each rank
+        std::vector<T> sub = bf.read_subvolume(cmin, cmax);
+        int errors = 0;
+        size_t i = 0;
+        CoordinateVector c;
+        forcoordinaterange(c, cmin, cmax) {
+            if (sub[i++] != site_value(c))
+                errors++;
+        }
+        hila::reduce_node_sum(errors);
+        hila::out0 << "block " << block << ": subvolume read, " << errors << " errors\n";
+        assert(errors == 0 && "block file subvolume read");
+    }
+
+    if (hila::myrank() == 0)
+        std::remove(fname.c_str());
+
+    hila::finishrun();
+}
@@ -0,0 +1,94 @@
+#include "hila.h"
+
+/////////////////////
+/// Round trip of gauge configurations through the compressed file format
+/// (plumbing/field_compress.h) with all link parametrisations.  Cold (unit),
+/// diagonal and random links are checked for the max deviation.
+/////////////////////
+
+using mygroup = SU<3, double>;
+
+double max_deviation(const GaugeField<mygroup> &a, const GaugeField<mygroup> &b) {
+    double maxdev = 0;
+    Field<double> dev;
+    foralldir(d) {
+        onsites(ALL) dev[X] = (a[d][X] - b[d][X]).squarenorm();
+        maxdev = std::max(maxdev, dev.max());
+    }
+    return sqrt(maxdev);
+}
+
+void check_roundtrip(const GaugeField<mygroup> &U, const std::string &name) {
+    const std::string filename = "test_compress.dat";
+    GaugeField<mygroup> V;
+
+    for (int params : {0, 12, 8}) {
+        V = 0;
+        U.config_write(filename, hila::compress_options{params});
+        V.config_read(filename);
+
+        double dev = max_deviation(U, V);
+        hila::out0 << name << " config, " << params << " parameters: max deviation " << dev
+                   << '\n';
+        if (params == 0)
+            assert(dev == 0 && "lossless round trip");
+        else
+            assert(dev < 1e-13 && "reduced link round trip");
+    }
+
+    if (hila::myrank() == 0)
+        std::remove(filename.c_str());
+}
+
+int main(int argc, char **argv) {
+
+#if NDIM == 2
+    const CoordinateVector nd = {16, 8};
+#elif NDIM == 3
+    const CoordinateVector nd = {8, 8, 8};
+#elif NDIM == 4
+    const CoordinateVector nd = {8, 8, 8, 8};
+#endif
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    hila::seed_random(5);
+
+    GaugeField<mygroup> U;
+
+    // cold start: the reduced row of every link is zero
+    U = 1;
+    check_roundtrip(U, "cold");
+
+    // diagonal links, e.g. temporal gauge with Polyakov phases
+    foralldir(d) {
+        onsites(ALL) {
+            double a = hila::random() * 2 * M_PI, b = hila::random() * 2 * M_PI;
+            U[d][X] = 0;
+            U[d][X].e(0, 0) = Complex<double>(cos(a), sin(a));
+            U[d][X].e(1, 1) = Complex<double>(cos(b), sin(b));
+            U[d][X].e(2, 2) = Complex<double>(cos(a + b), -sin(a + b));
+        }
+    }
+    check_roundtrip(U, "diagonal");
+
+    foralldir(d) {
+        onsites(ALL) U[d][X].random();
+    }
+    check_roundtrip(U, "random");
+
+    // close to unit links
+    foralldir(d) {
+        onsites(ALL) {
+            mygroup h;
+            h.random();
+            mygroup e;
+            e = 1;
+            U[d][X] = e + 1e-6 * (h - h.dagger());
+            U[d][X].reunitarize();
+        }
+    }
+    check_roundtrip(U, "near unit");
+
+    hila::finishrun();
+}
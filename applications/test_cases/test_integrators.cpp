@@ -0,0 +1,136 @@
+#include "test.h"
+
+#include "hmc/integrator.h"
+
+/////////////////////
+/// The HMC integrators on an anharmonic oscillator, H = p^2/2 + q^2/2 + q^4/4
+/// for a few degrees of freedom.  The trajectories have to be reversible, and
+/// the energy violation dH has to scale as eps^4 for the fourth order O4 Omelyan
+/// and force-gradient integrators (and as eps^2 for O2).
+/////////////////////
+
+constexpr int n_dof = 4;
+
+struct oscillator {
+    double q[n_dof], p[n_dof];
+};
+
+/// The lowest level: kinetic energy, moves q along p
+class oscillator_momentum : public integrator_base {
+  public:
+    oscillator &s;
+    double q_trial[n_dof], p_trial[n_dof];
+
+    oscillator_momentum(oscillator &o) : s(o) {}
+
+    double action() {
+        double a = 0;
+        for (int i = 0; i < n_dof; i++)
+            a += 0.5 * s.p[i] * s.p[i];
+        return a;
+    }
+    void step(double eps) {
+        for (int i = 0; i < n_dof; i++)
+            s.q[i] += eps * s.p[i];
+    }
+    void save_trial_state() {
+        for (int i = 0; i < n_dof; i++) {
+            q_trial[i] = s.q[i];
+            p_trial[i] = s.p[i];
+            s.p[i] = 0;
+        }
+    }
+    void trial_step(double eps) {
+        step(eps);
+        for (int i = 0; i < n_dof; i++)
+            s.p[i] = p_trial[i];
+    }
+    void restore_trial_state() {
+        for (int i = 0; i < n_dof; i++)
+            s.q[i] = q_trial[i];
+    }
+};
+
+/// The potential q^2/2 + q^4/4
+class oscillator_potential : public action_base {
+  public:
+    oscillator &s;
+
+    oscillator_potential(oscillator &o) : s(o) {}
+
+    double action() {
+        double a = 0;
+        for (int i = 0; i < n_dof; i++)
+            a += 0.5 * s.q[i] * s.q[i] + 0.25 * pow(s.q[i], 4);
+        return a;
+    }
+    void force_step(double eps) {
+        for (int i = 0; i < n_dof; i++)
+            s.p[i] -= eps * (s.q[i] + pow(s.q[i], 3));
+    }
+};
+
+void set_start(oscillator &s) {
+    for (int i = 0; i < n_dof; i++) {
+        s.q[i] = 0.3 * (i + 1);
+        s.p[i] = 0.5 - 0.2 * i;
+    }
+}
+
+/// Run a trajectory of length 1 in n steps, return |dH|
+template <typename integrator_type>
+double trajectory_dH(integrator_type &integrator, oscillator &s, int n) {
+    set_start(s);
+    double h0 = integrator.action();
+    for (int i = 0; i < n; i++)
+        integrator.step(1.0 / n);
+    return fabs(integrator.action() - h0);
+}
+
+template <typename integrator_type>
+void check_integrator(integrator_type &integrator, oscillator &s, double order,
+                      const std::string &name) {
+
+    // reversibility: forward, flip the momentum, forward again
+    set_start(s);
+    oscillator start = s;
+    for (int i = 0; i < 10; i++)
+        integrator.step(0.1);
+    for (int i = 0; i < n_dof; i++)
+        s.p[i] = -s.p[i];
+    for (int i = 0; i < 10; i++)
+        integrator.step(0.1);
+
+    double dev = 0;
+    for (int i = 0; i < n_dof; i++)
+        dev = std::max(dev, std::max(fabs(s.q[i] - start.q[i]), fabs(s.p[i] + start.p[i])));
+    hila::out0 << name << ": reversibility violation " << dev << '\n';
+    assert(dev < 1e-12 && "integrator is reversible");
+
+    // dH scaling when the step is halved
+    double dH1 = trajectory_dH(integrator, s, 8);
+    double dH2 = trajectory_dH(integrator, s, 16);
+    double measured = log2(dH1 / dH2);
+    hila::out0 << name << ": dH " << dH1 << " -> " << dH2 << ", order " << measured << '\n';
+    assert(fabs(measured - order) < 0.5 && "integrator error scales with its order");
+}
+
+int main(int argc, char **argv) {
+
+    hila::initialize(argc, argv);
+
+    oscillator s;
+    oscillator_momentum mom(s);
+    oscillator_potential pot(s);
+
+    O2_integrator o2(pot, mom);
+    check_integrator(o2, s, 2, "O2");
+
+    O4_integrator o4(pot, mom);
+    check_integrator(o4, s, 4, "O4 Omelyan");
+
+    force_gradient_integrator fg(pot, mom);
+    check_integrator(fg, s, 4, "force-gradient");
+
+    hila::finishrun();
+}
@@ -0,0 +1,121 @@
+#include "test.h"
+#include "gauge/realtime_evolution.h"
+
+/////////////////////
+/// Real-time evolution of (U, E) on a random configuration.  Checks that
+///  - realtime_update_E() gives the same E as the staplesum()-based update,
+///  - the energy drift falls off as dt^2 for leapfrog and omelyan and as dt^4
+///    for forest_ruth,
+///  - the Gauss law violation stays at round-off after degaussing.
+/////////////////////
+
+using group = SU<3, double>;
+using evolution = realtime_evolution<group>;
+
+/// Energy as in sun_realtime: 1/2 sum E^2 + 2 sum_plaq (N - Re Tr P)
+double energy(const GaugeField<group> &U, const VectorField<Algebra<group>> &E) {
+    double e2 = 0;
+    foralldir(d) e2 += E[d].squarenorm();
+
+    double plaq = 0;
+    foralldir(d1) foralldir(d2) if (d1 < d2) {
+        onsites(ALL) {
+            plaq += group::size() -
+                    real(trace(U[d1][X] * U[d2][X + d1] * (U[d2][X] * U[d1][X + d2]).dagger()));
+        }
+    }
+    return e2 / 2 + 2 * plaq;
+}
+
+/// Largest energy deviation from the start during evolution to time t_end,
+/// measured at every t_end / 4
+double energy_drift(evolution::integrator scheme, GaugeField<group> U,
+                    VectorField<Algebra<group>> E, double dt, double t_end) {
+    evolution evol;
+    evol.scheme = scheme;
+
+    double e0 = energy(U, E);
+    double drift = 0;
+    int nsteps = (int)std::round(t_end / (4 * dt));
+    for (int i = 0; i < 4; i++) {
+        evol.evolve(U, E, dt, nsteps);
+        drift = std::max(drift, std::abs(energy(U, E) - e0));
+    }
+    return drift;
+}
+
+int main(int argc, char **argv) {
+
+#if NDIM == 2
+    const CoordinateVector nd = {16, 16};
+#elif NDIM == 3
+    const CoordinateVector nd = {8, 8, 8};
+#elif NDIM == 4
+    const CoordinateVector nd = {8, 8, 8, 8};
+#endif
+    hila::initialize(argc, argv);
+    lattice.setup(nd);
+
+    hila::seed_random(7);
+
+    GaugeField<group> U;
+    VectorField<Algebra<group>> E;
+    foralldir(d) {
+        onsites(ALL) {
+            U[d][X].gaussian_random(0.3).reunitarize();
+            E[d][X].gaussian_random();
+        }
+    }
+    degauss(U, E, 1e-20);
+
+    // fused E-update against the staplesum one
+    const double delta = 0.1;
+    VectorField<Algebra<group>> E1 = E, E2 = E;
+    std::array<Field<group>, NDIM - 1> lower;
+    realtime_update_E(U, E1, delta, lower);
+
+    Field<group> staple;
+    foralldir(d) {
+        staplesum(U, staple, d);
+        onsites(ALL) E2[d][X] -= delta * (U[d][X] * staple[X].dagger()).project_to_algebra();
+    }
+
+    double diff = 0, norm = 0;
+    foralldir(d) {
+        onsites(ALL) diff += (E1[d][X] - E2[d][X]).squarenorm();
+        norm += (E2[d] - E[d]).squarenorm();
+    }
+    hila::out0 << "realtime_update_E against staplesum: relative deviation " << diff / norm
+               << '\n';
+    assert(diff < 1e-24 * norm && "realtime_update_E is the staplesum update");
+
+    // energy drift at dt and dt/2
+    const double dt = 0.05, t_end = 1.0;
+    struct {
+        evolution::integrator scheme;
+        const char *name;
+        int order;
+    } schemes[] = {{evolution::integrator::leapfrog, "leapfrog", 2},
+                   {evolution::integrator::omelyan, "omelyan", 2},
+                   {evolution::integrator::forest_ruth, "forest_ruth", 4}};
+
+    for (auto &s : schemes) {
+        double d1 = energy_drift(s.scheme, U, E, dt, t_end);
+        double d2 = energy_drift(s.scheme, U, E, dt / 2, t_end);
+        double order = std::log2(d1 / d2);
+        hila::out0 << s.name << ": energy drift " << d1 << " at dt " << dt << ", " << d2
+                   << " at dt/2, order " << order << '\n';
+        assert(std::abs(order - s.order) < 0.5 && "energy drift scales as dt^order");
+    }
+
+    // Gauss law is conserved by the evolution
+    evolution evol;
+    evol.scheme = evolution::integrator::omelyan;
+    evol.gauss_check_interval = 5;
+    evol.evolve(U, E, dt, 40);
+    hila::out0 << "Gauss violation/site after evolution " << evol.gauss_violation << ", max "
+               << evol.max_gauss_violation << '\n';
+    assert(evol.max_gauss_violation < 1e-18 && "Gauss violation stays at round-off");
+
+    hila::finishrun();
+}
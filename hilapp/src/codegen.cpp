@@ -114,6 +114,54 @@ std::string TopLevelVisitor::get_filename_and_line(Stmt *S) {
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Helpers for the -loop-profile probes: the number of sites the loop runs over,
+/// and the field bytes read / written per site
+///////////////////////////////////////////////////////////////////////////////
+
+static std::string loop_profile_sites() {
+    switch (loop_info.parity_value) {
+    case Parity::all:
+        return "lattice->mynode.volume";
+    case Parity::even:
+        return "lattice->mynode.evensites";
+    case Parity::odd:
+        return "lattice->mynode.oddsites";
+    default:
+        return "(" + parity_name + " == ALL ? lattice->mynode.volume : (" + parity_name +
+               " == EVEN ? lattice->mynode.evensites : lattice->mynode.oddsites))";
+    }
+}
+
+static std::string loop_profile_bytes(bool written) {
+    std::string bytes;
+    for (field_info &l : field_info_list) {
+        std::string n;
+        if (written) {
+            if (l.is_written)
+                n = "1";
+        } else if (l.is_loop_local_dir) {
+            // direction unknown at compile time, count all neighbours
+            n = l.is_read_atX ? "(NDIRS + 1)" : "NDIRS";
+        } else {
+            int nread = l.is_read_atX ? 1 : 0;
+            for (dir_ptr &d : l.dir_list)
+                if (d.count > 0)
+                    nread++;
+            if (nread > 0)
+                n = std::to_string(nread);
+        }
+        if (n.size() > 0) {
+            if (bytes.size() > 0)
+                bytes += " + ";
+            bytes += n + " * sizeof(" + l.element_type + ")";
+        }
+    }
+    if (bytes.size() == 0)
+        bytes = "0";
+    return bytes;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// The main entry point for code generation
 ///////////////////////////////////////////////////////////////////////////////
@@ -160,6 +208,22 @@ void TopLevelVisitor::generate_code(Stmt *S) {
     while (t.find(parity_name, 0) != std::string::npos)
         parity_name += "_";
 
+    // Loop profiling probe: one static probe per loop, keyed by source location.
+    // Not inside omp parallel regions, where the probe would be entered by all threads
+    bool profile_loop = cmdline::loop_profile && !loop_info.has_pragma_omp_parallel_region;
+    std::string profile_name = unique_name(t, "HILA_loop_profile");
+    if (profile_loop) {
+        SourceLocation sl = get_real_range(S->getSourceRange()).getBegin();
+        std::string funcname = "<unknown>";
+        if (global.currentFunctionDecl != nullptr)
+            funcname = global.currentFunctionDecl->getQualifiedNameAsString();
+
+        code << "static hila::loop_profile " << profile_name << "(\""
+             << srcMgr.getFilename(sl).str() << "\", " << srcMgr.getSpellingLineNumber(sl)
+             << ", \"" << funcname << "\");\n";
+        code << profile_name << ".start();\n";
+    }
+
     if (loop_info.parity_value == Parity::none) {
         // now unknown
         code << "const Parity " << parity_name << " = " << loop_info.parity_text << ";\n";
@@ -434,6 +498,11 @@ void TopLevelVisitor::generate_code(Stmt *S) {
             code << l.new_name << ".mark_changed(" << loop_info.parity_str << ");\n";
         }
 
+    if (profile_loop) {
+        code << profile_name << ".stop(" << loop_profile_sites() << ", "
+             << loop_profile_bytes(false) << ", " << loop_profile_bytes(true) << ");\n";
+    }
+
     // and close
     code << "}\n//----------\n";
 
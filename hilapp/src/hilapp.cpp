@@ -137,6 +137,12 @@ llvm::cl::opt<bool>
                              llvm::cl::desc("Use slow (but memory economical) reduction on gpus"),
                              llvm::cl::cat(HilappCategory));
 
+llvm::cl::opt<bool> cmdline::loop_profile(
+    "loop-profile",
+    llvm::cl::desc("Insert timing probes around site loops (hila::loop_profile),\n"
+                   "reported at hila::finishrun()"),
+    llvm::cl::cat(HilappCategory));
+
 llvm::cl::opt<int> cmdline::verbosity("verbosity",
                                       llvm::cl::desc("Verbosity level 0-2.  Default 0 (quiet)"),
                                       llvm::cl::cat(HilappCategory));
@@ -0,0 +1,280 @@
+#ifndef BLOCK_CG_ALG
+#define BLOCK_CG_ALG
+
+///////////////////////////////////////////////////////
+/// Block conjugate gradient algorithm for fields
+///
+/// Solves field1 = (operator^dagger operator) * field2 for several
+/// right hand sides at once.  The operator applies to bundles of
+/// vectors, vector_type = Matrix<n, nrhs, T>, with one right hand side
+/// in each column (for example dirac_staggered_multi).  The search
+/// directions of all right hand sides are combined (O'Leary 1980), so
+/// that the number of iterations is typically smaller than for
+/// separate CG solves, and each operator application loads the gauge
+/// field once for all of them.
+///
+/// Right hand sides that have converged are frozen and their search
+/// directions dropped.  A right hand side whose residual becomes linearly
+/// dependent on the others (within dependency_tolerance) also drops its
+/// search direction, but keeps being updated in the directions of the
+/// others, which span it.  This keeps the small matrices invertible.
+///////////////////////////////////////////////////////
+
+#include <sstream>
+#include <iostream>
+#include "dirac/conjugate_gradient.h"
+
+/// Copy single vector field v to column i of a bundle
+template <typename btype, typename vtype>
+void set_bundle_column(Field<btype> &b, int i, const Field<vtype> &v) {
+    b.copy_boundary_condition(v);
+    onsites(ALL) b[X].set_column(i, v[X]);
+}
+
+/// Copy column i of a bundle to single vector field v
+template <typename btype, typename vtype>
+void get_bundle_column(const Field<btype> &b, int i, Field<vtype> &v) {
+    v.copy_boundary_condition(b);
+    onsites(ALL) v[X] = b[X].column(i);
+}
+
+/// The block conjugate gradient operator. Applies the inverse square of an
+/// operator on a bundle of vectors
+template <typename Op> class block_CG {
+  private:
+    // The operator to invert
+    Op &M;
+    // desired relative accuracy, for each right hand side
+    double accuracy = CG_DEFAULT_ACCURACY;
+    // maximum number of iterations
+    int maxiters = CG_DEFAULT_MAXITERS;
+    // relative size of the independent part of a residual, below which
+    // it is treated as dependent on the others
+    double dependency_tolerance = 1e-6;
+
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+    /// Number of right hand sides
+    static constexpr int nrhs = vector_type::columns();
+    /// The type of the small matrices between right hand sides
+    using small_matrix = SquareMatrix<nrhs, Complex<double>>;
+
+  private:
+    /// Drop from the search block the columns of the Gram matrix g whose
+    /// part orthogonal to the other columns is relatively smaller than
+    /// dependency_tolerance: pivoted Cholesky of the normalized g
+    void drop_dependent(const small_matrix &g, bool (&search)[nrhs]) const {
+        small_matrix a = 0;
+        bool left[nrhs];
+        for (int i = 0; i < nrhs; i++) {
+            left[i] = search[i];
+            for (int j = 0; j < nrhs; j++) {
+                if (search[i] && search[j])
+                    a.e(i, j) = g.e(i, j) / sqrt(g.e(i, i).re * g.e(j, j).re);
+            }
+        }
+        const double tol = dependency_tolerance * dependency_tolerance;
+        while (true) {
+            int k = -1;
+            for (int i = 0; i < nrhs; i++) {
+                if (left[i] && (k < 0 || a.e(i, i).re > a.e(k, k).re))
+                    k = i;
+            }
+            if (k < 0)
+                return;
+            if (a.e(k, k).re < tol) {
+                // the rest are dependent
+                for (int i = 0; i < nrhs; i++) {
+                    if (left[i])
+                        search[i] = false;
+                }
+                return;
+            }
+            left[k] = false;
+            for (int i = 0; i < nrhs; i++) {
+                for (int j = 0; j < nrhs; j++) {
+                    if (left[i] && left[j])
+                        a.e(i, j) -= a.e(i, k) * a.e(k, j) / a.e(k, k).re;
+                }
+            }
+        }
+    }
+
+    /// Restrict m to the given rows and columns, others are set to zero
+    static small_matrix restrict_to(const small_matrix &m, const bool (&rows)[nrhs],
+                                 const bool (&cols)[nrhs]) {
+        small_matrix r = 0;
+        for (int i = 0; i < nrhs; i++) {
+            for (int j = 0; j < nrhs; j++) {
+                if (rows[i] && cols[j])
+                    r.e(i, j) = m.e(i, j);
+            }
+        }
+        return r;
+    }
+
+    /// Restrict m to the search block, with unit diagonal outside it so that
+    /// the result stays invertible
+    static small_matrix restrict_block(const small_matrix &m, const bool (&search)[nrhs]) {
+        small_matrix r = 0;
+        for (int i = 0; i < nrhs; i++) {
+            for (int j = 0; j < nrhs; j++) {
+                if (search[i] && search[j])
+                    r.e(i, j) = m.e(i, j);
+            }
+            if (!search[i])
+                r.e(i, i) = 1;
+        }
+        return r;
+    }
+
+  public:
+    /// Constructor: initialize the operator
+    block_CG(Op &op) : M(op){};
+    /// Constructor: operator and accuracy
+    block_CG(Op &op, double _accuracy) : M(op) {
+        accuracy = _accuracy;
+    };
+    /// Constructor: operator, accuracy and maximum number of iterations
+    block_CG(Op &op, double _accuracy, int _maxiters) : M(op) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+
+    /// The apply() -member runs the full block conjugate gradient,
+    /// out is used as the initial guess
+    void apply(Field<vector_type> &in, Field<vector_type> &out) {
+        int i;
+        struct timeval start, end;
+        Field<vector_type> r, p, Dp, DDp;
+        r.copy_boundary_condition(in);
+        p.copy_boundary_condition(in);
+        Dp.copy_boundary_condition(in);
+        DDp.copy_boundary_condition(in);
+        out.copy_boundary_condition(in);
+        small_matrix source_norm = 0, rr = 0, rrnew = 0, pDp;
+        double max_residue = 0;
+
+        gettimeofday(&start, NULL);
+
+        onsites(M.par) {
+            source_norm += in[X].dagger() * in[X];
+        }
+
+        M.apply(out, Dp);
+        M.dagger(Dp, DDp);
+        onsites(M.par) {
+            r[X] = in[X] - DDp[X];
+            p[X] = r[X];
+        }
+
+        onsites(M.par) {
+            rr += r[X].dagger() * r[X];
+        }
+
+        // active: not converged, still updated.  search: column of p is in
+        // the search block
+        bool active[nrhs], search[nrhs], search_old[nrhs];
+        int n_search = 0;
+        for (int j = 0; j < nrhs; j++) {
+            active[j] = false;
+            if (source_norm.e(j, j).re > 0) {
+                double res = rr.e(j, j).re / source_norm.e(j, j).re;
+                max_residue = std::max(max_residue, res);
+                active[j] = res >= accuracy * accuracy;
+            }
+            search[j] = active[j];
+        }
+        drop_dependent(rr, search);
+
+        int restarts = 0;
+        for (i = 0; i < maxiters; i++) {
+            n_search = 0;
+            int n_active = 0;
+            for (int j = 0; j < nrhs; j++) {
+                n_search += search[j];
+                n_active += active[j];
+            }
+            if (n_active == 0)
+                break;
+            if (n_search == 0) {
+                // columns dropped as dependent have not converged with the others:
+                // restart with the remaining residuals as the search directions
+                p[M.par] = r[X];
+                for (int j = 0; j < nrhs; j++)
+                    search[j] = active[j];
+                drop_dependent(rr, search);
+                for (int j = 0; j < nrhs; j++)
+                    n_search += search[j];
+                restarts++;
+            }
+            for (int j = 0; j < nrhs; j++)
+                search_old[j] = search[j];
+
+            pDp = 0;
+            rrnew = 0;
+            M.apply(p, Dp);
+            M.dagger(Dp, DDp);
+            onsites(M.par) {
+                pDp += Dp[X].dagger() * Dp[X];
+            }
+
+            // p^dagger r = r_search^dagger r, as r is orthogonal to the old directions
+            small_matrix alpha =
+                restrict_block(pDp, search).invert_mul(restrict_to(rr, search, active));
+
+            onsites(M.par) {
+                out[X] = out[X] + p[X] * alpha;
+                r[X] = r[X] - DDp[X] * alpha;
+            }
+            onsites(M.par) {
+                rrnew += r[X].dagger() * r[X];
+            }
+
+            // converged when each right hand side is
+            max_residue = 0;
+            for (int j = 0; j < nrhs; j++) {
+                if (source_norm.e(j, j).re > 0) {
+                    double res = rrnew.e(j, j).re / source_norm.e(j, j).re;
+                    max_residue = std::max(max_residue, res);
+                    if (res < accuracy * accuracy)
+                        active[j] = search[j] = false;
+                }
+            }
+#ifdef DEBUG_CG
+            hila::out0 << "Block CG step " << i << ", max relative residue " << max_residue
+                       << ", search block " << n_search << "\n";
+#endif
+            if (max_residue < accuracy * accuracy)
+                break;
+
+            // the new directions are conjugate to all of the old search block
+            drop_dependent(rrnew, search);
+            small_matrix beta = restrict_block(rr, search_old)
+                                    .invert_mul(restrict_to(rrnew, search_old, search));
+            onsites(M.par) {
+                p[X] = r[X] + p[X] * beta;
+            }
+            rr = rrnew;
+        }
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+
+        hila::out0 << "Block Conjugate Gradient: " << nrhs << " right hand sides, " << i
+                   << " steps in " << timing << "ms, ";
+        hila::out0 << "max relative residue:" << max_residue;
+        if (n_search < nrhs)
+            hila::out0 << ", final search block " << n_search;
+        if (restarts > 0)
+            hila::out0 << ", " << restarts << " restarts";
+        hila::out0 << "\n";
+        if (max_residue >= accuracy * accuracy)
+            hila::out0 << "Block Conjugate Gradient: WARNING: not converged, max relative residue "
+                       << max_residue << " > " << accuracy * accuracy << '\n';
+    }
+};
+
+#endif
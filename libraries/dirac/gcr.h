@@ -0,0 +1,199 @@
+#ifndef GCR_ALG
+#define GCR_ALG
+
+///////////////////////////////////////////////////////
+/// Flexible generalized conjugate residual algorithm
+///
+/// Solves field1 = operator * field2 for field2, where the
+/// operator does not need to be hermitean.  An optional
+/// preconditioner (anything with an apply(in, out) -member,
+/// for example Aggregation_multigrid in multigrid.h) is applied
+/// to the residual at each step.  Because the preconditioned
+/// directions are stored, the preconditioner may change
+/// from one step to the next (flexible GCR).
+///
+/// The search space is restarted every restart steps.  Its fields are kept
+/// between apply() calls, so a solver used repeatedly (as the coarse solver
+/// of the multigrid) allocates them only once.
+///////////////////////////////////////////////////////
+
+#include <vector>
+#include <sys/time.h>
+
+constexpr int GCR_DEFAULT_MAXITERS = 10000;
+constexpr double GCR_DEFAULT_ACCURACY = 1e-12;
+constexpr int GCR_DEFAULT_RESTART = 16;
+
+/// The identity preconditioner, default for GCR
+template <typename vector_type> class No_preconditioner {
+  public:
+    void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        out = in;
+    }
+};
+
+/// The flexible GCR operator. Applies the inverse of an operator on a vector
+template <typename Op, typename Prec = No_preconditioner<typename Op::vector_type>>
+class GCR {
+  private:
+    // The operator to invert
+    Op &M;
+    // The preconditioner, nullptr if none
+    Prec *P = nullptr;
+    // desired relative accuracy
+    double accuracy = GCR_DEFAULT_ACCURACY;
+    // maximum number of iterations
+    int maxiters = GCR_DEFAULT_MAXITERS;
+    // length of the search space before restart
+    int restart = GCR_DEFAULT_RESTART;
+    // search space: preconditioned directions z and w = M z, and the lattice
+    // they are allocated on
+    std::vector<Field<typename Op::vector_type>> z, w;
+    lattice_struct *search_lattice = nullptr;
+
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+
+    /// Print a line of statistics after each apply()
+    bool verbose = true;
+    /// Number of steps and relative residue |in - M out| / |in| of the last apply()
+    int iterations = 0;
+    double residue = 0;
+
+    /// Constructor: initialize the operator
+    GCR(Op &op) : M(op){};
+    /// Constructor: operator and accuracy
+    GCR(Op &op, double _accuracy) : M(op) {
+        accuracy = _accuracy;
+    };
+    /// Constructor: operator, accuracy and maximum number of iterations
+    GCR(Op &op, double _accuracy, int _maxiters) : M(op) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+    /// Constructor: operator, preconditioner, accuracy and maximum number of iterations
+    GCR(Op &op, Prec &prec, double _accuracy = GCR_DEFAULT_ACCURACY,
+        int _maxiters = GCR_DEFAULT_MAXITERS)
+        : M(op), P(&prec) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+
+    /// Set the length of the search space
+    void set_restart(int n) {
+        restart = n;
+    }
+    /// Set the relative accuracy
+    void set_accuracy(double acc) {
+        accuracy = acc;
+    }
+    /// Set the maximum number of iterations
+    void set_maxiters(int n) {
+        maxiters = n;
+    }
+
+    /// Solve M out = in, out is used as the initial guess
+    void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        int i;
+        struct timeval start, end;
+        if ((int)z.size() != restart || search_lattice != lattice.ptr()) {
+            z.clear();
+            w.clear();
+            z.resize(restart);
+            w.resize(restart);
+            search_lattice = lattice.ptr();
+        }
+        Field<vector_type> r, Mx;
+        r.copy_boundary_condition(in);
+        Mx.copy_boundary_condition(in);
+        out.copy_boundary_condition(in);
+        for (int k = 0; k < restart; k++) {
+            z[k].copy_boundary_condition(in);
+            w[k].copy_boundary_condition(in);
+        }
+        double rr = 0, source_norm = 0, target_rr;
+
+        gettimeofday(&start, NULL);
+
+        onsites(M.par) {
+            source_norm += in[X].squarenorm();
+        }
+        target_rr = accuracy * accuracy * source_norm;
+
+        M.apply(out, Mx);
+        onsites(M.par) {
+            r[X] = in[X] - Mx[X];
+            rr += r[X].squarenorm();
+        }
+
+        int k = 0;
+        for (i = 0; i < maxiters && rr > target_rr; i++) {
+            Field<vector_type> &zk = z[k];
+            Field<vector_type> &wk = w[k];
+
+            if (P != nullptr)
+                P->apply(r, zk);
+            else
+                zk[M.par] = r[X];
+            M.apply(zk, wk);
+
+            // orthogonalize wk against the previous directions, modified Gram-Schmidt
+            for (int j = 0; j < k; j++) {
+                Field<vector_type> &zj = z[j];
+                Field<vector_type> &wj = w[j];
+                Complex<double> beta = 0;
+                onsites(M.par) {
+                    beta += wj[X].dot(wk[X]);
+                }
+                onsites(M.par) {
+                    wk[X] -= wj[X] * beta;
+                    zk[X] -= zj[X] * beta;
+                }
+            }
+
+            double ww = 0;
+            onsites(M.par) {
+                ww += wk[X].squarenorm();
+            }
+            if (ww == 0)
+                break;
+            double inorm = 1.0 / sqrt(ww);
+            onsites(M.par) {
+                wk[X] *= inorm;
+                zk[X] *= inorm;
+            }
+
+            Complex<double> alpha = 0;
+            onsites(M.par) {
+                alpha += wk[X].dot(r[X]);
+            }
+
+            rr = 0;
+            onsites(M.par) {
+                out[X] += zk[X] * alpha;
+                r[X] -= wk[X] * alpha;
+                rr += r[X].squarenorm();
+            }
+#ifdef DEBUG_GCR
+            hila::out0 << "GCR step " << i << ", residue " << sqrt(rr / target_rr) << "\n";
+#endif
+            if (++k == restart)
+                k = 0;
+        }
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+
+        iterations = i;
+        residue = (source_norm > 0) ? sqrt(rr / source_norm) : 0;
+
+        if (verbose) {
+            hila::out0 << "GCR: " << i << " steps in " << timing << "ms, ";
+            hila::out0 << "relative residue:" << residue << "\n";
+        }
+    }
+};
+
+#endif
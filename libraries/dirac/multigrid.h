@@ -0,0 +1,431 @@
+#ifndef MULTIGRID_ALG
+#define MULTIGRID_ALG
+
+///////////////////////////////////////////////////////
+/// Adaptive aggregation multigrid preconditioner
+///
+/// Two level multigrid for nearest neighbour fermion operators,
+/// in particular Dirac_Wilson.  Used as the preconditioner of the
+/// flexible GCR solver:
+///
+///   Dirac_Wilson<SU<3, double>> Dfull(kappa, U);
+///   Dirac_Wilson_evenodd<SU<3, double>> D(kappa, U);
+///   Aggregation_multigrid<Dirac_Wilson<SU<3, double>>> mg(Dfull, {4, 4, 4, 4}, D.par);
+///   GCR<Dirac_Wilson_evenodd<SU<3, double>>, decltype(mg)> solver(D, mg, 1e-10);
+///   solver.apply(b, x);
+///
+/// Setup (done at the first apply(), or call setup() after the gauge field changes):
+///  - n_vec near-null vectors v_k of the full operator are found by inverse
+///    iteration, v_k <- D^-1 v_k, with unpreconditioned GCR.  The vectors are then
+///    refined (adaptive_passes times) with the multigrid-preconditioned solver itself.
+///  - The lattice is divided to aggregates (blocks) of size blocking, and the
+///    vectors are orthonormalized within each aggregate.  The prolongator is
+///    P c (x) = sum_k c_k(block of x) v_k(x), and the restriction is P^dagger.
+///  - The Galerkin coarse operator P^dagger D P lives on the blocked lattice
+///    lattice.block(blocking), with a n_vec x n_vec matrix on each site and to each
+///    of the 2*NDIM neighbours.  It is computed by probing D with the null vectors
+///    on a checkerboard of aggregates, so that the boundary conditions and any
+///    nearest neighbour terms of D are included as they are.
+///
+/// The cycle: coarse grid correction with a loose GCR solve on the coarse lattice,
+/// followed by minimal residual smoothing on the fine lattice.
+///
+/// With par == EVEN the preconditioner approximates the inverse of the even-odd
+/// preconditioned operator: the source is embedded on the even sites of the full
+/// lattice, and the even sites of D^-1 source are the solution of the even-odd
+/// system when the odd-odd block of D is 1 (no clover term).
+///
+/// Blocking factors must be >= 2 and the blocked lattice size even to all directions.
+///////////////////////////////////////////////////////
+
+#include "dirac/gcr.h"
+
+/// The Galerkin coarse operator on the blocked lattice
+template <int n, typename radix> class Multigrid_coarse_operator {
+  public:
+    using vector_type = Vector<n, Complex<radix>>;
+    using matrix_type = SquareMatrix<n, Complex<radix>>;
+
+    /// The site diagonal and the hopping terms, hop[d] couples x to x + d
+    Field<matrix_type> diag;
+    Field<matrix_type> hop[2 * NDIM];
+
+    /// The parity this operator applies to
+    Parity par = ALL;
+
+    /// Applies the operator to in
+    void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        for (int d = 0; d < 2 * NDIM; d++) {
+            in.start_gather(Direction(d), ALL);
+        }
+
+        out[ALL] = diag[X] * in[X];
+        for (int d = 0; d < 2 * NDIM; d++) {
+            Direction dir = Direction(d);
+            onsites(ALL) {
+                out[X] += hop[dir][X] * in[X + dir];
+            }
+        }
+    }
+};
+
+template <typename Op, int n_vec = 8> class Aggregation_multigrid {
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+    using radix = hila::arithmetic_type<vector_type>;
+    /// Types on the coarse lattice
+    using coarse_vector = Vector<n_vec, Complex<radix>>;
+    using coarse_op_type = Multigrid_coarse_operator<n_vec, radix>;
+
+    /// Inverse iteration steps and GCR steps for each of them
+    int setup_iterations = 3;
+    int setup_solver_iterations = 20;
+    /// Refinements of the null vectors with the multigrid itself
+    int adaptive_passes = 1;
+    /// Minimal residual smoothing steps after the coarse grid correction
+    int smoother_iterations = 4;
+    /// Relative accuracy, maximum number of steps and search space length of the
+    /// coarse solve
+    double coarse_accuracy = 0.05;
+    int coarse_maxiters = 100;
+    int coarse_restart = 8;
+
+  private:
+    // The fine operator, must apply to ALL sites
+    Op &D;
+    // blocking factor from fine to coarse lattice
+    CoordinateVector block_factor;
+    // the parity of the preconditioned system
+    Parity par;
+
+    lattice_struct *fine_lat = nullptr;
+    lattice_struct *coarse_lat = nullptr;
+    bool is_setup = false;
+
+    // near-null vectors on the fine lattice
+    Field<vector_type> null_vec[n_vec];
+
+    coarse_op_type coarse;
+    // coarse source and solution
+    Field<coarse_vector> coarse_r, coarse_e;
+    // the coarse solver keeps its search space between cycles
+    GCR<coarse_op_type> coarse_solver;
+
+    /// Sum of f over each aggregate, result on the first site of the aggregate
+    template <typename T>
+    void block_sum(Field<T> &f) const {
+        Field<T> s, t;
+        foralldir(d) {
+            s = f;
+            for (int i = 1; i < block_factor[d]; i++) {
+                t[ALL] = s[X + d];
+                f[ALL] += t[X];
+                s = t;
+            }
+        }
+    }
+
+    /// Copy the value on the first site of each aggregate to the whole aggregate
+    template <typename T>
+    void block_spread(Field<T> &f) const {
+        Field<T> t;
+        foralldir(d) {
+            int b = block_factor[d];
+            for (int i = 1; i < b; i++) {
+                t[ALL] = f[X - d];
+                onsites(ALL) {
+                    if (X.coordinate(d) % b == i)
+                        f[X] = t[X];
+                }
+            }
+        }
+    }
+
+    /// Restriction c = P^dagger f
+    void restrict_to_coarse(const Field<vector_type> &f, Field<coarse_vector> &c) const {
+        Field<coarse_vector> w;
+        w[ALL] = 0;
+        for (int j = 0; j < n_vec; j++) {
+            const Field<vector_type> &vj = null_vec[j];
+            onsites(ALL) {
+                w[X].e(j) = vj[X].dot(f[X]);
+            }
+        }
+        block_sum(w);
+        c.block_from(w);
+    }
+
+    /// Prolongation f = P c
+    void prolong(const Field<coarse_vector> &c, Field<vector_type> &f) const {
+        Field<coarse_vector> u;
+        u[ALL] = 0;
+        c.unblock_to(u);
+        block_spread(u);
+        f[ALL] = 0;
+        for (int k = 0; k < n_vec; k++) {
+            const Field<vector_type> &vk = null_vec[k];
+            onsites(ALL) {
+                f[X] += vk[X] * u[X].e(k);
+            }
+        }
+    }
+
+    /// Orthonormalize the null vectors within each aggregate
+    void orthonormalize() {
+        Field<Complex<radix>> c;
+        Field<radix> nn;
+        for (int k = 0; k < n_vec; k++) {
+            Field<vector_type> &vk = null_vec[k];
+            for (int j = 0; j < k; j++) {
+                const Field<vector_type> &vj = null_vec[j];
+                c[ALL] = vj[X].dot(vk[X]);
+                block_sum(c);
+                block_spread(c);
+                onsites(ALL) {
+                    vk[X] -= vj[X] * c[X];
+                }
+            }
+            nn[ALL] = vk[X].squarenorm();
+            block_sum(nn);
+            block_spread(nn);
+            onsites(ALL) {
+                vk[X] *= 1 / sqrt(nn[X]);
+            }
+        }
+    }
+
+    /// Galerkin coarse operator, one column k at a time.  The source v_k is put on
+    /// a checkerboard of aggregates, so that each aggregate which sees D v_k receives
+    /// it from known neighbours only
+    void build_coarse_operator() {
+        static hila::timer coarse_op_timer("Multigrid coarse operator");
+        coarse_op_timer.start();
+
+        Field<vector_type> src, res, res_dn;
+        src.copy_boundary_condition(null_vec[0]);
+        res.copy_boundary_condition(null_vec[0]);
+        const CoordinateVector bf = block_factor;
+
+        for (int k = 0; k < n_vec; k++) {
+            const Field<vector_type> &vk = null_vec[k];
+
+            // Site diagonal: source on aggregates of checkerboard parity p
+            for (int p = 0; p < 2; p++) {
+                onsites(ALL) {
+                    int bp = 0;
+                    foralldir(d) bp += X.coordinate(d) / bf[d];
+                    if (bp % 2 == p)
+                        src[X] = vk[X];
+                    else
+                        src[X] = 0;
+                }
+                D.apply(src, res);
+                onsites(ALL) {
+                    int bp = 0;
+                    foralldir(d) bp += X.coordinate(d) / bf[d];
+                    if (bp % 2 != p)
+                        res[X] = 0;
+                }
+                restrict_to_coarse(res, coarse_r);
+
+                // on the coarse lattice the aggregate parity is the site parity
+                Parity cpar = (p == 0) ? EVEN : ODD;
+                lattice.switch_to(coarse_lat);
+                onsites(cpar) {
+                    coarse.diag[X].set_column(k, coarse_r[X]);
+                }
+                lattice.switch_to(fine_lat);
+            }
+
+            // Hopping terms: source on every other layer of aggregates in direction d.
+            // The neighbours x_c + d contribute to the upper boundary sites of the
+            // aggregate x_c, neighbours x_c - d to the lower boundary
+            foralldir(d) {
+                int b = bf[d];
+                for (int p = 0; p < 2; p++) {
+                    onsites(ALL) {
+                        if ((X.coordinate(d) / b) % 2 == p)
+                            src[X] = vk[X];
+                        else
+                            src[X] = 0;
+                    }
+                    D.apply(src, res);
+                    onsites(ALL) {
+                        int c = X.coordinate(d);
+                        res_dn[X] = 0;
+                        if ((c / b) % 2 == p) {
+                            res[X] = 0;
+                        } else if (c % b == 0) {
+                            res_dn[X] = res[X];
+                            res[X] = 0;
+                        } else if (c % b != b - 1) {
+                            res[X] = 0;
+                        }
+                    }
+
+                    restrict_to_coarse(res, coarse_r);
+                    lattice.switch_to(coarse_lat);
+                    onsites(ALL) {
+                        if (X.coordinate(d) % 2 != p)
+                            coarse.hop[d][X].set_column(k, coarse_r[X]);
+                    }
+                    lattice.switch_to(fine_lat);
+
+                    restrict_to_coarse(res_dn, coarse_r);
+                    lattice.switch_to(coarse_lat);
+                    onsites(ALL) {
+                        if (X.coordinate(d) % 2 != p)
+                            coarse.hop[-d][X].set_column(k, coarse_r[X]);
+                    }
+                    lattice.switch_to(fine_lat);
+                }
+            }
+        }
+
+        coarse_op_timer.stop();
+    }
+
+    /// Minimal residual smoothing of D e = r
+    void smooth(const Field<vector_type> &r, Field<vector_type> &e) {
+        Field<vector_type> res, Dres;
+        res.copy_boundary_condition(r);
+        Dres.copy_boundary_condition(r);
+
+        D.apply(e, Dres);
+        res[ALL] = r[X] - Dres[X];
+        for (int i = 0; i < smoother_iterations; i++) {
+            D.apply(res, Dres);
+            Complex<double> a = 0;
+            double dd = 0;
+            onsites(ALL) {
+                a += Dres[X].dot(res[X]);
+                dd += Dres[X].squarenorm();
+            }
+            if (dd == 0)
+                break;
+            Complex<radix> alpha(a.re / dd, a.im / dd);
+            onsites(ALL) {
+                e[X] += res[X] * alpha;
+                res[X] -= Dres[X] * alpha;
+            }
+        }
+    }
+
+    /// The multigrid cycle on the full lattice
+    void cycle(const Field<vector_type> &r, Field<vector_type> &e) {
+        restrict_to_coarse(r, coarse_r);
+
+        lattice.switch_to(coarse_lat);
+        coarse_e[ALL] = 0;
+        coarse_solver.set_accuracy(coarse_accuracy);
+        coarse_solver.set_maxiters(coarse_maxiters);
+        coarse_solver.set_restart(coarse_restart);
+        coarse_solver.apply(coarse_r, coarse_e);
+        lattice.switch_to(fine_lat);
+
+        prolong(coarse_e, e);
+        smooth(r, e);
+    }
+
+  public:
+    /// Constructor: the fine operator (applying to ALL sites), the aggregate size
+    /// and the parity of the preconditioned system
+    Aggregation_multigrid(Op &op, const CoordinateVector &blocking, Parity p = ALL)
+        : D(op), block_factor(blocking), par(p), coarse_solver(coarse) {
+        coarse_solver.verbose = false;
+    }
+
+    /// Build the near-null space, the prolongator and the coarse operator.
+    /// The boundary conditions of the fermion fields are copied from bc_ref
+    void setup(const Field<vector_type> &bc_ref) {
+        static hila::timer setup_timer("Multigrid setup");
+        setup_timer.start();
+        double t0 = hila::gettime();
+
+        fine_lat = lattice.ptr();
+        foralldir(d) {
+            if (block_factor[d] < 2 || lattice.size(d) % block_factor[d] != 0 ||
+                (lattice.size(d) / block_factor[d]) % 2 != 0) {
+                hila::out0 << "Multigrid: blocking " << block_factor
+                           << " must be >= 2 and divide lattice size " << lattice.size()
+                           << " to an even size in each direction\n";
+                hila::terminate(0);
+            }
+        }
+
+        lattice.block(block_factor);
+        coarse_lat = lattice.ptr();
+        coarse_r[ALL] = 0;
+        coarse_e[ALL] = 0;
+        coarse.diag[ALL] = 0;
+        for (int d = 0; d < 2 * NDIM; d++)
+            coarse.hop[d][ALL] = 0;
+        lattice.switch_to(fine_lat);
+
+        // inverse iteration from random vectors
+        GCR<Op> setup_solver(D, 1e-8, setup_solver_iterations);
+        setup_solver.verbose = false;
+        Field<vector_type> x;
+        x.copy_boundary_condition(bc_ref);
+        for (int k = 0; k < n_vec; k++) {
+            Field<vector_type> &vk = null_vec[k];
+            vk.copy_boundary_condition(bc_ref);
+            onsites(ALL) vk[X].gaussian_random();
+            for (int i = 0; i < setup_iterations; i++) {
+                x[ALL] = 0;
+                setup_solver.apply(vk, x);
+                double n2 = x.squarenorm();
+                vk[ALL] = x[X] * (1 / sqrt(n2));
+            }
+        }
+
+        orthonormalize();
+        build_coarse_operator();
+
+        // adaptive refinement: inverse iteration with the multigrid-preconditioned solver.
+        // The prolongator has to match the coarse operator during a pass, so the
+        // refined vectors replace the null vectors only at the end of it
+        is_setup = true;
+        Parity save_par = par;
+        par = ALL;
+        GCR<Op, Aggregation_multigrid> mg_solver(D, *this, 1e-8, setup_solver_iterations / 4 + 1);
+        mg_solver.verbose = false;
+        std::vector<Field<vector_type>> refined(adaptive_passes > 0 ? n_vec : 0);
+        for (int pass = 0; pass < adaptive_passes; pass++) {
+            for (int k = 0; k < n_vec; k++) {
+                refined[k].copy_boundary_condition(bc_ref);
+                refined[k][ALL] = 0;
+                mg_solver.apply(null_vec[k], refined[k]);
+            }
+            for (int k = 0; k < n_vec; k++)
+                null_vec[k] = refined[k];
+            orthonormalize();
+            build_coarse_operator();
+        }
+        par = save_par;
+
+        setup_timer.stop();
+
+        hila::out0 << "Multigrid setup: " << n_vec << " null vectors, coarse lattice "
+                   << coarse_lat->l_size << ", time " << hila::gettime() - t0 << " s\n";
+    }
+
+    /// Apply the preconditioner, out ~ D^-1 in on sites of parity par
+    void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        if (!is_setup)
+            setup(in);
+
+        Field<vector_type> r, e;
+        r.copy_boundary_condition(in);
+        e.copy_boundary_condition(in);
+        r[ALL] = 0;
+        r[par] = in[X];
+
+        cycle(r, e);
+
+        out[par] = e[X];
+    }
+};
+
+#endif
@@ -82,6 +82,13 @@ void dirac_staggered_calc_force(const Field<gaugetype> *gauge, const Field<vtype
     }
 }
 
+/// A bundle of nrhs staggered vectors, stored as the columns of a
+/// matrix on each site. The operators applied to a bundle load each
+/// gauge link once for all the vectors, and the neighbour gathers send
+/// all of them in one message.
+template <typename matrix, int nrhs>
+using staggered_bundle = Matrix<matrix::size, nrhs, Complex<hila::arithmetic_type<matrix>>>;
+
 /// An operator class that applies the staggered Dirac operator
 /// D.apply(in, out) aplies the operator
 /// D.dagger(int out) aplies the conjugate of the operator
@@ -89,7 +96,12 @@ void dirac_staggered_calc_force(const Field<gaugetype> *gauge, const Field<vtype
 /// This is useful for defining inverters as composite
 /// operators. For example the conjugate gradient inverter
 /// is CG<dirac_staggered>.
-template <typename matrix> class dirac_staggered {
+///
+/// With vtype = staggered_bundle<matrix, nrhs> the operator applies to
+/// nrhs vectors at once, see dirac_staggered_multi.
+template <typename matrix,
+          typename vtype = SU_vector<matrix::size, hila::arithmetic_type<matrix>>>
+class dirac_staggered {
   private:
     /// The eta Field in the staggered operator, eta_x,\nu -1^(sum_mu<nu x_\mu)
     Field<double> staggered_eta[NDIM];
@@ -98,7 +110,7 @@ template <typename matrix> class dirac_staggered {
     /// the fermion mass
     double mass;
     /// The SU(N) vector type
-    using vector_type = SU_vector<matrix::size, hila::arithmetic_type<matrix>>;
+    using vector_type = vtype;
     /// The matrix type
     using matrix_type = matrix;
     /// A reference to the gauge links used in the dirac operator
@@ -126,8 +138,8 @@ template <typename matrix> class dirac_staggered {
     }
 
     /// Construct from another Dirac_Wilson operator of a different type.
-    template <typename M>
-    dirac_staggered(dirac_staggered<M> &d, gauge_field_base<matrix> &g)
+    template <typename M, typename V>
+    dirac_staggered(dirac_staggered<M, V> &d, gauge_field_base<matrix> &g)
         : gauge(g.gauge), mass(d.mass) {
         init_staggered_eta(staggered_eta);
     }
@@ -190,7 +202,11 @@ Field<vector> operator*(const Field<vector> &in, dirac_staggered<vector> D) {
 /// As a side effect, the output Field becomes
 /// out = D_{diag}^{-1} D_{odd to even} in
 ///
-template <typename matrix> class dirac_staggered_evenodd {
+/// With vtype = staggered_bundle<matrix, nrhs> the operator applies to
+/// nrhs vectors at once, see dirac_staggered_evenodd_multi.
+template <typename matrix,
+          typename vtype = SU_vector<matrix::size, hila::arithmetic_type<matrix>>>
+class dirac_staggered_evenodd {
   private:
     /// The eta Field in the staggered operator, eta_x,\nu -1^(sum_mu<nu x_\mu)
     Field<double> staggered_eta[NDIM];
@@ -202,7 +218,7 @@ template <typename matrix> class dirac_staggered_evenodd {
     /// the fermion mass
     double mass;
     /// The SU(N) vector type
-    using vector_type = SU_vector<matrix::size, hila::arithmetic_type<matrix>>;
+    using vector_type = vtype;
     /// The matrix type
     using matrix_type = matrix;
 
@@ -229,8 +245,8 @@ template <typename matrix> class dirac_staggered_evenodd {
     }
 
     /// Construct from another Dirac_Wilson operator of a different type.
-    template <typename M>
-    dirac_staggered_evenodd(dirac_staggered_evenodd<M> &d, gauge_field_base<matrix> &g)
+    template <typename M, typename V>
+    dirac_staggered_evenodd(dirac_staggered_evenodd<M, V> &d, gauge_field_base<matrix> &g)
         : gauge(g.gauge), mass(d.mass) {
         init_staggered_eta(staggered_eta);
     }
@@ -278,4 +294,12 @@ template <typename matrix> class dirac_staggered_evenodd {
     }
 };
 
+/// Staggered operators on bundles of nrhs vectors, for solving
+/// several right hand sides at once with block_CG
+template <typename matrix, int nrhs>
+using dirac_staggered_multi = dirac_staggered<matrix, staggered_bundle<matrix, nrhs>>;
+template <typename matrix, int nrhs>
+using dirac_staggered_evenodd_multi =
+    dirac_staggered_evenodd<matrix, staggered_bundle<matrix, nrhs>>;
+
 #endif
\ No newline at end of file
@@ -33,6 +33,47 @@ void get_gauss_violation(const GaugeField<group> &U,
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+/// Sum of G^a G^a over the lattice, the same as
+/// get_gauss_violation(U, E, gauss); gauss.squarenorm();
+/// but the first direction initializes the accumulator and the last
+/// direction is fused with the reduction, saving two passes over the field.
+/// Cheap enough to monitor the violation during time evolution.
+
+template <typename group>
+double gauss_violation_squarenorm(const GaugeField<group> &U,
+                                  const VectorField<Algebra<group>> &E) {
+
+    Field<Algebra<group>> gauss;
+    double viol = 0;
+
+    foralldir(d) {
+        if (d == e_x) {
+            onsites(ALL) {
+                gauss[X] = E[d][X] - (U[d][X - d].dagger() * E[d][X - d].expand() *
+                                      U[d][X - d])
+                                         .project_to_algebra();
+            }
+        } else if (d < NDIM - 1) {
+            onsites(ALL) {
+                gauss[X] += E[d][X] - (U[d][X - d].dagger() * E[d][X - d].expand() *
+                                       U[d][X - d])
+                                          .project_to_algebra();
+            }
+        } else {
+            onsites(ALL) {
+                Algebra<group> g =
+                    gauss[X] + E[d][X] -
+                    (U[d][X - d].dagger() * E[d][X - d].expand() * U[d][X - d])
+                        .project_to_algebra();
+                viol += g.squarenorm();
+            }
+        }
+    }
+    return viol;
+}
+
+
 template <typename group>
 void gauss_fix_step(const GaugeField<group> &U, VectorField<Algebra<group>> &E,
                     const Field<Algebra<group>> &violation,
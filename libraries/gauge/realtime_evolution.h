@@ -0,0 +1,196 @@
+/** @file realtime_evolution.h */
+
+#ifndef REALTIME_EVOLUTION_H_
+#define REALTIME_EVOLUTION_H_
+
+#include "hila.h"
+#include "gauge/staples.h"
+#include "gauge/degauss.h"
+
+/////////////////////////////////////////////////////////////////////////////
+/// Classical real-time (Hamiltonian) evolution of the gauge field U and the
+/// electric field E with the Wilson plaquette Hamiltonian
+///
+///   H = 1/2 sum E^2 + sum_plaq (N - Re Tr P)
+///
+/// Equations of motion
+///   dU_i/dt = E_i U_i
+///   dE_i/dt = - [U_i S_i^dagger]_TA     S_i = staple sum
+///
+/// Typical use:
+/// \code {.cpp}
+///   realtime_evolution<SU<3,double>> evol;
+///   evol.scheme = realtime_evolution<SU<3,double>>::integrator::omelyan;
+///   evol.gauss_check_interval = 10;
+///   evol.evolve(U, E, dt, nsteps);
+///   hila::out0 << "Gauss violation/site " << evol.gauss_violation << '\n';
+/// \endcode
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief E -> E - delta [U S^dagger]_TA for all directions
+ *
+ * The staple, the projection to the algebra and the update of E are fused
+ * into one site loop per direction: the staple sum is kept in registers and
+ * only the lower 'U' parts of the staples are stored (see lower_staples()).
+ *
+ * @param lower Work space for the lower staples, kept by the caller so that
+ *              repeated updates do not allocate it again
+ */
+template <typename group, typename atype = hila::arithmetic_type<group>>
+void realtime_update_E(const GaugeField<group> &U, VectorField<Algebra<group>> &E,
+                       atype delta, std::array<Field<group>, NDIM - 1> &lower) {
+
+    foralldir(d1) {
+        lower_staples(U, d1, lower);
+
+        Direction o1 = staple_direction(d1, 0);
+        const Field<group> &l1 = lower[0];
+#if NDIM > 2
+        Direction o2 = staple_direction(d1, 1);
+        const Field<group> &l2 = lower[1];
+#endif
+#if NDIM > 3
+        Direction o3 = staple_direction(d1, 2);
+        const Field<group> &l3 = lower[2];
+#endif
+
+        onsites(ALL) {
+            group staple = U[o1][X] * U[d1][X + o1] * U[o1][X + d1].dagger() + l1[X - o1];
+#if NDIM > 2
+            staple += U[o2][X] * U[d1][X + o2] * U[o2][X + d1].dagger() + l2[X - o2];
+#endif
+#if NDIM > 3
+            staple += U[o3][X] * U[d1][X + o3] * U[o3][X + d1].dagger() + l3[X - o3];
+#endif
+            E[d1][X] += (U[d1][X] * staple.dagger()).project_to_algebra_scaled(-delta);
+        }
+    }
+}
+
+/**
+ * @brief U -> exp(delta E) U for all directions
+ */
+template <typename group, typename atype = hila::arithmetic_type<group>>
+void realtime_update_U(GaugeField<group> &U, const VectorField<Algebra<group>> &E,
+                       atype delta) {
+
+    foralldir(d) {
+        onsites(ALL) U[d][X] = exp(E[d][X] * delta) * U[d][X];
+    }
+}
+
+/**
+ * @brief Symplectic time evolution of (U, E)
+ *
+ * The integrators are symmetric compositions
+ *   U(a_0 dt) E(b_0 dt) U(a_1 dt) ... E(b_{n-1} dt) U(a_n dt)
+ * which start and end with an U-update, because the E-update (staples) is
+ * the expensive one.  Within evolve() the last U-update of a step is merged
+ * with the first one of the next step.
+ *
+ *  - leapfrog:     2nd order, 1 E-update per step
+ *  - omelyan:      2nd order, 2 E-updates per step, error ~10x smaller than
+ *                  leapfrog (Omelyan, Mryglod, Folk 2003, lambda = 0.1932)
+ *  - forest_ruth:  4th order, 3 E-updates per step (Forest, Ruth 1990)
+ *
+ * If gauss_check_interval > 0, the Gauss law violation per site is measured
+ * every gauss_check_interval steps with gauss_violation_squarenorm().  If
+ * also degauss_quality > 0 and the violation is larger, the fields are
+ * degaussed.
+ */
+template <typename group> class realtime_evolution {
+  public:
+    using atype = hila::arithmetic_type<group>;
+
+    enum class integrator { leapfrog, omelyan, forest_ruth };
+
+    /// Integration scheme used by step() and evolve()
+    integrator scheme = integrator::leapfrog;
+
+    /// Measure Gauss violation every n steps, 0 = never
+    int gauss_check_interval = 0;
+    /// If > 0, degauss when the violation/site exceeds this
+    double degauss_quality = 0;
+
+    /// Last measured and maximum Gauss violation per site
+    double gauss_violation = 0;
+    double max_gauss_violation = 0;
+    /// Number of E-updates done (each is a full staple computation)
+    int64_t E_updates = 0;
+
+  private:
+    /// Lower staples of realtime_update_E(), allocated on the first step
+    std::array<Field<group>, NDIM - 1> lower;
+
+    /// Coefficients of the U- and E-updates, a.size() == b.size() + 1
+    void coefficients(std::vector<double> &a, std::vector<double> &b) const {
+        switch (scheme) {
+        case integrator::omelyan: {
+            constexpr double lambda = 0.1931833275037836;
+            a = {lambda, 1.0 - 2.0 * lambda, lambda};
+            b = {0.5, 0.5};
+            break;
+        }
+        case integrator::forest_ruth: {
+            const double theta = 1.0 / (2.0 - cbrt(2.0));
+            a = {theta / 2, (1.0 - theta) / 2, (1.0 - theta) / 2, theta / 2};
+            b = {theta, 1.0 - 2.0 * theta, theta};
+            break;
+        }
+        default:
+            a = {0.5, 0.5};
+            b = {1.0};
+        }
+    }
+
+    void check_gauss(const GaugeField<group> &U, VectorField<Algebra<group>> &E) {
+        gauss_violation = gauss_violation_squarenorm(U, E) / lattice.volume();
+        max_gauss_violation = std::max(max_gauss_violation, gauss_violation);
+        if (degauss_quality > 0 && gauss_violation > degauss_quality)
+            degauss(U, E, degauss_quality);
+    }
+
+  public:
+    /// Evolve (U, E) by nsteps steps of length dt.  U and E are at the same
+    /// time at the end
+    void evolve(GaugeField<group> &U, VectorField<Algebra<group>> &E, double dt,
+                int nsteps) {
+
+        static hila::timer evolve_timer("Real-time evolution");
+        evolve_timer.start();
+
+        std::vector<double> a, b;
+        coefficients(a, b);
+
+        // U-update carried over from the previous step
+        double pending = 0;
+        for (int step = 0; step < nsteps; step++) {
+            for (int k = 0; k < (int)b.size(); k++) {
+                realtime_update_U(U, E, (atype)((pending + a[k]) * dt));
+                pending = 0;
+                realtime_update_E(U, E, (atype)(b[k] * dt), lower);
+                E_updates++;
+            }
+            pending = a.back();
+
+            if (gauss_check_interval > 0 && (step + 1) % gauss_check_interval == 0) {
+                // synchronize U and E before measuring
+                realtime_update_U(U, E, (atype)(pending * dt));
+                pending = 0;
+                check_gauss(U, E);
+            }
+        }
+        if (pending != 0)
+            realtime_update_U(U, E, (atype)(pending * dt));
+
+        evolve_timer.stop();
+    }
+
+    /// A single synchronized step
+    void step(GaugeField<group> &U, VectorField<Algebra<group>> &E, double dt) {
+        evolve(U, E, dt, 1);
+    }
+};
+
+#endif
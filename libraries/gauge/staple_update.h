@@ -0,0 +1,74 @@
+/** @file staple_update.h */
+
+#ifndef STAPLE_UPDATE_H_
+#define STAPLE_UPDATE_H_
+
+#include "hila.h"
+#include "gauge/staples.h"
+#include "gauge/sun_heatbath.h"
+#include "gauge/sun_overrelax.h"
+
+/**
+ * @brief Heatbath or overrelaxation update of the links to direction d on parity par,
+ * with the staple sum fused into the update loop
+ *
+ * Equivalent to
+ *
+ * \code {.cpp}
+ * staplesum(U, staples, d, par);
+ * onsites(par) suN_heatbath(U[d][X], staples[X], beta);  // or suN_overrelax()
+ * \endcode
+ *
+ * but the staple sum is kept in registers and used directly, so the staples field
+ * is not written and read back.  Only the lower 'U' parts of the staples, on the
+ * opposite parity, are stored (see lower_staples()).
+ *
+ * The links on parity par are updated while their neighbours are read, thus
+ * par has to be EVEN or ODD.
+ *
+ * @param U GaugeField to update
+ * @param d Direction of the links
+ * @param par Parity, EVEN or ODD
+ * @param beta Coupling
+ * @param relax If true, overrelaxation, otherwise heatbath
+ */
+template <typename group>
+void staple_update(GaugeField<group> &U, Direction d, Parity par, double beta, bool relax) {
+
+    assert(par == EVEN || par == ODD);
+
+    std::array<Field<group>, NDIM - 1> lower;
+    lower_staples(U, d, lower, par);
+
+    Direction o1 = staple_direction(d, 0);
+    const Field<group> &l1 = lower[0];
+#if NDIM > 2
+    Direction o2 = staple_direction(d, 1);
+    const Field<group> &l2 = lower[1];
+#endif
+#if NDIM > 3
+    Direction o3 = staple_direction(d, 2);
+    const Field<group> &l3 = lower[2];
+#endif
+
+    onsites(par) {
+        group staple = U[o1][X] * U[d][X + o1] * U[o1][X + d].dagger() + l1[X - o1];
+#if NDIM > 2
+        staple += U[o2][X] * U[d][X + o2] * U[o2][X + d].dagger() + l2[X - o2];
+#endif
+#if NDIM > 3
+        staple += U[o3][X] * U[d][X + o3] * U[o3][X + d].dagger() + l3[X - o3];
+#endif
+        if (relax) {
+#ifdef SUN_OVERRELAX_dFJ
+            suN_overrelax_dFJ(U[d][X], staple, beta);
+#else
+            suN_overrelax(U[d][X], staple);
+#endif
+        } else {
+            suN_heatbath(U[d][X], staple, beta);
+        }
+    }
+}
+
+#endif
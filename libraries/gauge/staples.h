@@ -115,4 +115,51 @@ void staplesum(const GaugeField<T> &U, Field<T> &staples, Direction d1,
     }
 }
 
+/**
+ * @brief The k:th direction orthogonal to d1, k = 0 ... NDIM-2
+ */
+inline Direction staple_direction(Direction d1, int k) {
+    return Direction((d1 + 1 + k) % NDIM);
+}
+
+/**
+ * @brief Lower 'U' parts of the staples of links to direction d1
+ *
+ * For each orthogonal direction d2 = staple_direction(d1, k) computes
+ *
+ * \code {.cpp}
+ *     lower[k][X] = U[d2][X].dagger() * U[d1][X] * U[d2][X + d1]
+ * \endcode
+ *
+ * on sites of opposite parity to par, and starts the gather lower[k][X - d2] to par.
+ * With these the full staple can be summed in registers in the loop that uses it:
+ *
+ * \code {.cpp}
+ *     staple = U[d2][X] * U[d1][X + d2] * U[d2][X + d1].dagger() + lower[k][X - d2] + ...
+ * \endcode
+ *
+ * Computing the lower staple directly would need the offset X - d2 + d1, which makes
+ * hilapp allocate and fill a shifted copy of U[d2].
+ *
+ * @param U GaugeField
+ * @param d1 Direction of the links
+ * @param lower Fields for the lower staples
+ * @param par Parity of the links
+ */
+template <typename T>
+void lower_staples(const GaugeField<T> &U, Direction d1, std::array<Field<T>, NDIM - 1> &lower,
+                   Parity par = ALL) {
+
+    for (int k = 0; k < NDIM - 1; k++) {
+        Direction d2 = staple_direction(d1, k);
+        Field<T> &lk = lower[k];
+
+        U[d2].start_gather(d1, opp_parity(par));
+        onsites(opp_parity(par)) {
+            lk[X] = U[d2][X].dagger() * U[d1][X] * U[d2][X + d1];
+        }
+        lk.start_gather(-d2, par);
+    }
+}
+
 #endif
\ No newline at end of file
@@ -4,86 +4,337 @@
 #include "gauge_field.h"
 #include "dirac/Hasenbusch.h"
 #include <cmath>
+#include <vector>
 
-/// Builds an initial guess for a matrix inverter given a set of basis vectors
-template <typename vector_type, typename DIRAC_OP>
-void MRE_guess(Field<vector_type> &psi, Field<vector_type> &chi, DIRAC_OP D,
-               std::vector<Field<vector_type>> old_chi_inv) {
-    int MRE_size = old_chi_inv.size();
-    double M[MRE_size][MRE_size];
-    double v[MRE_size];
-    Field<vector_type> basis[MRE_size];
-    Field<vector_type> tmp;
-
-    // Build an orthogonal basis from the previous solutions
-    for (int i = 0; i < MRE_size; i++) {
-        // Start with the original solution vector
-        basis[i][ALL] = old_chi_inv[i][X];
-        // Remove the projected components of all previous vectors
-        for (int j = 0; j < i; j++) {
-            double vdot = 0, norm = 0;
-            onsites(D.par) {
-                norm += basis[i][X].rdot(basis[i][X]);
-                vdot += basis[j][X].rdot(basis[i][X]);
+/// The basis vectors of MRE_basis on one site
+template <typename T, int n>
+struct MRE_site_vectors {
+    using base_type = hila::arithmetic_type<T>;
+    using argument_type = T;
+
+    T v[n];
+};
+
+constexpr int MRE_DEFAULT_MAX_SOLUTIONS = 8;
+
+/// Chronological initial guess for the inversion of D^dagger D.
+///
+/// Keeps an orthonormal basis q_i of the space spanned by the last max_size
+/// solutions and the images of A = D^dagger D on it, projected to the basis,
+/// G_ij = q_i^dagger A q_j.  These are updated incrementally when a new
+/// solution is added:
+///  - the solution is orthogonalized against the basis (modified Gram-Schmidt,
+///    where each projection is fused with the next inner product),
+///  - its image is computed with one application of D^dagger D,
+///  - when the window is full, the direction contributed only by the oldest
+///    solution is rotated to the end of the basis with a Householder reflection
+///    and dropped.
+/// Each step costs O(max_size) vector operations.
+///
+/// The guess for A psi = chi minimizes the A-norm of the error in the span of
+/// the basis, solving G c = Q^dagger chi.  It needs no operator applications.
+/// The images are computed with the gauge field at the time the solution was
+/// added, which only affects the quality of the guess.
+///
+/// The basis vectors are stored together on each site, so that the inner products
+/// with all of them are computed in one site loop.  Space for max_solutions + 1
+/// vectors is reserved, the largest size of the basis before the oldest is dropped.
+
+template <typename DIRAC_OP, int max_solutions = MRE_DEFAULT_MAX_SOLUTIONS> class MRE_basis {
+  public:
+    using vector_type = typename DIRAC_OP::vector_type;
+
+  private:
+    int max_size = 0;
+    // number of basis vectors
+    int n_basis = 0;
+    // orthonormal basis, vector i on each site is Q[X].v[i]
+    Field<MRE_site_vectors<vector_type, max_solutions + 1>> Q;
+    // G[i][j] = q_i^dagger A q_j
+    std::vector<std::vector<Complex<double>>> G;
+    // coordinates of the stored solutions in the basis, oldest first
+    std::vector<std::vector<Complex<double>>> sol;
+
+    /// Solve the small hermitean system G c = v with pivoted Gaussian elimination.
+    /// Directions with a vanishing pivot are left out
+    std::vector<Complex<double>> solve_small(std::vector<Complex<double>> v) const {
+        int m = v.size();
+        auto M = G;
+
+        double scale = 0;
+        for (int i = 0; i < m; i++)
+            scale = std::max(scale, M[i][i].abs());
+
+        std::vector<bool> skip(m, false);
+        for (int i = 0; i < m; i++) {
+            int p = i;
+            for (int k = i + 1; k < m; k++)
+                if (M[k][i].abs() > M[p][i].abs())
+                    p = k;
+            std::swap(M[i], M[p]);
+            std::swap(v[i], v[p]);
+
+            if (M[i][i].abs() <= 1e-14 * scale) {
+                skip[i] = true;
+                continue;
             }
-            if (norm * norm > 1e-32) {
-                onsites(D.par) { basis[i][X] = basis[i][X] - vdot / norm * basis[j][X]; }
+            for (int k = i + 1; k < m; k++) {
+                Complex<double> f = M[k][i] / M[i][i];
+                for (int j = i; j < m; j++)
+                    M[k][j] -= f * M[i][j];
+                v[k] -= f * v[i];
             }
         }
+
+        std::vector<Complex<double>> c(m, 0);
+        for (int i = m - 1; i >= 0; i--) {
+            if (skip[i])
+                continue;
+            Complex<double> s = v[i];
+            for (int j = i + 1; j < m; j++)
+                s -= M[i][j] * c[j];
+            c[i] = s / M[i][i];
+        }
+        return c;
     }
 
-    // Build the projected matrix, M[i][j] = v[i].v[j]
-    for (int i = 0; i < MRE_size; i++) {
-        Field<vector_type> Dchi, DDchi;
-        D.apply(basis[i], Dchi);
-        D.dagger(Dchi, DDchi);
-        for (int j = 0; j < MRE_size; j++) {
-            double sum = 0;
-            onsites(D.par) { sum += basis[j][X].rdot(DDchi[X]); }
-            M[j][i] = sum;
+    /// Remove the oldest solution.  If it has a component outside the span of the
+    /// other solutions, rotate that direction to the last basis vector and drop it
+    void drop_oldest(Parity par) {
+        int m = n_basis;
+        std::vector<Complex<double>> u = sol.front();
+        sol.erase(sol.begin());
+
+        // orthogonalize u against the remaining solution coordinates
+        std::vector<std::vector<Complex<double>>> e;
+        for (auto &a : sol) {
+            std::vector<Complex<double>> b = a;
+            for (auto &ej : e) {
+                Complex<double> d = 0;
+                for (int i = 0; i < m; i++)
+                    d += ej[i].conj() * b[i];
+                for (int i = 0; i < m; i++)
+                    b[i] -= d * ej[i];
+            }
+            double bn = 0;
+            for (int i = 0; i < m; i++)
+                bn += b[i].squarenorm();
+            if (bn > 1e-20) {
+                for (int i = 0; i < m; i++)
+                    b[i] /= sqrt(bn);
+                e.push_back(b);
+            }
+        }
+        double un0 = 0;
+        for (int i = 0; i < m; i++)
+            un0 += u[i].squarenorm();
+        for (auto &ej : e) {
+            Complex<double> d = 0;
+            for (int i = 0; i < m; i++)
+                d += ej[i].conj() * u[i];
+            for (int i = 0; i < m; i++)
+                u[i] -= d * ej[i];
+        }
+        double un = 0;
+        for (int i = 0; i < m; i++)
+            un += u[i].squarenorm();
+
+        // oldest solution is in the span of the others, basis stays
+        if (un <= 1e-20 * un0 || un == 0)
+            return;
+        for (int i = 0; i < m; i++)
+            u[i] /= sqrt(un);
+
+        // Householder reflection W = 1 - 2 w w^dagger / (w^dagger w), with W u ~ e_last
+        double phi = u[m - 1].arg();
+        std::vector<Complex<double>> w = u;
+        w[m - 1] -= Complex<double>(cos(phi), sin(phi));
+        double ww = 0;
+        for (int i = 0; i < m; i++)
+            ww += w[i].squarenorm();
+
+        if (ww > 1e-28) {
+            // Q -> Q W, i.e. q_j -= (2/ww) (Q w) w_j^*
+            std::vector<Complex<double>> f(m);
+            for (int j = 0; j < m; j++)
+                f[j] = -(2.0 / ww) * w[j].conj();
+            onsites(par) {
+                vector_type y = 0;
+                for (int i = 0; i < m; i++)
+                    y += Q[X].v[i] * w[i];
+                for (int j = 0; j < m; j++)
+                    Q[X].v[j] += y * f[j];
+            }
+
+            // a -> W a for column vectors
+            auto reflect = [&](std::vector<Complex<double>> &a) {
+                Complex<double> d = 0;
+                for (int i = 0; i < m; i++)
+                    d += w[i].conj() * a[i];
+                for (int i = 0; i < m; i++)
+                    a[i] -= (2.0 / ww) * d * w[i];
+            };
+            // G -> W G W: rows of G W are conj(W conj(row)), then columns W col
+            for (int i = 0; i < m; i++) {
+                for (auto &g : G[i])
+                    g = g.conj();
+                reflect(G[i]);
+                for (auto &g : G[i])
+                    g = g.conj();
+            }
+            for (int j = 0; j < m; j++) {
+                std::vector<Complex<double>> col(m);
+                for (int i = 0; i < m; i++)
+                    col[i] = G[i][j];
+                reflect(col);
+                for (int i = 0; i < m; i++)
+                    G[i][j] = col[i];
+            }
+            // solution coordinates, Q a = Q W W a
+            for (auto &a : sol)
+                reflect(a);
         }
+
+        n_basis--;
+        G.pop_back();
+        for (auto &g : G)
+            g.pop_back();
+        for (auto &a : sol)
+            a.pop_back();
     }
-    // And the projected vector
-    for (int i = 0; i < MRE_size; i++) {
-        double sum = 0;
-        onsites(D.par) { sum += basis[i][X].rdot(chi[X]); }
-        v[i] = sum;
+
+  public:
+    /// Set the number of solutions kept, at most max_solutions, clearing the basis
+    void setup(int size) {
+        if (size > max_solutions) {
+            hila::out0 << "MRE guess: " << size << " solutions requested, at most "
+                       << max_solutions << " allowed\n";
+            hila::terminate(1);
+        }
+        max_size = size;
+        clear();
     }
 
-    // Now invert the small matrix M (Gaussian elimination)
-    for (int i = 0; i < MRE_size; i++) {
-        // Check that the diagonal element is nonzero
-        if (M[i][i] * M[i][i] > 1e-32) {
-            // Normalize the i:th row
-            double diag_inv = 1.0 / M[i][i];
-            for (int j = 0; j < MRE_size; j++) {
-                M[i][j] *= diag_inv;
-            }
-            v[i] *= diag_inv;
-            // Subtract from all other rows
-            for (int k = 0; k < MRE_size; k++)
-                if (k != i) {
-                    double weight = M[k][i];
-                    for (int j = 0; j < MRE_size; j++) {
-                        M[k][j] -= weight * M[i][j];
-                    }
-                    v[k] -= weight * v[i];
-                }
+    /// Forget all solutions
+    void clear() {
+        n_basis = 0;
+        G.clear();
+        sol.clear();
+    }
+
+    /// Number of basis vectors
+    int size() const {
+        return n_basis;
+    }
+
+    /// Build the initial guess psi for D^dagger D psi = chi
+    void guess(const Field<vector_type> &chi, Field<vector_type> &psi, DIRAC_OP &D) {
+        psi[ALL] = 0;
+        int m = n_basis;
+        if (m == 0)
+            return;
+
+        // Q^dagger chi
+        ReductionVector<Complex<double>> v(m);
+        v = 0;
+        onsites(D.par) {
+            for (int i = 0; i < m; i++)
+                v[i] += Q[X].v[i].dot(chi[X]);
+        }
+
+        std::vector<Complex<double>> c = solve_small(v.vector());
+        onsites(D.par) {
+            for (int i = 0; i < m; i++)
+                psi[X] += Q[X].v[i] * c[i];
+        }
+    }
+
+    /// Add a new solution to the basis
+    void add(const Field<vector_type> &psi, DIRAC_OP &D) {
+        if (max_size <= 0)
+            return;
+
+        int m = n_basis;
+        Field<vector_type> r;
+        r.copy_boundary_condition(psi);
+        r[ALL] = 0;
+        r[D.par] = psi[X];
+
+        double rr0 = 0;
+        onsites(D.par) rr0 += r[X].squarenorm();
+        if (rr0 == 0)
+            return;
+
+        // modified Gram-Schmidt, each projection fused with the next inner product
+        std::vector<Complex<double>> a(m + 1, 0);
+        double rr = 0;
+        if (m > 0) {
+            Complex<double> d = 0;
+            onsites(D.par) d += Q[X].v[0].dot(r[X]);
+            a[0] = d;
         } else {
-            // In the matrix element is too small, just remove it from the basis
-            v[i] = 0;
-            for (int j = 0; j < MRE_size; j++) {
-                M[j][i] = 0;
+            rr = rr0;
+        }
+        for (int i = 0; i < m; i++) {
+            Complex<double> ai = a[i];
+            if (i + 1 < m) {
+                Complex<double> d = 0;
+                onsites(D.par) {
+                    r[X] -= Q[X].v[i] * ai;
+                    d += Q[X].v[i + 1].dot(r[X]);
+                }
+                a[i + 1] = d;
+            } else {
+                onsites(D.par) {
+                    r[X] -= Q[X].v[i] * ai;
+                    rr += r[X].squarenorm();
+                }
             }
         }
-    }
 
-    // Construct the solution in the original basis
-    psi[ALL] = 0;
-    for (int i = 0; i < MRE_size; i++)
-        if (!isnan(v[i])) {
-            onsites(D.par) { psi[X] = basis[i][X] + v[i] * basis[i][X]; }
+        if (rr > 1e-20 * rr0) {
+            // new direction: normalize and project its image to the basis
+            double inorm = 1.0 / sqrt(rr);
+            r[D.par] = r[X] * inorm;
+            a[m] = sqrt(rr);
+
+            Field<vector_type> Dr, Ar;
+            Dr.copy_boundary_condition(psi);
+            Ar.copy_boundary_condition(psi);
+            D.apply(r, Dr);
+            D.dagger(Dr, Ar);
+
+            // the new row of G, Q^dagger A r and r^dagger A r
+            ReductionVector<Complex<double>> g(m + 1);
+            g = 0;
+            onsites(D.par) {
+                for (int i = 0; i < m; i++)
+                    g[i] += Q[X].v[i].dot(Ar[X]);
+                g[m] += r[X].dot(Ar[X]);
+            }
+            g[m] = g[m].re;
+
+            for (int i = 0; i < m; i++) {
+                G[i].push_back(g[i]);
+            }
+            std::vector<Complex<double>> row(m + 1);
+            for (int i = 0; i < m; i++)
+                row[i] = g[i].conj();
+            row[m] = g[m];
+            G.push_back(row);
+
+            onsites(D.par) Q[X].v[m] = r[X];
+            n_basis++;
+            for (auto &b : sol)
+                b.push_back(0);
+        } else {
+            a.pop_back();
         }
-}
+        sol.push_back(a);
+
+        if ((int)sol.size() > max_size)
+            drop_oldest(D.par);
+    }
+};
 
-#endif
\ No newline at end of file
+#endif
@@ -27,10 +27,9 @@ class fermion_action : public action_base {
     DIRAC_OP &D;
     Field<vector_type> chi;
 
-    /// We save a few previous invertions to build an initial guess.
-    /// old_chi contains a list of these
+    /// We keep a basis of a few previous invertions to build an initial guess
     int MRE_size = 0;
-    std::vector<Field<vector_type>> old_chi_inv;
+    MRE_basis<DIRAC_OP> MRE;
 
     void setup(int mre_guess_size) {
 #if NDIM > 3
@@ -38,10 +37,7 @@ class fermion_action : public action_base {
         chi.set_boundary_condition(-e_t, hila::bc::ANTIPERIODIC);
 #endif
         MRE_size = mre_guess_size;
-        old_chi_inv.resize(MRE_size);
-        for (int i = 0; i < MRE_size; i++) {
-            old_chi_inv[i][ALL] = 0;
-        }
+        MRE.setup(MRE_size);
     }
 
     fermion_action(DIRAC_OP &d, gauge_field &g) : D(d), gauge(g) {
@@ -61,11 +57,11 @@ class fermion_action : public action_base {
 
     /// Build an initial guess for the fermion matrix inversion
     /// by inverting first in the limited space of a few previous
-    /// solutions. These are saved in old_chi.
+    /// solutions. These are kept in MRE.
     void initial_guess(Field<vector_type> &chi, Field<vector_type> &psi) {
         psi[ALL] = 0;
         if (MRE_size > 0) {
-            MRE_guess(psi, chi, D, old_chi_inv);
+            MRE.guess(chi, psi, D);
         }
         // If the gauge type is double precision, solve first in single precision
         if constexpr (std::is_same<double, typename gauge_field::basetype>::value) {
@@ -133,12 +129,7 @@ class fermion_action : public action_base {
 
     /// Add new solution to the list for MRE
     void save_new_solution(Field<vector_type> &psi) {
-        if (MRE_size > 0) {
-            for (int i = 1; i < MRE_size; i++) {
-                old_chi_inv[i] = old_chi_inv[i - 1];
-            }
-            old_chi_inv[0] = psi;
-        }
+        MRE.add(psi, D);
     }
 
     /// Update the momentum with the derivative of the fermion
@@ -214,10 +205,9 @@ class Hasenbusch_action_2 : public action_base {
     double mh;
     Field<vector_type> chi;
 
-    // We save a few previous invertions to build an initial guess.
-    // old_chi contains a list of these
+    // We keep a basis of a few previous invertions to build an initial guess
     int MRE_size = 0;
-    std::vector<Field<vector_type>> old_chi_inv;
+    MRE_basis<DIRAC_OP> MRE;
 
     void setup(int mre_guess_size) {
 #if NDIM > 3
@@ -225,10 +215,7 @@ class Hasenbusch_action_2 : public action_base {
         chi.set_boundary_condition(-e_t, hila::bc::ANTIPERIODIC);
 #endif
         MRE_size = mre_guess_size;
-        old_chi_inv.resize(MRE_size);
-        for (int i = 0; i < MRE_size; i++) {
-            old_chi_inv[i][ALL] = 0;
-        }
+        MRE.setup(MRE_size);
     }
 
     Hasenbusch_action_2(DIRAC_OP &d, gauge_field &g, double _mh)
@@ -310,11 +297,11 @@ class Hasenbusch_action_2 : public action_base {
 
     /// Build an initial guess for the fermion matrix inversion
     /// by inverting first in the limited space of a few previous
-    /// solutions. These are saved in old_chi.
+    /// solutions. These are kept in MRE.
     void initial_guess(Field<vector_type> &chi, Field<vector_type> &psi) {
         psi[ALL] = 0;
         if (MRE_size > 0) {
-            MRE_guess(psi, chi, D, old_chi_inv);
+            MRE.guess(chi, psi, D);
         }
         // If the gauge type is double precision, solve first in single precision
         if constexpr (std::is_same<double, typename gauge_field::basetype>::value) {
@@ -336,12 +323,7 @@ class Hasenbusch_action_2 : public action_base {
 
     /// Add new solution to the list
     void save_new_solution(Field<vector_type> &psi) {
-        if (MRE_size > 0) {
-            for (int i = 1; i < MRE_size; i++) {
-                old_chi_inv[i] = old_chi_inv[i - 1];
-            }
-            old_chi_inv[0] = psi;
-        }
+        MRE.add(psi, D);
     }
 
     /// Update the momentum with the derivative of the fermion
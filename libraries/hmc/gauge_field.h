@@ -439,6 +439,31 @@ class gauge_momentum_action : public action_base, public integrator_base {
 
     /// Update the gauge field with momentum
     void step(double eps) { gauge.gauge_update(eps); }
+
+    /// Save the state for a force-gradient trial update and zero the momentum
+    void save_trial_state() {
+        foralldir(dir) {
+            trial_gauge[dir] = gauge.get_gauge(dir);
+            trial_momentum[dir] = gauge.get_momentum(dir);
+        }
+        gauge.zero_momentum();
+    }
+
+    /// Move the gauge field along the force accumulated in the momentum,
+    /// then restore the momentum
+    void trial_step(double eps) {
+        gauge.gauge_update(eps);
+        foralldir(dir) gauge.get_momentum(dir) = trial_momentum[dir];
+    }
+
+    /// Restore the gauge field saved in save_trial_state()
+    void restore_trial_state() {
+        foralldir(dir) gauge.get_gauge(dir) = trial_gauge[dir];
+    }
+
+  private:
+    /// Storage for the force-gradient trial update
+    Field<typename gauge_field::fund_type> trial_gauge[NDIM], trial_momentum[NDIM];
 };
 
 /// The Wilson plaquette action of a gauge field.
@@ -3,17 +3,41 @@
 
 #include <sys/time.h>
 #include <ctime>
+#include <type_traits>
+#include <vector>
 #include "integrator.h"
 
+/// true if integrator_type has level_actions(std::vector<double> &)
+template <class integrator_type, class = void>
+struct has_level_actions : std::false_type {};
+template <class integrator_type>
+struct has_level_actions<integrator_type,
+                         std::void_t<decltype(std::declval<integrator_type &>().level_actions(
+                             std::declval<std::vector<double> &>()))>> : std::true_type {};
+
+/// The action of each integrator level, or the total action as the only element
+/// if the integrator does not implement level_actions()
+template <class integrator_type>
+std::vector<double> hmc_level_actions(integrator_type &integrator) {
+    std::vector<double> levels;
+    if constexpr (has_level_actions<integrator_type>::value)
+        integrator.level_actions(levels);
+    else
+        levels.push_back(integrator.action());
+    return levels;
+}
+
 /// The Hybrid Montecarlo algorithm.
 // Consists of an integration step following equations of
 // motion implemented in the integrator class gt
 // and an accept-reject step using the action
 //
-// The integrator class must implement at least two functions,
-// action() an integrator_step(double eps)
+// The integrator class must implement at least the functions
+// action() and step(double eps).  With report_levels the change of the
+// action of each level is printed, this uses level_actions() if implemented.
 template <class integrator_type>
-void update_hmc(integrator_type &integrator, int steps, double traj_length) {
+void update_hmc(integrator_type &integrator, int steps, double traj_length,
+                bool report_levels = false) {
 
     static int accepted = 0, trajectory = 1;
     struct timeval start, end;
@@ -27,8 +51,15 @@ void update_hmc(integrator_type &integrator, int steps, double traj_length) {
 
     gettimeofday(&start, NULL);
 
-    // Calculate the starting action and print
-    double start_action = integrator.action();
+    // Calculate the starting action, by level if reported, and print
+    std::vector<double> start_levels;
+    if (report_levels)
+        start_levels = hmc_level_actions(integrator);
+    else
+        start_levels.push_back(integrator.action());
+    double start_action = 0;
+    for (double a : start_levels)
+        start_action += a;
     hila::out0 << "Begin HMC Trajectory " << trajectory << ": Action " << start_action
             << "\n";
 
@@ -38,7 +69,14 @@ void update_hmc(integrator_type &integrator, int steps, double traj_length) {
     }
 
     // Recalculate the action
-    double end_action = integrator.action();
+    std::vector<double> end_levels;
+    if (report_levels)
+        end_levels = hmc_level_actions(integrator);
+    else
+        end_levels.push_back(integrator.action());
+    double end_action = 0;
+    for (double a : end_levels)
+        end_action += a;
     double edS = exp(-(end_action - start_action));
 
     // Accept or reject
@@ -56,6 +94,15 @@ void update_hmc(integrator_type &integrator, int steps, double traj_length) {
             << " exp(-dS) " << edS << ". Acceptance " << accepted << "/" << trajectory
             << " " << (double)accepted / (double)trajectory << "\n";
 
+    // The change of the action of each integrator level, from the outermost level
+    // down to the momentum, for tuning the step sizes
+    if (report_levels && start_levels.size() > 1) {
+        hila::out0 << "HMC dS by level:";
+        for (size_t i = 0; i < start_levels.size(); i++)
+            hila::out0 << " " << end_levels[i] - start_levels[i];
+        hila::out0 << "\n";
+    }
+
     gettimeofday(&end, NULL);
     timing = (double)(end.tv_sec - start.tv_sec) + 1e-6 * (end.tv_usec - start.tv_usec);
 
@@ -3,6 +3,7 @@
 
 #include <sys/time.h>
 #include <ctime>
+#include <vector>
 
 /// Define the standard action term class.
 /// Action terms are used in the HMC algorithm and
@@ -101,6 +102,19 @@ class integrator_base {
 
     /// Run a lower level integrator step
     virtual void step(double eps) {}
+
+    /// Trial gauge update for force-gradient steps, implemented at the
+    /// lowest level (the momentum action):
+    /// save_trial_state() stores the gauge field and the momentum and zeroes
+    /// the momentum, trial_step() moves the gauge field along the momentum
+    /// accumulated since and restores the saved momentum, and
+    /// restore_trial_state() restores the saved gauge field, keeping the momentum
+    virtual void save_trial_state() {}
+    virtual void trial_step(double eps) {}
+    virtual void restore_trial_state() {}
+
+    /// Append the action of each level, from this level down
+    virtual void level_actions(std::vector<double> &a) { a.push_back(action()); }
 };
 
 /// Build integrator hierarchically by adding a force step on
@@ -147,6 +161,28 @@ class action_term_integrator : public integrator_base {
 
     /// Update the gauge field with momentum
     void momentum_step(double eps) { lower_integrator.step(eps); }
+
+    /// Trial gauge updates are done at the lowest level
+    void save_trial_state() { lower_integrator.save_trial_state(); }
+    void trial_step(double eps) { lower_integrator.trial_step(eps); }
+    void restore_trial_state() { lower_integrator.restore_trial_state(); }
+
+    /// The action term of this level, followed by the lower levels
+    void level_actions(std::vector<double> &a) {
+        a.push_back(action_term.action());
+        lower_integrator.level_actions(a);
+    }
+
+    /// Hessian-free force-gradient update of the momentum, approximating
+    /// P -> P + eps F + c F.grad F, where F is the force of this level only.
+    /// The force is evaluated at the gauge field displaced by c F
+    void force_gradient_step(double eps, double c) {
+        save_trial_state();
+        force_step(c);
+        trial_step(1.0);
+        force_step(eps);
+        restore_trial_state();
+    }
 };
 
 /// Define an integration step for a Molecular Dynamics
@@ -174,6 +210,8 @@ class leapfrog_integrator : public action_term_integrator {
 class O2_integrator : public action_term_integrator {
   public:
     int n = 1;
+    /// The Omelyan parameter, tunable per level
+    double lambda = 0.1931833275037836;
 
     O2_integrator(action_base &a, integrator_base &i, int steps)
         : action_term_integrator(a, i), n(steps) {}
@@ -181,7 +219,7 @@ class O2_integrator : public action_term_integrator {
 
     // Run the integrator update
     void step(double eps) {
-        double zeta = eps * 0.1931833275037836;
+        double zeta = eps * lambda;
         double middlestep = eps - 2 * zeta;
         for (int i = 0; i < n; i++) {
             this->lower_integrator.step(zeta / n);
@@ -197,4 +235,71 @@ class O2_integrator : public action_term_integrator {
     }
 };
 
+/// Fourth order Omelyan integrator (Omelyan, Mryglod and Folk 2003,
+/// scheme with 5 force evaluations, force steps at the ends).
+/// The momentum is updated with the force 6 times and the lower level
+/// integrator is stepped 5 times per step.
+class O4_integrator : public action_term_integrator {
+  public:
+    int n = 1;
+    /// The Omelyan parameters, tunable per level
+    double theta = 0.08398315262876693;
+    double rho = 0.2539785108410595;
+    double lambda = 0.6822365335719091;
+    double mu = -0.03230286765269967;
+
+    O4_integrator(action_base &a, integrator_base &i, int steps)
+        : action_term_integrator(a, i), n(steps) {}
+    O4_integrator(action_base &a, integrator_base &i) : action_term_integrator(a, i) {}
+
+    // Run the integrator update
+    void step(double eps) {
+        double force_coeff[3] = {theta, lambda, 0.5 - lambda - theta};
+        double lower_coeff[3] = {rho, mu, 1 - 2 * (mu + rho)};
+
+        for (int k = 0; k < 3; k++) {
+            force_step(force_coeff[k] * eps);
+            lower_steps(lower_coeff[k] * eps);
+        }
+        for (int k = 2; k >= 0; k--) {
+            force_step(force_coeff[k] * eps);
+            if (k > 0)
+                lower_steps(lower_coeff[k - 1] * eps);
+        }
+    }
+
+  private:
+    void lower_steps(double eps) {
+        for (int i = 0; i < n; i++)
+            this->lower_integrator.step(eps / n);
+    }
+};
+
+/// Fourth order force-gradient integrator (Hessian-free, see Yin and
+/// Mawhinney 2011):
+///   P(eps/6) U(eps/2) P'(2 eps/3) U(eps/2) P(eps/6)
+/// where the middle momentum update P' uses the force of this level evaluated
+/// at the gauge field displaced by eps^2/24 times the force.  This needs
+/// 3 force evaluations per step.
+class force_gradient_integrator : public action_term_integrator {
+  public:
+    int n = 1;
+
+    force_gradient_integrator(action_base &a, integrator_base &i, int steps)
+        : action_term_integrator(a, i), n(steps) {}
+    force_gradient_integrator(action_base &a, integrator_base &i)
+        : action_term_integrator(a, i) {}
+
+    // Run the integrator update
+    void step(double eps) {
+        force_step(eps / 6);
+        for (int i = 0; i < n; i++)
+            this->lower_integrator.step(0.5 * eps / n);
+        force_gradient_step(2 * eps / 3, eps * eps / 24);
+        for (int i = 0; i < n; i++)
+            this->lower_integrator.step(0.5 * eps / n);
+        force_step(eps / 6);
+    }
+};
+
 #endif
@@ -22,7 +22,11 @@
 #%   EVEN_SITES_FIRST=0      - store sites in logical "typewriter" order, mixing EVEN and ODD
 #%         sites. Default layout stores even lattice sites first, enabling efficient
 #%         looping over parities (EVEN/ODD).
+#%   CACHE_BLOCKED_LAYOUT=n  - store sites of each parity in blocks of n^NDIM sites instead of
+#%         typewriter order, for cache reuse in stencil loops (non-vectorized archs only)
 #%   NO_INTERLEAVE=1         - turn off compute during MPI communications (default: on)
+#%   LOOP_PROFILE=1          - insert timing probes around all site loops, reported
+#%         at the end of the run grouped by function (hilapp option -loop-profile)
 #% GPU-relevant options:
 #%   GPU_AWARE_MPI=0         - turn off GPU aware MPI (default: on) 
 #%   GPU_SYNCHRONIZE_TIMERS=1 - Synchronize timers with GPU kernels.
@@ -99,9 +103,12 @@ HILA_OBJECTS = \
 	build/Targets/map_node_layout.o \
 	build/Targets/memalloc.o \
 	build/Targets/timing.o \
+	build/Targets/trace.o \
 	build/Targets/test_gathers.o \
 	build/Targets/com_mpi.o \
-	build/Targets/fft.o
+	build/Targets/fft.o \
+	build/Targets/compress.o \
+	build/Targets/block_file.o
 
 # Remvoved com_simple.o, require MPI
 
@@ -141,10 +148,18 @@ HILA_OPTS += -DEVEN_SITES_FIRST=0
 endif
 endif
 
+ifdef CACHE_BLOCKED_LAYOUT
+HILA_OPTS += -DCACHE_BLOCKED_LAYOUT=$(CACHE_BLOCKED_LAYOUT)
+endif
+
 ifdef NO_INTERLEAVE
 HILAPP_OPTS += --no-interleave
 endif
 
+ifdef LOOP_PROFILE
+HILAPP_OPTS += -loop-profile
+endif
+
 ifdef GPU_SYNCHRONIZE_TIMERS
 HILA_OPTS += -DGPU_SYNCHRONIZE_TIMERS
 endif
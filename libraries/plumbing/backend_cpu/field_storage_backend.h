@@ -20,7 +20,9 @@ inline void field_storage<T>::set(const T &value, const unsigned i,
 
 template <typename T>
 void field_storage<T>::allocate_field(const Lattice lattice) {
-    fieldbuf = (T *)memalloc(sizeof(T) * lattice->mynode.field_alloc_size);
+    fieldbuf = (T *)field_memalloc(sizeof(T) * lattice->mynode.field_alloc_size,
+                                   sizeof(T) * lattice->mynode.evensites,
+                                   sizeof(T) * lattice->mynode.oddsites);
     if (fieldbuf == nullptr) {
         std::cout << "Failure in Field memory allocation\n";
         exit(1);
@@ -31,8 +33,7 @@ void field_storage<T>::allocate_field(const Lattice lattice) {
 template <typename T>
 void field_storage<T>::free_field() {
 #pragma acc exit data delete (fieldbuf)
-    if (fieldbuf != nullptr)
-        free(fieldbuf);
+    field_memfree(fieldbuf);
     fieldbuf = nullptr;
 }
 
@@ -64,20 +64,22 @@ using vector_type = typename vectorize_struct<T, hila::vector_info<T>::vector_si
 template <typename T>
 void field_storage<T>::allocate_field(const Lattice lattice) {
     if constexpr (hila::is_vectorizable_type<T>::value) {
-        fieldbuf = (T *)memalloc(
+        fieldbuf = (T *)field_memalloc(
             lattice->backend_lattice->get_vectorized_lattice<hila::vector_info<T>::vector_size>()
-                ->field_alloc_size() *
-            sizeof(T));
+                    ->field_alloc_size() *
+                sizeof(T),
+            sizeof(T) * lattice->mynode.evensites, sizeof(T) * lattice->mynode.oddsites);
     } else {
-        fieldbuf = (T *)memalloc(sizeof(T) * lattice->mynode.field_alloc_size);
+        fieldbuf = (T *)field_memalloc(sizeof(T) * lattice->mynode.field_alloc_size,
+                                       sizeof(T) * lattice->mynode.evensites,
+                                       sizeof(T) * lattice->mynode.oddsites);
     }
 }
 
 template <typename T>
 void field_storage<T>::free_field() {
 #pragma acc exit data delete (fieldbuf)
-    if (fieldbuf != nullptr)
-        free(fieldbuf);
+    field_memfree(fieldbuf);
     fieldbuf = nullptr;
 }
 
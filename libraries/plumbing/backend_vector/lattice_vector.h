@@ -20,8 +20,8 @@ struct vectorized_lattice_struct {
     static_assert(vector_size > 0, "Vector size in vectorized_lattice_struct");
 
   public:
-    /// pointer to the original lattice
-    // lattice_struct *lattice;
+    /// pointer to the lattice this is built on (the base lattice or a blocked one)
+    lattice_struct *mylattice;
 
     /// vector sites on this node
     size_t v_sites;
@@ -65,7 +65,7 @@ struct vectorized_lattice_struct {
 
     /// Check if this is the first subnode
     bool is_on_first_subnode(CoordinateVector v) {
-        v = v.mod(lattice.size());
+        v = v.mod(mylattice->l_size);
         foralldir (d) {
             if (v[d] < subnode_origin[d] || v[d] >= subnode_origin[d] + subnode_size[d])
                 return false;
@@ -87,26 +87,42 @@ struct vectorized_lattice_struct {
     ///   index_in_vector(32) = index_in_vector(64) + (vector_index(64)%2)*vector_size(64)
     /// This removes the last direction where number of subnodes is divisible
     /////////////////////////////////////////////////////////////////////////////////////////////
-    vectorized_lattice_struct() {
+    vectorized_lattice_struct(lattice_struct *lat) {
         /// Initialize
+        mylattice = lat;
 
         /// sites on vector
-        v_sites = lattice->mynode.volume / vector_size;
-        subdivisions = lattice->mynode.subnodes.divisions;
-        subnode_size = lattice->mynode.subnodes.size;
-        subnode_origin = lattice->mynode.min;
+        v_sites = mylattice->mynode.volume / vector_size;
+        subdivisions = mylattice->mynode.subnodes.divisions;
+        subnode_size = mylattice->mynode.subnodes.size;
+        subnode_origin = mylattice->mynode.min;
 
         // hila::out0 << "Subdivisions " << subdivisions << '\n';
 
         assert(v_sites % 2 == 0);   // must be even for now
 
+        if (v_sites == 0) {
+            // rank without sites of an agglomerated blocked lattice
+            for (Direction d = (Direction)0; d < NDIRS; d++) {
+                is_boundary_permutation[abs(d)] = false;
+                only_local_boundary_copy[d] = false;
+                halo_offset[d] = halo_offset_odd[d] = n_halo_vectors[d] = 0;
+                halo_index[d] = recv_list[d] = neighbours[d] = nullptr;
+                recv_list_size[d] = 0;
+            }
+            coordinate_base = nullptr;
+            vec_wait_arr_ = nullptr;
+            alloc_size = 0;
+            return;
+        }
+
         // the basic division is done using "float" vectors -
         // for "double" vectors the vector_size and number of subnodes
-        // is halved to direction lattice->mynode.subnodes.lastype_divided.dir
+        // is halved to direction mylattice->mynode.subnodes.lastype_divided.dir
 
         if (vector_size == VECTOR_SIZE / sizeof(double)) {
-            subdivisions[lattice->mynode.subnodes.merged_subnodes_dir] /= 2;
-            subnode_size[lattice->mynode.subnodes.merged_subnodes_dir] *= 2;
+            subdivisions[mylattice->mynode.subnodes.merged_subnodes_dir] /= 2;
+            subnode_size[mylattice->mynode.subnodes.merged_subnodes_dir] *= 2;
         }
 
         hila::out0 << "Setting up lattice struct with vector of size " << vector_size
@@ -146,19 +162,19 @@ struct vectorized_lattice_struct {
             here = subnode_origin + subnode_size;
             here.asArray() -= 1;
 
-            unsigned idx = lattice->site_index(here);
+            unsigned idx = mylattice->site_index(here);
             assert(idx % vector_size == 0); // is it really on 1st subnode
 
             // loop over subnodes
             for (int i = 0; i < vector_size; i++) {
 
                 // get the site index of the neighbouring site
-                CoordinateVector h = lattice->coordinates(idx + i) + d;
+                CoordinateVector h = mylattice->coordinates(idx + i) + d;
 
                 // remember to mod the coordinate on lattice
-                h = h.mod(lattice.size());
-                int rank = lattice->node_rank(h);
-                unsigned nn = lattice->site_index(h, rank);
+                h = h.mod(mylattice->l_size);
+                int rank = mylattice->node_rank(h);
+                unsigned nn = mylattice->site_index(h, rank);
                 boundary_permutation[d][i] = nn % vector_size;
             }
 
@@ -188,7 +204,7 @@ struct vectorized_lattice_struct {
         // make no difference
 
         foralldir (d) {
-            if (lattice->nodes.n_divisions[d] == 1 && !is_boundary_permutation[d]) {
+            if (mylattice->nodes.n_divisions[d] == 1 && !is_boundary_permutation[d]) {
                 only_local_boundary_copy[d] = only_local_boundary_copy[-d] = true;
             } else {
                 only_local_boundary_copy[d] = only_local_boundary_copy[-d] = false;
@@ -202,21 +218,21 @@ struct vectorized_lattice_struct {
             halo_offset[d] = c_offset;
             for (int i = 0; i < v_sites; i++) {
                 int j = vector_size * i; // the "original lattice" index for the 1st site of vector
-                CoordinateVector here = lattice->coordinates(j);
+                CoordinateVector here = mylattice->coordinates(j);
                 // std::cout << here << '\n';
 
                 if (is_on_first_subnode(here + d)) {
 
-                    assert(lattice->neighb[d][j] % vector_size == 0); // consistency check
+                    assert(mylattice->neighb[d][j] % vector_size == 0); // consistency check
                     Direction ad = abs(d);
 
                     if (only_local_boundary_copy[d] &&
-                        ((is_up_dir(d) && here[ad] == lattice.size(ad) - 1) ||
+                        ((is_up_dir(d) && here[ad] == mylattice->l_size[ad] - 1) ||
                          (is_up_dir(-d) && here[ad] == 0))) {
                         neighbours[d][i] = c_offset++;
                     } else {
                         // standard branch, within the subnode
-                        neighbours[d][i] = lattice->neighb[d][j] / vector_size;
+                        neighbours[d][i] = mylattice->neighb[d][j] / vector_size;
                     }
                 } else {
                     neighbours[d][i] = c_offset++; // now points beyond the lattice
@@ -240,13 +256,13 @@ struct vectorized_lattice_struct {
                         int k, n = -1;
                         bool found = false;
                         for (k = 0; k < vector_size; k++) {
-                            if (lattice->neighb[d][i * vector_size + k] < lattice->mynode.volume) {
+                            if (mylattice->neighb[d][i * vector_size + k] < mylattice->mynode.volume) {
                                 if (!found) {
-                                    n = lattice->neighb[d][i * vector_size + k] / vector_size;
+                                    n = mylattice->neighb[d][i * vector_size + k] / vector_size;
                                     found = true;
                                 } else
                                     assert(n ==
-                                           lattice->neighb[d][i * vector_size + k] / vector_size);
+                                           mylattice->neighb[d][i * vector_size + k] / vector_size);
                             }
                         }
                         assert(n >= 0);
@@ -262,8 +278,8 @@ struct vectorized_lattice_struct {
                 int j = 0;
                 for (int i = 0; i < v_sites; i++) {
                     if (neighbours[d][i] >= v_sites) {
-                        halo_index[d][j++] = lattice->neighb[d][i * vector_size] / vector_size;
-                        assert(lattice->neighb[d][i * vector_size] % vector_size == 0);
+                        halo_index[d][j++] = mylattice->neighb[d][i * vector_size] / vector_size;
+                        assert(mylattice->neighb[d][i * vector_size] % vector_size == 0);
                     }
                 }
 
@@ -285,19 +301,19 @@ struct vectorized_lattice_struct {
     void get_receive_lists() {
 
         for (Direction d = (Direction)0; d < NDIRS; d++) {
-            if (is_boundary_permutation[abs(d)] && lattice->nodes.n_divisions[abs(d)] > 1) {
+            if (is_boundary_permutation[abs(d)] && mylattice->nodes.n_divisions[abs(d)] > 1) {
 
                 // now need to receive and copy - note: now this is in terms of
                 // non-vector sites.   Set the recv_list to point to where to move the
                 // stuff Note: now the stuff has to be moved to boundary_halo, not to
                 // lattice n!
 
-                recv_list_size[d] = lattice->mynode.volume / lattice->mynode.size[abs(d)];
+                recv_list_size[d] = mylattice->mynode.volume / mylattice->mynode.size[abs(d)];
                 recv_list[d] = (unsigned *)memalloc(recv_list_size[d] * sizeof(unsigned));
 
                 int j = 0;
-                for (int i = 0; i < lattice->mynode.volume; i++) {
-                    if (lattice->neighb[d][i] >= lattice->mynode.volume) {
+                for (int i = 0; i < mylattice->mynode.volume; i++) {
+                    if (mylattice->neighb[d][i] >= mylattice->mynode.volume) {
 
                         // i/vector_size is the "vector index" of site, and
                         // i % vector_size the index within the vector.
@@ -324,9 +340,9 @@ struct vectorized_lattice_struct {
     void set_coordinates() {
 
         /// first vector_size elements should give the coordinates of vector offsets
-        CoordinateVector base = lattice->coordinates(0);
+        CoordinateVector base = mylattice->coordinates(0);
         for (int i = 0; i < vector_size; i++) {
-            CoordinateVector diff = lattice->coordinates(i) - base;
+            CoordinateVector diff = mylattice->coordinates(i) - base;
             foralldir (d)
                 coordinate_offset[d].insert(i, diff[d]);
         }
@@ -334,7 +350,7 @@ struct vectorized_lattice_struct {
         // and then set the coordinate_base with the original coords
         coordinate_base = (CoordinateVector *)memalloc(v_sites * sizeof(CoordinateVector));
         for (int i = 0; i < v_sites; i++) {
-            coordinate_base[i] = lattice->coordinates(vector_size * i);
+            coordinate_base[i] = mylattice->coordinates(vector_size * i);
         }
     }
 
@@ -349,7 +365,7 @@ struct vectorized_lattice_struct {
             vec_wait_arr_[i] = 0; /* basic, no wait */
             foralldir (dir) {
                 Direction odir = -dir;
-                if (lattice->nodes.n_divisions[dir] > 1) {
+                if (mylattice->nodes.n_divisions[dir] > 1) {
                     if (neighbours[dir][i] >= v_sites)
                         vec_wait_arr_[i] = vec_wait_arr_[i] | (1 << dir);
                     if (neighbours[odir][i] >= v_sites)
@@ -425,23 +441,29 @@ struct vectorized_lattice_struct {
 
 struct backend_lattice_struct {
 
-    void setup(const lattice_struct &lat) {}
+    /// the lattice this belongs to, and its vectorized lattices indexed by vector size
+    lattice_struct *mylattice = nullptr;
+    void *vectorized_lattice[hila::number_of_subnodes + 1] = {nullptr};
+
+    void setup(lattice_struct &lat) {
+        mylattice = &lat;
+    }
 
-    /// Returns a vectorized lattice with given vector size
+    /// Returns a vectorized lattice with given vector size.  Each lattice (the base
+    /// lattice and the blocked lattices) has its own, created on first use
     template <int vector_size>
     vectorized_lattice_struct<vector_size> *get_vectorized_lattice() {
-        // Create one if not already created
-
-        assert(lattice.ptr() == defined_lattices.at(0) &&
-               "Vectorized lattice layout only possible with main (original) lattice");
+        static_assert(vector_size <= hila::number_of_subnodes,
+                      "Vector size larger than the number of subnodes");
 
-
-        static vectorized_lattice_struct<vector_size> *vlat = nullptr;
-        if (vlat == nullptr) {
-            vlat = new vectorized_lattice_struct<vector_size>();
+        // Create one if not already created
+        if (vectorized_lattice[vector_size] == nullptr) {
+            vectorized_lattice[vector_size] =
+                new vectorized_lattice_struct<vector_size>(mylattice);
         }
 
-        return vlat;
+        return static_cast<vectorized_lattice_struct<vector_size> *>(
+            vectorized_lattice[vector_size]);
     }
 };
 
@@ -0,0 +1,50 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hila.h"
+#include "plumbing/block_file.h"
+
+//////////////////////////////////////////////////////////////////
+// Memory mapping for block files, see block_file.h
+//////////////////////////////////////////////////////////////////
+
+namespace hila {
+
+bool mapped_file::open(const std::string &filename) {
+    close();
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close();
+        return false;
+    }
+    len = st.st_size;
+
+    void *p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    addr = static_cast<char *>(p);
+
+    // blocks are read in arbitrary order, no use for readahead
+    madvise(addr, len, MADV_RANDOM);
+    return true;
+}
+
+void mapped_file::close() {
+    if (addr != nullptr)
+        munmap(addr, len);
+    if (fd >= 0)
+        ::close(fd);
+    addr = nullptr;
+    fd = -1;
+    len = 0;
+}
+
+} // namespace hila
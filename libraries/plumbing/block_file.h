@@ -0,0 +1,351 @@
+#ifndef HILA_BLOCK_FILE_H_
+#define HILA_BLOCK_FILE_H_
+
+//////////////////////////////////////////////////////////////////////
+/// Random access Field files
+///
+/// The lattice is divided into blocks (default 8^NDIM, smaller at the edges if the
+/// block does not divide the lattice), stored one after another.  Inside a block sites
+/// are in x-fastest order.  Because the header contains an index of block offsets,
+/// any rank can read any part of the file on its own:
+///
+///     hila::write_block_file("phi.blk", phi);         // collective, MPI-IO
+///
+///     hila::block_file<double> bf("phi.blk");         // not collective, mmap
+///     bf.read(phi);                                    // each rank reads its own sites
+///     bf.read(phi, cmin, cmax);                        // only sites in box cmin..cmax
+///     std::vector<double> v = bf.read_subvolume(cmin, cmax);  // box, x fastest
+///
+/// The file is mapped to memory, so only the pages of the blocks which are needed are
+/// actually read.
+///
+/// File layout (int64):
+///    block_file_flag, version, NDIM, sizeof(T), lattice size[NDIM], block size[NDIM],
+///    n_blocks, data_offset, block offsets[n_blocks], padding, block data
+/// The blocks are numbered x-fastest, data_offset is a multiple of 4096.
+//////////////////////////////////////////////////////////////////////
+
+#include "plumbing/field.h"
+
+namespace hila {
+
+constexpr int64_t block_file_flag = 394824244;
+constexpr int64_t block_file_version = 1;
+
+struct block_file_header {
+    int64_t flag, version, ndim, element_size;
+    int64_t size[NDIM];
+    int64_t block[NDIM];
+    int64_t n_blocks, data_offset;
+
+    /// number of blocks to direction d
+    int64_t n_blocks_dir(Direction d) const {
+        return (size[d] + block[d] - 1) / block[d];
+    }
+
+    /// box of block b
+    void block_box(int64_t b, CoordinateVector &bmin, CoordinateVector &bmax) const {
+        foralldir(d) {
+            int64_t nb = n_blocks_dir(d);
+            bmin[d] = (b % nb) * block[d];
+            bmax[d] = std::min(bmin[d] + block[d], size[d]) - 1;
+            b /= nb;
+        }
+    }
+
+    /// number of sites in box bmin..bmax
+    static size_t box_volume(const CoordinateVector &bmin, const CoordinateVector &bmax) {
+        size_t v = 1;
+        foralldir(d) v *= bmax[d] - bmin[d] + 1;
+        return v;
+    }
+
+    /// block containing coordinate c
+    int64_t block_of(const CoordinateVector &c) const {
+        int64_t b = 0;
+        for (int d = NDIM - 1; d >= 0; d--)
+            b = b * n_blocks_dir((Direction)d) + c[d] / block[d];
+        return b;
+    }
+};
+
+/// Read only memory map of a file
+class mapped_file {
+  public:
+    mapped_file() = default;
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+    ~mapped_file() {
+        close();
+    }
+
+    /// Returns false if the file cannot be opened or mapped
+    bool open(const std::string &filename);
+    void close();
+
+    const char *data() const {
+        return addr;
+    }
+    size_t size() const {
+        return len;
+    }
+
+  private:
+    int fd = -1;
+    char *addr = nullptr;
+    size_t len = 0;
+};
+
+/// Write Field to a block file.  Collective.  Blocks inside one rank are written by it,
+/// blocks split between ranks are gathered to the rank of the first site
+template <typename T>
+void write_block_file(const std::string &filename, const Field<T> &f, int block = 8) {
+    static int trace_id = hila::trace_register("Field write_block_file");
+    hila::trace_scope trace_io(trace_id);
+
+    Lattice lat = f.fs->mylattice;
+
+    block_file_header h;
+    h.flag = block_file_flag;
+    h.version = block_file_version;
+    h.ndim = NDIM;
+    h.element_size = sizeof(T);
+    h.n_blocks = 1;
+    foralldir(d) {
+        h.size[d] = lat.size(d);
+        h.block[d] = std::min<int64_t>(block, h.size[d]);
+        h.n_blocks *= h.n_blocks_dir(d);
+    }
+    int64_t header_bytes = sizeof(h) + h.n_blocks * sizeof(int64_t);
+    h.data_offset = (header_bytes + 4095) / 4096 * 4096;
+
+    std::vector<int64_t> offset(h.n_blocks);
+    int64_t pos = h.data_offset;
+    for (int64_t b = 0; b < h.n_blocks; b++) {
+        CoordinateVector bmin, bmax;
+        h.block_box(b, bmin, bmax);
+        offset[b] = pos;
+        pos += h.box_volume(bmin, bmax) * sizeof(T);
+    }
+
+    MPI_Comm comm = lat.ptr()->mpi_comm_lat;
+    MPI_File fh;
+    if (MPI_File_open(comm, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                      &fh) != MPI_SUCCESS) {
+        hila::out0 << "ERROR in opening file " << filename << '\n';
+        hila::terminate(4);
+    }
+    MPI_File_set_size(fh, pos);
+
+    if (hila::myrank() == 0) {
+        MPI_File_write_at(fh, 0, &h, sizeof(h), MPI_BYTE, MPI_STATUS_IGNORE);
+        MPI_File_write_at(fh, sizeof(h), offset.data(), h.n_blocks * sizeof(int64_t), MPI_BYTE,
+                          MPI_STATUS_IGNORE);
+    }
+
+    std::vector<T> buf, tmp;
+    std::vector<size_t> sitepos;
+    std::vector<unsigned> index_list;
+    for (int64_t b = 0; b < h.n_blocks; b++) {
+        CoordinateVector bmin, bmax;
+        h.block_box(b, bmin, bmax);
+        size_t bvol = h.box_volume(bmin, bmax);
+
+        int owner = lat->node_rank(bmin);
+        node_info ni = lat->nodes.nodeinfo(owner);
+        bool split = false;
+        foralldir(d) split = split || bmax[d] >= ni.min[d] + ni.size[d];
+
+        buf.resize(bvol);
+        if (split) {
+            f.fs->gather_box_elements(buf.data(), bmin, bmax, 0, bvol, owner);
+        } else if (owner == hila::myrank()) {
+            sitepos.clear();
+            index_list.clear();
+            lat->box_sites_on_node(ni, bmin, bmax, 0, bvol, sitepos, &index_list);
+            tmp.resize(index_list.size());
+            f.fs->payload.gather_elements(tmp.data(), index_list.data(), index_list.size(), lat);
+            for (size_t i = 0; i < sitepos.size(); i++)
+                buf[sitepos[i]] = tmp[i];
+        }
+
+        if (owner == hila::myrank())
+            MPI_File_write_at(fh, offset[b], buf.data(), bvol * sizeof(T), MPI_BYTE,
+                              MPI_STATUS_IGNORE);
+    }
+
+    MPI_File_close(&fh);
+}
+
+/// Reading of block files, see the top of the file.  Opening and all reads are local
+/// to the calling rank, no communication
+template <typename T>
+class block_file {
+  private:
+    mapped_file mf;
+    block_file_header h;
+    const int64_t *offset = nullptr;
+    std::string fname;
+    bool ok = false;
+
+    /// byte position of the site at c
+    size_t site_offset(const CoordinateVector &c) const {
+        int64_t b = h.block_of(c);
+        size_t pos = 0;
+        for (int d = NDIM - 1; d >= 0; d--) {
+            int64_t bmin = (c[d] / h.block[d]) * h.block[d];
+            int64_t bsize = std::min(bmin + h.block[d], h.size[d]) - bmin;
+            pos = pos * bsize + (c[d] - bmin);
+        }
+        return offset[b] + pos * sizeof(T);
+    }
+
+  public:
+    block_file(const std::string &filename) : fname(filename) {
+        if (!mf.open(filename)) {
+            hila::out << "ERROR in opening block file " << filename << '\n';
+            return;
+        }
+        if (mf.size() < 4 * sizeof(int64_t)) {
+            hila::out << "ERROR: " << filename << " is not a block file\n";
+            return;
+        }
+        std::memcpy(&h, mf.data(), 4 * sizeof(int64_t));
+        if (h.flag != block_file_flag || h.version != block_file_version) {
+            hila::out << "ERROR: " << filename << " is not a block file or has unknown version\n";
+        } else if (h.ndim != NDIM || h.element_size != sizeof(T)) {
+            hila::out << "ERROR: block file " << filename << " has dimension " << h.ndim
+                      << " and element size " << h.element_size << ", should be " << NDIM
+                      << " and " << sizeof(T) << '\n';
+        } else if (mf.size() >= sizeof(h)) {
+            std::memcpy(&h, mf.data(), sizeof(h));
+            offset = reinterpret_cast<const int64_t *>(mf.data() + sizeof(h));
+            ok = mf.size() >= h.data_offset && h.data_offset >= sizeof(h) + h.n_blocks * 8;
+            if (ok && h.n_blocks > 0) {
+                CoordinateVector bmin, bmax;
+                h.block_box(h.n_blocks - 1, bmin, bmax);
+                ok = mf.size() >= offset[h.n_blocks - 1] + h.box_volume(bmin, bmax) * sizeof(T);
+            }
+        }
+        if (!ok && h.flag == block_file_flag)
+            hila::out << "ERROR: block file " << filename << " is truncated or corrupt\n";
+    }
+
+    /// file opened successfully
+    bool is_open() const {
+        return ok;
+    }
+
+    /// lattice size of the file
+    CoordinateVector size() const {
+        CoordinateVector s;
+        foralldir(d) s[d] = h.size[d];
+        return s;
+    }
+
+    /// Box cmin..cmax of the stored field, in x-fastest order
+    std::vector<T> read_subvolume(const CoordinateVector &cmin, const CoordinateVector &cmax) const {
+        assert(ok && "block_file not open");
+        size_t vol = 1;
+        foralldir(d) {
+            assert(cmin[d] >= 0 && cmax[d] >= cmin[d] && cmax[d] < h.size[d] &&
+                   "subvolume outside stored lattice");
+            vol *= cmax[d] - cmin[d] + 1;
+        }
+        std::vector<T> res(vol);
+        size_t i = 0;
+        CoordinateVector c;
+        forcoordinaterange(c, cmin, cmax) {
+            std::memcpy(&res[i++], mf.data() + site_offset(c), sizeof(T));
+        }
+        return res;
+    }
+
+    /// Read the sites of box cmin..cmax (default all) of this rank to field f.
+    /// Stored and field lattices must be the same size
+    void read(Field<T> &f, const CoordinateVector &cmin, const CoordinateVector &cmax) const {
+        static int trace_id = hila::trace_register("Field block_file read");
+        hila::trace_scope trace_io(trace_id);
+
+        if (!f.is_allocated())
+            f.allocate();
+
+        Lattice lat = f.fs->mylattice;
+        bool good = ok;
+        foralldir(d) good = good && (h.size[d] == lat.size(d));
+        if (!good) {
+            hila::out << "ERROR: block file " << fname << " does not match the lattice\n";
+            hila::terminate(1);
+        }
+
+        // box on this rank
+        const auto &mn = lat->mynode;
+        CoordinateVector rmin, rmax;
+        foralldir(d) {
+            rmin[d] = std::max(cmin[d], mn.min[d]);
+            rmax[d] = std::min(cmax[d], mn.min[d] + mn.size[d] - 1);
+            if (rmin[d] > rmax[d]) {
+                f.mark_changed(ALL);
+                return;
+            }
+        }
+
+        node_info ni = lat->nodes.nodeinfo(hila::myrank());
+        std::vector<T> tmp;
+        std::vector<size_t> sitepos;
+        std::vector<unsigned> index_list;
+
+        // loop over blocks which touch the box
+        CoordinateVector bc, bcmin, bcmax;
+        foralldir(d) {
+            bcmin[d] = rmin[d] / h.block[d];
+            bcmax[d] = rmax[d] / h.block[d];
+        }
+        forcoordinaterange(bc, bcmin, bcmax) {
+            CoordinateVector bmin, bmax, size;
+            foralldir(d) {
+                bmin[d] = std::max<int64_t>(bc[d] * h.block[d], rmin[d]);
+                bmax[d] = std::min<int64_t>((bc[d] + 1) * h.block[d] - 1, rmax[d]);
+                size[d] = bmax[d] - bmin[d] + 1;
+            }
+            size_t n = h.box_volume(bmin, bmax);
+
+            sitepos.clear();
+            index_list.clear();
+            lat->box_sites_on_node(ni, bmin, bmax, 0, n, sitepos, &index_list);
+            tmp.resize(index_list.size());
+            for (size_t i = 0; i < sitepos.size(); i++) {
+                CoordinateVector c;
+                size_t p = sitepos[i];
+                foralldir(d) {
+                    c[d] = bmin[d] + p % size[d];
+                    p /= size[d];
+                }
+                std::memcpy(&tmp[i], mf.data() + site_offset(c), sizeof(T));
+            }
+            f.fs->payload.place_elements(tmp.data(), index_list.data(), index_list.size(), lat);
+        }
+
+        f.mark_changed(ALL);
+    }
+
+    void read(Field<T> &f) const {
+        CoordinateVector cmin(0), cmax;
+        foralldir(d) cmax[d] = h.size[d] - 1;
+        read(f, cmin, cmax);
+    }
+};
+
+/// Read Field from a block file written with write_block_file
+template <typename T>
+void read_block_file(const std::string &filename, Field<T> &f) {
+    block_file<T> bf(filename);
+    int failed = bf.is_open() ? 0 : 1;
+    if (hila::reduce_node_sum(failed) > 0)
+        hila::terminate(5);
+    bf.read(f);
+}
+
+} // namespace hila
+
+#endif
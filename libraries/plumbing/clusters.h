@@ -54,6 +54,10 @@
  *
  * Note: initalization is a relatively expensive operation
  *
+ * Clusters connected only through selected bonds are found with
+ *      cluster.find(cltype, bonds);
+ * where bit d of Field<uint8_t> bonds[X] is set if X and X+d (d = e_x ...) are connected.
+ *
  * size_t hila::clusters::number() - return the total number of clusters.
  * Example:
  *      hila::out0 << "Found " << cluster.number() << " clusters\n";
@@ -148,6 +152,16 @@ class clusters {
         classify();
     }
 
+    /// @brief find clusters connected only through active bonds
+    /// @param type field which contains the type of the site, as above
+    /// @param bonds bit d (Direction d = e_x ...) of bonds[X] is set if X and X+d are connected
+    /// @details Used in e.g. Swendsen-Wang updates, where bonds are activated randomly
+    template <typename inttype, std::enable_if_t<std::is_integral<inttype>::value, int> = 0>
+    void find(const Field<inttype> &type, const Field<uint8_t> &bonds) {
+        make_labels(type, bonds);
+        classify();
+    }
+
     /// @brief number of clusters found
 
     size_t number() const {
@@ -262,6 +276,46 @@ class clusters {
         } while (changed.value() > 0);
     }
 
+    /// @brief make the label Field of clusters connected through active bonds
+    /// @details As make_labels(type) above, but neighbouring sites are in the same cluster only
+    /// if they have the same type and bond bit d of bonds[X] (to X+d) is set.
+    /// Cluster label is the smallest encoded site of the cluster
+    template <typename inttype, std::enable_if_t<std::is_integral<inttype>::value, int> = 0>
+    void make_labels(const Field<inttype> &type, const Field<uint8_t> &bonds) {
+
+        labels[ALL] = set_cl_label(X.coordinates(), type[X]);
+
+        Reduction<int64_t> changed;
+        changed.delayed();
+        do {
+            changed = 0;
+            for (Parity par : {EVEN, ODD}) {
+#pragma hila safe_access(labels)
+                onsites(par) {
+                    auto type_0 = get_cl_label_type(labels[X]);
+                    if (type_0 != background) {
+                        for (Direction d = e_x; d < NDIRS; ++d) {
+                            // bond to X-d is stored on the neighbour
+                            bool bond;
+                            if (is_up_dir(d))
+                                bond = (bonds[X] >> d) & 1;
+                            else
+                                bond = (bonds[X + d] >> opp_dir(d)) & 1;
+
+                            auto label_1 = labels[X + d];
+                            if (bond && type_0 == get_cl_label_type(label_1) &&
+                                labels[X] > label_1) {
+                                labels[X] = label_1;
+                                changed += 1;
+                            }
+                        }
+                    }
+                }
+            }
+
+        } while (changed.value() > 0);
+    }
+
     /// @brief obtain const refence to cluster label Field var
     /// clusters::find() must have been called before this
 
@@ -144,23 +144,46 @@ bool hila::get_allreduce() {
 
 /* Machine initialization */
 #include <sys/types.h>
+#include <sys/statvfs.h>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <map>
+
+// MPI thread support level given by MPI_Init_thread
+static int mpi_thread_level = MPI_THREAD_SINGLE;
+
 void hila::initialize_communications(int &argc, char ***argv) {
     /* Init MPI */
     if (!mpi_initialized) {
 
+        // The progress thread needs MPI_THREAD_MULTIPLE.  The level has to be fixed
+        // before the command line is parsed, so look for the flag here
+        bool want_multiple = false;
+        for (int i = 1; i < argc; i++) {
+            if (strcmp((*argv)[i], "-comm-progress") == 0)
+                want_multiple = true;
+        }
+
 #ifndef OPENMP
-        MPI_Init(&argc, argv);
+        if (!want_multiple) {
+            MPI_Init(&argc, argv);
+        } else {
+            MPI_Init_thread(&argc, argv, MPI_THREAD_MULTIPLE, &mpi_thread_level);
+        }
 
 #else
 
         int provided;
-        MPI_Init_thread(&argc, argv, MPI_THREAD_FUNNELED, &provided);
+        MPI_Init_thread(&argc, argv, want_multiple ? MPI_THREAD_MULTIPLE : MPI_THREAD_FUNNELED,
+                        &provided);
         if (provided < MPI_THREAD_FUNNELED) {
             if (hila::myrank() == 0)
                 hila::out << "MPI could not provide MPI_THREAD_FUNNELED, exiting\n";
             MPI_Finalize();
             exit(1);
         }
+        mpi_thread_level = provided;
 
 #endif
 
@@ -174,6 +197,331 @@ void hila::initialize_communications(int &argc, char ***argv) {
     }
 }
 
+////////////////////////////////////////////////////////////////////////
+/// Communication progress thread.  Many MPI implementations move the data of
+/// large (rendezvous protocol) messages only when the process is inside an MPI call,
+/// so a gather started with start_gather() may not progress at all before wait_gather().
+/// The helper thread calls MPI_Iprobe() on a private communicator every interval_us
+/// microseconds while gather requests are in flight, which drives the progress engine.
+/// The thread does not touch the requests themselves: completing the same request from
+/// two threads is not allowed.
+////////////////////////////////////////////////////////////////////////
+
+std::atomic<int> hila::comm_requests_in_flight(0);
+
+static std::thread *progress_thread = nullptr;
+static std::atomic<bool> progress_stop(false);
+static MPI_Comm progress_comm = MPI_COMM_NULL;
+static std::atomic<int64_t> n_progress_polls(0);
+
+static void progress_loop(int interval_us) {
+    while (!progress_stop.load(std::memory_order_relaxed)) {
+        if (hila::comm_requests_in_flight.load(std::memory_order_relaxed) > 0) {
+            int flag;
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, progress_comm, &flag, MPI_STATUS_IGNORE);
+            n_progress_polls.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (interval_us > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+        else
+            std::this_thread::yield();
+    }
+}
+
+void hila::start_comm_progress_thread(int interval_us) {
+    if (progress_thread != nullptr || hila::check_input)
+        return;
+
+    if (mpi_thread_level < MPI_THREAD_MULTIPLE) {
+        hila::out0 << "MPI does not provide MPI_THREAD_MULTIPLE, no communication progress "
+                      "thread\n";
+        return;
+    }
+
+    MPI_Comm_dup(MPI_COMM_WORLD, &progress_comm);
+    progress_stop = false;
+    // never deleted, a joinable std::thread would abort an exit() without finishrun()
+    progress_thread = new std::thread(progress_loop, interval_us);
+
+    hila::out0 << "Communication progress thread on, polling interval " << interval_us
+               << " us\n";
+}
+
+void hila::stop_comm_progress_thread() {
+    if (progress_thread == nullptr)
+        return;
+    progress_stop = true;
+    progress_thread->join();
+    delete progress_thread;
+    progress_thread = nullptr;
+    MPI_Comm_free(&progress_comm);
+}
+
+bool hila::comm_progress_thread_on() {
+    return progress_thread != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////
+/// Shared memory halo exchange, see com_mpi.h.
+/// Segment of each rank:  [shm_slots message slots][send buffer pool]
+/// A slot is reused after shm_slots messages; its previous message must have been
+/// acknowledged by then.
+////////////////////////////////////////////////////////////////////////
+
+int hila::shm_halo_pool_mb = 0;
+
+static constexpr int shm_slots = 4096;
+static constexpr size_t shm_align = 64;
+static_assert(std::atomic<int64_t>::is_always_lock_free,
+              "shared memory halo exchange needs lock-free 64-bit atomics");
+static_assert(sizeof(hila::shm_msg_slot) == 64, "shm_msg_slot should be one cache line");
+
+static MPI_Win shm_win = MPI_WIN_NULL;
+static MPI_Comm shm_node_comm = MPI_COMM_NULL;
+static MPI_Comm shm_lattice_comm = MPI_COMM_NULL;
+static std::vector<char *> shm_base; // segment of lattice rank, nullptr if not on host
+static char *shm_pool = nullptr;
+static size_t shm_pool_size = 0;
+static std::map<size_t, size_t> shm_free_blocks, shm_used_blocks; // offset -> size
+static int64_t shm_msg_count = 0;
+static int64_t n_shm_received = 0, n_shm_ready = 0, n_shm_fallback = 0;
+static hila::timer shm_wait_timer("shm halo wait");
+
+static inline hila::shm_msg_slot *shm_slot(int rank, int64_t msg) {
+    return reinterpret_cast<hila::shm_msg_slot *>(shm_base[rank]) + (msg % shm_slots);
+}
+
+/// spin until value of a reaches v.  Yield after a while, ranks may be oversubscribed
+static void shm_spin_until(const std::atomic<int64_t> &a, int64_t v) {
+    for (int i = 0; a.load(std::memory_order_acquire) != v; i++) {
+        if (i > 1000)
+            std::this_thread::yield();
+    }
+}
+
+void hila::setup_shm_halo(MPI_Comm comm) {
+#if !defined(CUDA) && !defined(HIP)
+    if (shm_win != MPI_WIN_NULL || hila::shm_halo_pool_mb <= 0 || hila::check_input)
+        return;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, hila::myrank(), MPI_INFO_NULL,
+                        &shm_node_comm);
+    int host_ranks;
+    MPI_Comm_size(shm_node_comm, &host_ranks);
+    if (host_ranks == 1) {
+        // nobody to share with
+        MPI_Comm_free(&shm_node_comm);
+        return;
+    }
+
+    size_t slot_bytes = shm_slots * sizeof(hila::shm_msg_slot);
+    shm_pool_size = (size_t)hila::shm_halo_pool_mb << 20;
+
+    // a failed shared allocation may leave the other ranks hanging in the collective
+    // call, so check first that the host has room for the segments of all ranks
+    int ok = 1;
+    struct statvfs shm_fs;
+    if (statvfs("/dev/shm", &shm_fs) == 0 &&
+        (size_t)shm_fs.f_bavail * shm_fs.f_frsize < host_ranks * (slot_bytes + shm_pool_size))
+        ok = 0;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, shm_node_comm);
+    if (!ok) {
+        MPI_Comm_free(&shm_node_comm);
+        return;
+    }
+
+    char *base = nullptr;
+    MPI_Comm_set_errhandler(shm_node_comm, MPI_ERRORS_RETURN);
+    ok = MPI_Win_allocate_shared(slot_bytes + shm_pool_size, 1, MPI_INFO_NULL, shm_node_comm,
+                                 &base, &shm_win) == MPI_SUCCESS &&
+         base != nullptr;
+
+    // all ranks on the host have to agree, otherwise use MPI for the halos.  A window
+    // that succeeded on some ranks only cannot be freed collectively, it is left unused
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, shm_node_comm);
+    if (!ok) {
+        shm_win = MPI_WIN_NULL;
+        MPI_Comm_free(&shm_node_comm);
+        return;
+    }
+
+    auto *slots = reinterpret_cast<hila::shm_msg_slot *>(base);
+    for (int i = 0; i < shm_slots; i++) {
+        new (&slots[i].seq) std::atomic<int64_t>(-1);
+        new (&slots[i].ack) std::atomic<int64_t>(-1);
+    }
+    shm_pool = base + slot_bytes;
+    shm_free_blocks.clear();
+    shm_free_blocks[0] = shm_pool_size;
+
+    // segments of the other ranks on this host, indexed by the rank in comm
+    std::vector<int> lattice_rank(host_ranks);
+    int me = hila::myrank();
+    MPI_Allgather(&me, 1, MPI_INT, lattice_rank.data(), 1, MPI_INT, shm_node_comm);
+    shm_base.assign(hila::number_of_nodes(), nullptr);
+    for (int i = 0; i < host_ranks; i++) {
+        MPI_Aint size;
+        int disp;
+        char *p;
+        MPI_Win_shared_query(shm_win, i, &size, &disp, &p);
+        shm_base[lattice_rank[i]] = p;
+    }
+    shm_lattice_comm = comm;
+
+    // slots must be initialized before anybody posts
+    MPI_Barrier(shm_node_comm);
+
+    hila::out0 << "Shared memory halo exchange between ranks on the same host, pool "
+               << hila::shm_halo_pool_mb << " MB/rank\n";
+#endif
+}
+
+void hila::free_shm_halo() {
+    if (shm_win == MPI_WIN_NULL)
+        return;
+    MPI_Win_free(&shm_win);
+    MPI_Comm_free(&shm_node_comm);
+    shm_base.clear();
+    shm_pool = nullptr;
+    shm_lattice_comm = MPI_COMM_NULL;
+}
+
+int64_t hila::next_shm_msg() {
+    return shm_msg_count++;
+}
+
+bool hila::shm_halo_rank(int rank, MPI_Comm comm) {
+    return shm_win != MPI_WIN_NULL && comm == shm_lattice_comm && shm_base[rank] != nullptr;
+}
+
+void *hila::shm_alloc(size_t bytes) {
+    if (shm_win == MPI_WIN_NULL)
+        return nullptr;
+    bytes = (bytes + shm_align - 1) / shm_align * shm_align;
+    for (auto it = shm_free_blocks.begin(); it != shm_free_blocks.end(); ++it) {
+        if (it->second >= bytes) {
+            size_t offset = it->first;
+            size_t rest = it->second - bytes;
+            shm_free_blocks.erase(it);
+            if (rest > 0)
+                shm_free_blocks[offset + bytes] = rest;
+            shm_used_blocks[offset] = bytes;
+            return shm_pool + offset;
+        }
+    }
+    return nullptr;
+}
+
+bool hila::shm_owns(const void *p) {
+    const char *c = static_cast<const char *>(p);
+    return shm_pool != nullptr && c >= shm_pool && c < shm_pool + shm_pool_size;
+}
+
+void hila::shm_free(void *p) {
+    assert(hila::shm_owns(p));
+    size_t offset = static_cast<char *>(p) - shm_pool;
+    auto used = shm_used_blocks.find(offset);
+    assert(used != shm_used_blocks.end());
+    size_t bytes = used->second;
+    shm_used_blocks.erase(used);
+
+    // merge with the neighbouring free blocks
+    auto next = shm_free_blocks.lower_bound(offset);
+    if (next != shm_free_blocks.end() && next->first == offset + bytes) {
+        bytes += next->second;
+        next = shm_free_blocks.erase(next);
+    }
+    if (next != shm_free_blocks.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += bytes;
+            return;
+        }
+    }
+    shm_free_blocks[offset] = bytes;
+}
+
+void hila::shm_post(int64_t msg, const void *buf, size_t bytes) {
+    hila::shm_msg_slot *s = shm_slot(hila::myrank(), msg);
+    // previous message in the slot must be copied
+    shm_spin_until(s->ack, s->seq.load(std::memory_order_relaxed));
+    s->offset = static_cast<const char *>(buf) - shm_base[hila::myrank()];
+    s->bytes = bytes;
+    s->seq.store(msg, std::memory_order_release);
+}
+
+void hila::shm_post_mpi(int64_t msg, int tag) {
+    hila::shm_msg_slot *s = shm_slot(hila::myrank(), msg);
+    shm_spin_until(s->ack, s->seq.load(std::memory_order_relaxed));
+    s->offset = -1;
+    s->tag = tag;
+    s->seq.store(msg, std::memory_order_release);
+}
+
+void hila::shm_receive(int rank, int64_t msg, void *dst, size_t bytes, MPI_Comm comm) {
+    hila::shm_msg_slot *s = shm_slot(rank, msg);
+
+    shm_wait_timer.start();
+    if (s->seq.load(std::memory_order_acquire) == msg)
+        n_shm_ready++;
+    else
+        shm_spin_until(s->seq, msg);
+    shm_wait_timer.stop();
+
+    if (s->offset >= 0) {
+        assert(s->bytes == bytes && "shared memory halo message size mismatch");
+        std::memcpy(dst, shm_base[rank] + s->offset, bytes);
+    } else {
+        // sender had no room in the pool
+        MPI_Recv(dst, (int)bytes, MPI_BYTE, rank, s->tag, comm, MPI_STATUS_IGNORE);
+        n_shm_fallback++;
+    }
+    n_shm_received++;
+    s->ack.store(msg, std::memory_order_release);
+}
+
+void hila::shm_wait_ack(int64_t msg) {
+    shm_wait_timer.start();
+    shm_spin_until(shm_slot(hila::myrank(), msg)->ack, msg);
+    shm_wait_timer.stop();
+}
+
+void hila::report_comm_overlap() {
+    if (!mpi_initialized)
+        return;
+
+    // sums over ranks: receives waited, receives ready at wait, exposed wait time, polls
+    double v[4] = {(double)hila::n_receive_waited, (double)hila::n_receive_ready,
+                   wait_receive_timer.value().time,
+                   (double)n_progress_polls.load(std::memory_order_relaxed)};
+    MPI_Allreduce(MPI_IN_PLACE, v, 4, MPI_DOUBLE, MPI_SUM, lattice->mpi_comm_lat);
+
+    if (v[0] > 0) {
+        int nodes = hila::number_of_nodes();
+        hila::out0 << " COMMS overlap: " << 100.0 * v[1] / v[0]
+                   << "% of halo receives complete before wait, exposed wait " << v[2] / nodes
+                   << " s/rank";
+        if (hila::comm_progress_thread_on())
+            hila::out0 << ", progress thread " << (int64_t)(v[3] / nodes) << " polls/rank";
+        hila::out0 << '\n';
+    }
+
+    // shared memory halos: received, ready at wait, MPI fallbacks, wait time
+    double w[4] = {(double)n_shm_received, (double)n_shm_ready, (double)n_shm_fallback,
+                   shm_wait_timer.value().time};
+    MPI_Allreduce(MPI_IN_PLACE, w, 4, MPI_DOUBLE, MPI_SUM, lattice->mpi_comm_lat);
+
+    if (w[0] > 0) {
+        int nodes = hila::number_of_nodes();
+        hila::out0 << " COMMS shared memory: " << 100.0 * w[0] / (w[0] + v[0])
+                   << "% of halo messages within host, " << 100.0 * w[1] / w[0]
+                   << "% ready before wait, wait " << w[3] / nodes << " s/rank";
+        if (w[2] > 0)
+            hila::out0 << ", " << (int64_t)w[2] << " sent with MPI (pool full)";
+        hila::out0 << '\n';
+    }
+}
+
 // check if MPI is on
 bool hila::is_comm_initialized(void) {
     return mpi_initialized;
@@ -183,6 +531,7 @@ bool hila::is_comm_initialized(void) {
 void hila::abort_communications(int status) {
     if (mpi_initialized) {
         mpi_initialized = false;
+        progress_stop = true;
         MPI_Abort(lattice->mpi_comm_lat, 0);
     }
 }
@@ -193,6 +542,8 @@ void hila::finish_communications() {
     mpi_initialized = false;
     hila::about_to_finish = true;
 
+    hila::stop_comm_progress_thread();
+    hila::free_shm_halo();
     MPI_Finalize();
 }
 
@@ -282,6 +633,79 @@ int get_next_msg_tag() {
     return tag;
 }
 
+/// Move the sites of an agglomerated blocked lattice between the parent box and the
+/// node, see lattice.h.  Collective over the lattice
+
+static hila::timer block_move_timer("MPI blocked lattice move");
+
+void lattice_struct::move_blocked_bytes(void *&buf, size_t elem_size, bool to_parent) const {
+
+    block_move_timer.start();
+
+    const block_move_struct &snd = to_parent ? block_recv : block_send;
+    const block_move_struct &rcv = to_parent ? block_send : block_recv;
+    size_t out_volume = to_parent ? parent_box.volume : mynode.volume;
+
+    const char *in = static_cast<const char *>(buf);
+    char *out = (char *)d_malloc(std::max(out_volume, (size_t)1) * elem_size);
+
+    int tag = get_next_msg_tag();
+    int me = hila::myrank();
+
+    std::vector<std::vector<char>> rbuf(rcv.rank.size());
+    std::vector<MPI_Request> req;
+    req.reserve(snd.rank.size() + rcv.rank.size());
+
+    for (int i = 0; i < rcv.rank.size(); i++) {
+        if (rcv.rank[i] != me) {
+            rbuf[i].resize(rcv.offset[i].size() * elem_size);
+            req.emplace_back();
+            MPI_Irecv(rbuf[i].data(), (int)rbuf[i].size(), MPI_BYTE, rcv.rank[i], tag,
+                      mpi_comm_lat, &req.back());
+        }
+    }
+
+    std::vector<std::vector<char>> sbuf(snd.rank.size());
+    for (int i = 0; i < snd.rank.size(); i++) {
+        const std::vector<unsigned> &so = snd.offset[i];
+        if (snd.rank[i] != me) {
+            sbuf[i].resize(so.size() * elem_size);
+            for (size_t j = 0; j < so.size(); j++)
+                std::memcpy(sbuf[i].data() + j * elem_size, in + so[j] * elem_size, elem_size);
+            req.emplace_back();
+            MPI_Isend(sbuf[i].data(), (int)sbuf[i].size(), MPI_BYTE, snd.rank[i], tag,
+                      mpi_comm_lat, &req.back());
+        } else {
+            // local part, the same sites are in the receive list
+            for (int k = 0; k < rcv.rank.size(); k++) {
+                if (rcv.rank[k] == me) {
+                    const std::vector<unsigned> &ro = rcv.offset[k];
+                    for (size_t j = 0; j < so.size(); j++)
+                        std::memcpy(out + ro[j] * elem_size, in + so[j] * elem_size, elem_size);
+                }
+            }
+        }
+    }
+
+    if (req.size() > 0) {
+        std::vector<MPI_Status> stat_arr(req.size());
+        MPI_Waitall((int)req.size(), req.data(), stat_arr.data());
+    }
+
+    for (int i = 0; i < rcv.rank.size(); i++) {
+        if (rcv.rank[i] != me) {
+            const std::vector<unsigned> &ro = rcv.offset[i];
+            for (size_t j = 0; j < ro.size(); j++)
+                std::memcpy(out + ro[j] * elem_size, rbuf[i].data() + j * elem_size, elem_size);
+        }
+    }
+
+    d_free(buf);
+    buf = out;
+
+    block_move_timer.stop();
+}
+
 
 /// Split the communicator to subvolumes, using MPI_Comm_split
 /// New MPI_Comm is the global mpi_comm_lat
@@ -299,6 +723,93 @@ void hila::split_into_partitions(int this_lattice) {
     // reset also the rank and numbers -fields
     MPI_Comm_rank(lattice->mpi_comm_lat, &lattice.ptr()->mynode.rank);
     MPI_Comm_size(lattice->mpi_comm_lat, &lattice.ptr()->nodes.number);
+
+    // and the communicator between partitions, used e.g. in replica exchange
+    MPI_Comm between;
+    if (MPI_Comm_split(MPI_COMM_WORLD, lattice->mynode.rank, this_lattice, &between) !=
+        MPI_SUCCESS) {
+        hila::out0 << "MPI_Comm_split() call failed!\n";
+        hila::finishrun();
+    }
+    partitions.set_comm_between(between);
+}
+
+/// Ping-pong time (seconds per message) between ranks a and b of mpi_comm_lat
+/// Other ranks do nothing
+
+static double ping_pong_time(int a, int b, std::vector<char> &buf, int reps) {
+    int rank = hila::myrank();
+    if (rank != a && rank != b)
+        return 0;
+
+    int other = (rank == a) ? b : a;
+    double t = 0;
+    // first round is warm-up
+    for (int round = 0; round < 2; round++) {
+        double t0 = MPI_Wtime();
+        for (int i = 0; i < reps; i++) {
+            if (rank == a) {
+                MPI_Send(buf.data(), buf.size(), MPI_BYTE, other, 0, lattice->mpi_comm_lat);
+                MPI_Recv(buf.data(), buf.size(), MPI_BYTE, other, 0, lattice->mpi_comm_lat,
+                         MPI_STATUS_IGNORE);
+            } else {
+                MPI_Recv(buf.data(), buf.size(), MPI_BYTE, other, 0, lattice->mpi_comm_lat,
+                         MPI_STATUS_IGNORE);
+                MPI_Send(buf.data(), buf.size(), MPI_BYTE, other, 0, lattice->mpi_comm_lat);
+            }
+        }
+        t = (MPI_Wtime() - t0) / (2 * reps);
+    }
+    return t;
+}
+
+hila::node_topology_struct hila::measure_node_topology() {
+
+    node_topology_struct topo;
+    topo.ranks_per_host = 1;
+    topo.number_of_hosts = hila::number_of_nodes();
+    topo.contiguous = true;
+    topo.intra_host_cost = 1.0;
+
+    if (hila::check_input || hila::number_of_nodes() == 1)
+        return topo;
+
+    MPI_Comm host_comm;
+    MPI_Comm_split_type(lattice->mpi_comm_lat, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                        &host_comm);
+    int host_rank, host_size;
+    MPI_Comm_rank(host_comm, &host_rank);
+    MPI_Comm_size(host_comm, &host_size);
+
+    // lowest rank on the host
+    int leader = hila::myrank();
+    MPI_Bcast(&leader, 1, MPI_INT, 0, host_comm);
+    MPI_Comm_free(&host_comm);
+
+    int is_leader = (host_rank == 0);
+    int ok = (leader + host_rank == hila::myrank());
+    int sizes[2] = {host_size, -host_size};
+    MPI_Allreduce(MPI_IN_PLACE, &is_leader, 1, MPI_INT, MPI_SUM, lattice->mpi_comm_lat);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, lattice->mpi_comm_lat);
+    MPI_Allreduce(MPI_IN_PLACE, sizes, 2, MPI_INT, MPI_MAX, lattice->mpi_comm_lat);
+
+    topo.number_of_hosts = is_leader;
+    topo.ranks_per_host = (sizes[0] == -sizes[1]) ? sizes[0] : 0;
+    topo.contiguous = (ok == 1 && topo.ranks_per_host > 0);
+
+    if (topo.contiguous && topo.ranks_per_host > 1 && topo.number_of_hosts > 1) {
+        // rank 0 talks to rank 1 (same host) and to the first rank of the 2nd host.
+        // Message size is typical of a halo face
+        std::vector<char> buf(1 << 18);
+        double t_intra = ping_pong_time(0, 1, buf, 20);
+        double t_inter = ping_pong_time(0, topo.ranks_per_host, buf, 20);
+
+        double cost = (t_inter > 0) ? t_intra / t_inter : 1.0;
+        topo.intra_host_cost = std::min(1.0, std::max(0.01, cost));
+        MPI_Bcast(&topo.intra_host_cost, 1, MPI_DOUBLE, 0, lattice->mpi_comm_lat);
+    }
+
+    return topo;
 }
 
 void hila::synchronize_partitions() {
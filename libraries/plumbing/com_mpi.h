@@ -1,6 +1,8 @@
 #ifndef HILA_COM_MPI_H_
 #define HILA_COM_MPI_H_
 
+#include <atomic>
+
 #include "plumbing/defs.h"
 
 #include "plumbing/lattice.h"
@@ -14,6 +16,7 @@ class partitions_struct {
   private:
     unsigned _number, _mylattice;
     bool _sync;
+    MPI_Comm _comm_between = MPI_COMM_NULL;
 
   public:
     unsigned number() const {
@@ -39,6 +42,16 @@ class partitions_struct {
     void set_sync(bool s) {
         _sync = s;
     }
+
+    /// Communicator connecting ranks with the same rank number in each partition, the
+    /// rank within it is the partition number.  MPI_COMM_NULL if not partitioned
+    MPI_Comm comm_between() const {
+        return _comm_between;
+    }
+
+    void set_comm_between(MPI_Comm c) {
+        _comm_between = c;
+    }
 };
 
 extern partitions_struct partitions;
@@ -407,6 +420,71 @@ T reduce_node_product(T &var, bool allreduce = true) {
 void set_allreduce(bool on = true);
 bool get_allreduce();
 
+/// Placement of the MPI ranks of the lattice communicator on shared memory (compute) nodes,
+/// used by the layout planner in setup_layout().
+struct node_topology_struct {
+    int ranks_per_host;     // ranks sharing memory with each other; 0 if not same on all hosts
+    int number_of_hosts;    // number of shared memory nodes
+    bool contiguous;        // ranks on each host have consecutive rank numbers
+    double intra_host_cost; // time of an intra-host message relative to an inter-host one
+};
+
+/// Find the host topology with MPI_Comm_split_type() and, if both intra- and inter-host
+/// links exist, measure their relative cost with a short ping-pong benchmark.
+/// Must be called by all ranks.
+node_topology_struct measure_node_topology();
+
+/// Communication progress thread (command line -comm-progress).  With it a helper thread
+/// enters MPI while halo messages are in flight, so that they move also while the main
+/// thread computes.  Needs MPI_THREAD_MULTIPLE, which initialize_communications()
+/// requests if the flag is on the command line.
+/// comm_requests_in_flight counts the posted and not yet waited gather requests.
+extern std::atomic<int> comm_requests_in_flight;
+void start_comm_progress_thread(int interval_us);
+void stop_comm_progress_thread();
+bool comm_progress_thread_on();
+
+/// Print how many halo receives were complete when wait_gather() was entered, i.e.
+/// fully overlapped with computation, and the exposed wait time.  Called by all ranks.
+void report_comm_overlap();
+
+/// Node-local halo exchange through shared memory (command line -shm-halo <MB>).
+/// Each rank allocates a MPI_Win_allocate_shared segment with a table of message slots
+/// and a pool for the send buffers of halos going to ranks on the same host.  The sender
+/// packs the boundary into its segment and posts the slot, the receiver copies directly
+/// from there to its halo and acknowledges.  MPI is used only between hosts.
+/// Off by default.  If the shared window cannot be allocated, all halos use MPI.
+/// Messages are numbered with next_shm_msg(), which is called in every start_gather()
+/// on all ranks, so that sender and receiver agree on the number.
+struct shm_msg_slot {
+    std::atomic<int64_t> seq; // number of the posted message
+    std::atomic<int64_t> ack; // number of the message copied by the receiver
+    int64_t offset;           // data in the sender's segment, -1: sent with MPI instead
+    int64_t bytes;
+    int tag;
+    char pad[28];
+};
+
+extern int shm_halo_pool_mb;
+void setup_shm_halo(MPI_Comm comm);
+void free_shm_halo();
+int64_t next_shm_msg();
+/// true if halo messages to / from rank of comm go through shared memory
+bool shm_halo_rank(int rank, MPI_Comm comm);
+/// send buffer from the pool, nullptr if the pool is full
+void *shm_alloc(size_t bytes);
+/// true if p is from the pool
+bool shm_owns(const void *p);
+void shm_free(void *p);
+/// sender: buf (from the pool) holds message msg
+void shm_post(int64_t msg, const void *buf, size_t bytes);
+/// sender: message msg goes with MPI tag, the pool was full
+void shm_post_mpi(int64_t msg, int tag);
+/// receiver: wait for message msg from rank and copy it to dst
+void shm_receive(int rank, int64_t msg, void *dst, size_t bytes, MPI_Comm comm);
+/// sender: wait until the receiver has copied message msg
+void shm_wait_ack(int64_t msg);
+
 
 } // namespace hila
 
@@ -0,0 +1,261 @@
+#include <cstring>
+#include <algorithm>
+#include <queue>
+
+#include "defs.h"
+#include "compress.h"
+
+//////////////////////////////////////////////////////////////////
+// Byte-shuffle + canonical Huffman codec, see compress.h
+//////////////////////////////////////////////////////////////////
+
+namespace hila {
+
+static hila::timer compress_timer("compress");
+static hila::timer decompress_timer("decompress");
+
+namespace {
+
+constexpr int max_code_len = 15;
+
+enum plane_mode : uint8_t { stored = 0, constant = 1, huffman = 2 };
+
+/// Huffman code lengths of the 256 byte values from the frequencies.  Lengths above
+/// max_code_len are avoided by flattening the frequencies and trying again
+void code_lengths(const uint64_t freq_in[256], uint8_t len[256]) {
+    uint64_t freq[256];
+    std::memcpy(freq, freq_in, sizeof(freq));
+
+    while (true) {
+        // nodes 0..255 are leaves, internal nodes are appended
+        std::vector<int> parent(512, -1);
+        using item = std::pair<uint64_t, int>;
+        std::priority_queue<item, std::vector<item>, std::greater<item>> heap;
+        for (int s = 0; s < 256; s++)
+            if (freq[s] > 0)
+                heap.push({freq[s], s});
+
+        int next = 256;
+        while (heap.size() > 1) {
+            item a = heap.top();
+            heap.pop();
+            item b = heap.top();
+            heap.pop();
+            parent[a.second] = next;
+            parent[b.second] = next;
+            heap.push({a.first + b.first, next});
+            next++;
+        }
+
+        int maxlen = 0;
+        for (int s = 0; s < 256; s++) {
+            int l = 0;
+            if (freq[s] > 0)
+                for (int p = parent[s]; p >= 0; p = parent[p])
+                    l++;
+            len[s] = l;
+            maxlen = std::max(maxlen, l);
+        }
+        if (maxlen <= max_code_len)
+            return;
+
+        for (int s = 0; s < 256; s++)
+            if (freq[s] > 0)
+                freq[s] = (freq[s] + 1) / 2;
+    }
+}
+
+/// Canonical codes from the lengths.  Returns false if the lengths are not a valid
+/// prefix code
+bool canonical_codes(const uint8_t len[256], uint16_t code[256]) {
+    int count[max_code_len + 1] = {0};
+    for (int s = 0; s < 256; s++) {
+        if (len[s] > max_code_len)
+            return false;
+        count[len[s]]++;
+    }
+    count[0] = 0;
+
+    int next[max_code_len + 2];
+    int c = 0;
+    for (int l = 1; l <= max_code_len; l++) {
+        c = (c + count[l - 1]) << 1;
+        next[l] = c;
+        if (c + count[l] > (1 << l))
+            return false;
+    }
+    for (int s = 0; s < 256; s++)
+        if (len[s] > 0)
+            code[s] = next[len[s]]++;
+    return true;
+}
+
+void compress_plane(const uint8_t *in, size_t n, std::vector<uint8_t> &out) {
+    uint64_t freq[256] = {0};
+    for (size_t i = 0; i < n; i++)
+        freq[in[i]]++;
+
+    int nsym = 0;
+    for (int s = 0; s < 256; s++)
+        nsym += (freq[s] > 0);
+
+    if (nsym <= 1) {
+        out.push_back(constant);
+        out.push_back(n > 0 ? in[0] : 0);
+        return;
+    }
+
+    uint8_t len[256];
+    uint16_t code[256];
+    code_lengths(freq, len);
+    canonical_codes(len, code);
+
+    uint64_t bits = 0;
+    for (int s = 0; s < 256; s++)
+        bits += freq[s] * len[s];
+    uint64_t nbytes = (bits + 7) / 8;
+
+    if (128 + sizeof(uint64_t) + nbytes >= n) {
+        out.push_back(stored);
+        out.insert(out.end(), in, in + n);
+        return;
+    }
+
+    out.push_back(huffman);
+    for (int s = 0; s < 256; s += 2)
+        out.push_back(len[s] | (len[s + 1] << 4));
+
+    size_t pos = out.size();
+    out.resize(pos + sizeof(uint64_t) + nbytes);
+    std::memcpy(out.data() + pos, &nbytes, sizeof(uint64_t));
+    uint8_t *p = out.data() + pos + sizeof(uint64_t);
+
+    // MSB first bit stream
+    uint64_t acc = 0;
+    int nacc = 0;
+    for (size_t i = 0; i < n; i++) {
+        acc = (acc << len[in[i]]) | code[in[i]];
+        nacc += len[in[i]];
+        while (nacc >= 8) {
+            nacc -= 8;
+            *p++ = (uint8_t)(acc >> nacc);
+        }
+    }
+    if (nacc > 0)
+        *p++ = (uint8_t)(acc << (8 - nacc));
+}
+
+/// Decode one plane, returns the number of bytes of in used, 0 on error
+size_t decompress_plane(const uint8_t *in, size_t in_bytes, uint8_t *out, size_t n) {
+    if (in_bytes < 1)
+        return 0;
+
+    switch (in[0]) {
+    case stored:
+        if (in_bytes < 1 + n)
+            return 0;
+        std::memcpy(out, in + 1, n);
+        return 1 + n;
+
+    case constant:
+        if (in_bytes < 2)
+            return 0;
+        std::memset(out, in[1], n);
+        return 2;
+
+    case huffman: {
+        size_t head = 1 + 128 + sizeof(uint64_t);
+        if (in_bytes < head)
+            return 0;
+        uint8_t len[256];
+        for (int s = 0; s < 256; s += 2) {
+            len[s] = in[1 + s / 2] & 0xf;
+            len[s + 1] = in[1 + s / 2] >> 4;
+        }
+        uint64_t nbytes;
+        std::memcpy(&nbytes, in + 1 + 128, sizeof(uint64_t));
+        if (in_bytes - head < nbytes)
+            return 0;
+
+        uint16_t code[256];
+        if (!canonical_codes(len, code))
+            return 0;
+
+        // lookup table indexed by the next max_code_len bits: symbol and length
+        std::vector<uint16_t> table(1 << max_code_len, 0);
+        for (int s = 0; s < 256; s++) {
+            if (len[s] > 0) {
+                int shift = max_code_len - len[s];
+                for (int j = code[s] << shift; j < (code[s] + 1) << shift; j++)
+                    table[j] = (len[s] << 8) | s;
+            }
+        }
+
+        const uint8_t *p = in + head;
+        const uint8_t *end = p + nbytes;
+        uint64_t acc = 0;
+        int nacc = 0;
+        for (size_t i = 0; i < n; i++) {
+            while (nacc <= 56) {
+                acc = (acc << 8) | (p < end ? *p : 0);
+                p++;
+                nacc += 8;
+            }
+            uint16_t t = table[(acc >> (nacc - max_code_len)) & ((1 << max_code_len) - 1)];
+            int l = t >> 8;
+            if (l == 0)
+                return 0;
+            out[i] = t & 0xff;
+            nacc -= l;
+        }
+        // bits consumed must fit in the stream
+        if ((size_t)(p - (in + head)) * 8 - nacc > nbytes * 8)
+            return 0;
+        return head + nbytes;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+void shuffle_compress(const void *data, size_t n_values, int width, std::vector<uint8_t> &out) {
+    compress_timer.start();
+
+    const uint8_t *d = static_cast<const uint8_t *>(data);
+    std::vector<uint8_t> plane(n_values);
+    for (int b = 0; b < width; b++) {
+        for (size_t i = 0; i < n_values; i++)
+            plane[i] = d[i * width + b];
+        compress_plane(plane.data(), n_values, out);
+    }
+
+    compress_timer.stop();
+}
+
+bool shuffle_decompress(const uint8_t *in, size_t in_bytes, void *data, size_t n_values,
+                        int width) {
+    decompress_timer.start();
+
+    uint8_t *d = static_cast<uint8_t *>(data);
+    std::vector<uint8_t> plane(n_values);
+    bool ok = true;
+    for (int b = 0; b < width && ok; b++) {
+        size_t used = decompress_plane(in, in_bytes, plane.data(), n_values);
+        if (used == 0) {
+            ok = false;
+        } else {
+            in += used;
+            in_bytes -= used;
+            for (size_t i = 0; i < n_values; i++)
+                d[i * width + b] = plane[i];
+        }
+    }
+
+    decompress_timer.stop();
+    return ok;
+}
+
+} // namespace hila
@@ -0,0 +1,40 @@
+#ifndef HILA_COMPRESS_H_
+#define HILA_COMPRESS_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace hila {
+
+////////////////////////////////////////////////////////////////
+///
+/// Lossless byte-shuffle + Huffman codec, used for compressed field files
+/// (see field_compress.h).
+///
+/// The input is n_values values of width bytes each.  The bytes are first shuffled so
+/// that byte b of all values forms "plane" b.  In floating point data the sign and
+/// exponent planes have low entropy and the low mantissa planes high, so each plane is
+/// coded separately: as a constant, with a canonical Huffman code, or stored as is,
+/// whichever is smallest.
+///
+/// Compressed stream, for each plane:
+///    uint8  mode      0: stored, 1: constant, 2: Huffman
+///    stored:   n_values bytes
+///    constant: 1 byte
+///    Huffman:  128 bytes of 4-bit code lengths for symbols 0..255,
+///              uint64 number of bytes of the bit stream, and the bit stream (MSB first)
+///
+////////////////////////////////////////////////////////////////
+
+/// Compress, appending the result to out
+void shuffle_compress(const void *data, size_t n_values, int width, std::vector<uint8_t> &out);
+
+/// Decompress n_values values of width bytes from in to data.
+/// Returns false if the stream is corrupt
+bool shuffle_decompress(const uint8_t *in, size_t in_bytes, void *data, size_t n_values,
+                        int width);
+
+} // namespace hila
+
+#endif
@@ -56,11 +56,21 @@ size_t pencil_get_buffer_offsets(const Direction dir, const size_t elements,
 void init_pencil_direction(Direction dir) {
 
     if (lattice->fftdata == nullptr) {
-        lattice.ptr()->fftdata = new hila::fftdata_struct;
+        // value-initialized: column counts and buffer sizes are 0
+        lattice.ptr()->fftdata = new hila::fftdata_struct();
     }
     
     hila::fftdata_struct &fft = *(lattice.ptr()->fftdata);
 
+    // ranks without sites (agglomerated blocked lattice) take no part in the fft:
+    // no pencil comms, no columns and no receive buffer
+    if (lattice->mynode.volume == 0) {
+        fft.hila_pencil_comms[dir].clear();
+        fft.hila_fft_my_columns[dir] = 0;
+        fft.pencil_recv_buf_size[dir] = 0;
+        return;
+    }
+
     if (fft.hila_pencil_comms[dir].size() == 0) {
         // basic structs not yet set, do it here
 
@@ -70,6 +80,8 @@ void init_pencil_direction(Direction dir) {
         for (int nodenumber = 0; nodenumber < lattice->nodes.number; ++nodenumber) {
 
             const node_info n = lattice->nodes.nodeinfo(nodenumber);
+            if (n.evensites + n.oddsites == 0)
+                continue;
 
             bool is_in_column = true;
             foralldir (d)
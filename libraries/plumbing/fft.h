@@ -15,6 +15,10 @@
 
 #include "plumbing/fft_structs.h"
 
+// defined in reductionvector.h, not included here because it includes hila.h
+template <typename T>
+class ReductionVector;
+
 #ifdef USE_FFTW
 #include <fftw3.h>
 #endif
@@ -244,6 +248,41 @@ class hila_fft {
         pencil_save_timer.stop();
     }
 
+    /// Fused output stage for power spectra: instead of writing the result to a field,
+    /// add the square norm of the transformed value at site X to s[bin_index[X]].
+    /// Sites with bin_index[X] < 0 are skipped.  Saves the result field and the
+    /// memory sweep over it.
+
+    template <typename R>
+    void bin_squarenorm(const Field<int> &bin_index, ReductionVector<R> &s) {
+
+        extern hila::timer pencil_save_timer;
+        pencil_save_timer.start();
+
+        int elem = elements;
+
+        CoordinateVector offset, nmin;
+
+        const size_t elem_offset = pencil_get_buffer_offsets(dir, elements, offset, nmin);
+
+        cmplx_t *rb = receive_buf;
+
+        #pragma hila novector direct_access(rb)
+        onsites (ALL) {
+            int b = bin_index[X];
+            if (b >= 0) {
+                size_t off = offset.dot(X.coordinates() - nmin);
+                double ps = 0;
+                for (int i = 0; i < elem; i++) {
+                    ps += rb[off + i * elem_offset].squarenorm();
+                }
+                s[b] += ps;
+            }
+        }
+
+        pencil_save_timer.stop();
+    }
+
     /////////////////////////////////////////////////////////////////////////////
     ///  Reshuffle data, given that previous fft dir was to prev_dir and now to dir
     ///  Assuming here that the data is in receive_buf after fft and copy to send_buf
@@ -290,14 +329,11 @@ class hila_fft {
     void gather_data();
 
     ////////////////////////////////////////////////////////////////////////
-    /// Do the transform itself (fft or reflect only)
+    /// Do the transform itself (fft or reflect only).  The result is left in the
+    /// pencil buffers, to be written out with save_result() or bin_squarenorm()
 
     template <typename T>
-    void full_transform(const Field<T> &input, Field<T> &result,
-                        const CoordinateVector &directions) {
-
-        // Make sure the result is allocated and mark it changed
-        result.check_alloc();
+    void transform_to_buffer(const Field<T> &input, const CoordinateVector &directions) {
 
         bool first_dir = true;
         Direction prev_dir;
@@ -334,6 +370,16 @@ class hila_fft {
                 swap_buffers();
             }
         }
+    }
+
+    template <typename T>
+    void full_transform(const Field<T> &input, Field<T> &result,
+                        const CoordinateVector &directions) {
+
+        // Make sure the result is allocated and mark it changed
+        result.check_alloc();
+
+        transform_to_buffer(input, directions);
 
         save_result(result);
 
@@ -420,7 +466,6 @@ inline void FFT_field(const Field<T> &input, Field<T> &result,
     FFT_field(input, result, dirs, fftdir);
 }
 
-
 /**
  * @brief Field method for performing FFT
  * @details
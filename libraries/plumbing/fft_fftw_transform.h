@@ -165,7 +165,8 @@ void hila_fft<cmplx_t>::gather_data() {
     const hila::fftdata_struct &fft = *(lattice->fftdata);
 
     // post receive and send
-    int n_comms = fft.hila_pencil_comms[dir].size() - 1;
+    // ranks without sites have no pencil comms
+    int n_comms = std::max((int)fft.hila_pencil_comms[dir].size() - 1, 0);
 
     std::vector<MPI_Request> sendreq(n_comms), recreq(n_comms);
     std::vector<MPI_Status> stat(n_comms);
@@ -222,7 +223,8 @@ void hila_fft<cmplx_t>::scatter_data() {
 
     const hila::fftdata_struct &fft = *(lattice->fftdata);
 
-    int n_comms = fft.hila_pencil_comms[dir].size() - 1;
+    // ranks without sites have no pencil comms
+    int n_comms = std::max((int)fft.hila_pencil_comms[dir].size() - 1, 0);
 
     std::vector<MPI_Request> sendreq(n_comms), recreq(n_comms);
     std::vector<MPI_Status> stat(n_comms);
@@ -91,6 +91,8 @@ class Field {
 
         MPI_Request receive_request[3][NDIRS];
         MPI_Request send_request[3][NDIRS];
+        // message numbers of shared memory halo exchange, see com_mpi.h
+        int64_t shm_msg[3][NDIRS];
 #ifndef VANILLA
         // vanilla needs no special receive buffers
         T *receive_buffer[NDIRS];
@@ -118,8 +120,12 @@ class Field {
          */
         void free_communication() {
             for (int d = 0; d < NDIRS; d++) {
-                if (send_buffer[d] != nullptr)
-                    payload.free_mpi_buffer(send_buffer[d]);
+                if (send_buffer[d] != nullptr) {
+                    if (hila::shm_owns(send_buffer[d]))
+                        hila::shm_free(send_buffer[d]);
+                    else
+                        payload.free_mpi_buffer(send_buffer[d]);
+                }
 #ifndef VANILLA
                 if (receive_buffer[d] != nullptr)
                     payload.free_mpi_buffer(receive_buffer[d]);
@@ -223,6 +229,19 @@ class Field {
         void scatter_elements(T *buffer, const std::vector<CoordinateVector> &coord_list,
                               int root = 0);
 
+        /**
+         * @internal
+         * @brief Gather/scatter sites first ... first+n-1 of box cmin..cmax (x fastest)
+         * @details Structured version of the above: nodes find their own sites from the
+         * node geometry, and data is moved with MPI_Gatherv / MPI_Scatterv
+         */
+        void gather_box_elements(T *buffer, const CoordinateVector &cmin,
+                                 const CoordinateVector &cmax, size_t first, size_t n,
+                                 int root = 0) const;
+        void scatter_box_elements(T *buffer, const CoordinateVector &cmin,
+                                  const CoordinateVector &cmax, size_t first, size_t n,
+                                  int root = 0);
+
 
         /// get the receive buffer pointer for the communication.
         T *get_receive_buffer(Direction d, Parity par,
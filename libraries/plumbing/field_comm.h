@@ -266,6 +266,7 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
     // sync
 
     int tag = get_next_msg_tag();
+    int64_t shm_msg = hila::next_shm_msg();
 
     const lattice_struct::nn_comminfo_struct &ci = lattice->nn_comminfo[d];
     const lattice_struct::comm_node_struct &from_node = ci.from_node;
@@ -311,6 +312,9 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
 
     mark_gather_started(d, par);
 
+    static int trace_id = hila::trace_register("start_gather");
+    hila::trace_scope trace_gather(trace_id);
+
     // Communication hasn't been started yet, do it now
 
     int par_i = static_cast<int>(par) - 1; // index to dim-3 arrays
@@ -334,13 +338,19 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
             hila::terminate(1);
         }
 
-        post_receive_timer.start();
+        if (hila::shm_halo_rank(from_node.rank, lattice->mpi_comm_lat)) {
+            // same host, copied from the sender's shared memory in wait_gather
+            fs->shm_msg[par_i][d] = shm_msg;
+        } else {
+            post_receive_timer.start();
 
-        // c++ version does not return errors
-        MPI_Irecv(receive_buffer, (int)n, MPI_BYTE, from_node.rank, tag, lattice->mpi_comm_lat,
-                  &fs->receive_request[par_i][d]);
+            // c++ version does not return errors
+            MPI_Irecv(receive_buffer, (int)n, MPI_BYTE, from_node.rank, tag,
+                      lattice->mpi_comm_lat, &fs->receive_request[par_i][d]);
+            hila::comm_requests_in_flight++;
 
-        post_receive_timer.stop();
+            post_receive_timer.stop();
+        }
     }
 
     if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d)) {
@@ -348,8 +358,14 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
 
         unsigned sites = to_node.n_sites(par);
 
-        if (fs->send_buffer[d] == nullptr)
-            fs->send_buffer[d] = fs->payload.allocate_mpi_buffer(to_node.sites);
+        bool shm_send = hila::shm_halo_rank(to_node.rank, lattice->mpi_comm_lat);
+
+        if (fs->send_buffer[d] == nullptr) {
+            if (shm_send)
+                fs->send_buffer[d] = (T *)hila::shm_alloc(to_node.sites * sizeof(T));
+            if (fs->send_buffer[d] == nullptr)
+                fs->send_buffer[d] = fs->payload.allocate_mpi_buffer(to_node.sites);
+        }
 
         send_buffer = fs->send_buffer[d] + to_node.offset(par);
 
@@ -364,12 +380,23 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
         // gpuDeviceSynchronize();
 #endif
 
-        start_send_timer.start();
+        if (shm_send && hila::shm_owns(send_buffer)) {
+            // receiver copies it from here
+            fs->shm_msg[par_i][d] = shm_msg;
+            hila::shm_post(shm_msg, send_buffer, n);
+        } else {
+            // shared memory pool full, tell the receiver to use MPI
+            if (shm_send)
+                hila::shm_post_mpi(shm_msg, tag);
+
+            start_send_timer.start();
 
-        MPI_Isend(send_buffer, (int)n, MPI_BYTE, to_node.rank, tag, lattice->mpi_comm_lat,
-                  &fs->send_request[par_i][d]);
+            MPI_Isend(send_buffer, (int)n, MPI_BYTE, to_node.rank, tag, lattice->mpi_comm_lat,
+                      &fs->send_request[par_i][d]);
+            hila::comm_requests_in_flight++;
 
-        start_send_timer.stop();
+            start_send_timer.stop();
+        }
     }
 
     // and do the boundary shuffle here, after MPI has started
@@ -444,15 +471,36 @@ void Field<T>::wait_gather(Direction d, Parity p) const {
         }
     }
 
+    static int trace_id = hila::trace_register("wait_gather");
+    hila::trace_scope trace_gather(trace_id);
+
     for (int wait_i = 0; wait_i < n_wait; ++wait_i) {
 
         int par_i = (int)par - 1;
 
-        if (from_node.rank != hila::myrank() && boundary_need_to_communicate(d)) {
+        if (from_node.rank != hila::myrank() && boundary_need_to_communicate(d) &&
+            hila::shm_halo_rank(from_node.rank, lattice->mpi_comm_lat)) {
+
+            hila::shm_receive(from_node.rank, fs->shm_msg[par_i][d],
+                              fs->get_receive_buffer(d, par, from_node),
+                              from_node.n_sites(par) * sizeof(T), lattice->mpi_comm_lat);
+
+#if !defined(VANILLA) && !defined(MPI_BENCHMARK_TEST)
+            fs->place_comm_elements(d, par, fs->get_receive_buffer(d, par, from_node), from_node);
+#endif
+        } else if (from_node.rank != hila::myrank() && boundary_need_to_communicate(d)) {
             wait_receive_timer.start();
 
+            // test first, to see if the message arrived during computation
             MPI_Status status;
-            MPI_Wait(&fs->receive_request[par_i][d], &status);
+            int ready;
+            MPI_Test(&fs->receive_request[par_i][d], &ready, &status);
+            if (ready)
+                hila::n_receive_ready++;
+            else
+                MPI_Wait(&fs->receive_request[par_i][d], &status);
+            hila::n_receive_waited++;
+            hila::comm_requests_in_flight--;
 
             wait_receive_timer.stop();
 
@@ -462,10 +510,15 @@ void Field<T>::wait_gather(Direction d, Parity p) const {
         }
 
         // then wait for the sends
-        if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d)) {
+        if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d) &&
+            hila::shm_owns(fs->send_buffer[d])) {
+            // the buffer is reused in the next gather, receiver must have copied it
+            hila::shm_wait_ack(fs->shm_msg[par_i][d]);
+        } else if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d)) {
             wait_send_timer.start();
             MPI_Status status;
             MPI_Wait(&fs->send_request[par_i][d], &status);
+            hila::comm_requests_in_flight--;
             wait_send_timer.stop();
         }
 
@@ -635,6 +688,103 @@ void Field<T>::field_struct::scatter_elements(T *RESTRICT buffer,
     // MPI_Barrier(lattice.mpi_comm_lat);
 }
 
+/// Gather the range first ... first+n-1 of box cmin..cmax to buffer on root.
+/// Each node finds its own sites in the range, and root finds the positions of the
+/// sites of all nodes, from the node geometry
+
+template <typename T>
+void Field<T>::field_struct::gather_box_elements(T *RESTRICT buffer, const CoordinateVector &cmin,
+                                                 const CoordinateVector &cmax, size_t first,
+                                                 size_t n, int root) const {
+
+    std::vector<size_t> pos;
+    std::vector<unsigned> index_list;
+    lattice->box_sites_on_node(lattice->nodes.nodeinfo(hila::myrank()), cmin, cmax, first, n,
+                               pos, &index_list);
+
+    std::vector<T> send_buffer(index_list.size());
+    payload.gather_elements((T *)send_buffer.data(), index_list.data(), send_buffer.size(),
+                            lattice);
+
+    MPI_Datatype dtype;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &dtype);
+    MPI_Type_commit(&dtype);
+
+    if (hila::myrank() == root) {
+        int nn = lattice->nodes.number;
+        std::vector<int> counts(nn), displs(nn);
+        std::vector<size_t> allpos;
+        allpos.reserve(n);
+        for (int r = 0; r < nn; r++) {
+            displs[r] = allpos.size();
+            lattice->box_sites_on_node(lattice->nodes.nodeinfo(r), cmin, cmax, first, n, allpos);
+            counts[r] = allpos.size() - displs[r];
+        }
+
+        std::vector<T> recv_buffer(allpos.size());
+        MPI_Gatherv((char *)send_buffer.data(), send_buffer.size(), dtype,
+                    (char *)recv_buffer.data(), counts.data(), displs.data(), dtype, root,
+                    lattice->mpi_comm_lat);
+
+        for (size_t i = 0; i < allpos.size(); i++)
+            buffer[allpos[i]] = recv_buffer[i];
+
+    } else {
+        MPI_Gatherv((char *)send_buffer.data(), send_buffer.size(), dtype, nullptr, nullptr,
+                    nullptr, dtype, root, lattice->mpi_comm_lat);
+    }
+
+    MPI_Type_free(&dtype);
+}
+
+/// Scatter buffer on root to the range first ... first+n-1 of box cmin..cmax
+
+template <typename T>
+void Field<T>::field_struct::scatter_box_elements(T *RESTRICT buffer, const CoordinateVector &cmin,
+                                                  const CoordinateVector &cmax, size_t first,
+                                                  size_t n, int root) {
+
+    std::vector<size_t> pos;
+    std::vector<unsigned> index_list;
+    lattice->box_sites_on_node(lattice->nodes.nodeinfo(hila::myrank()), cmin, cmax, first, n,
+                               pos, &index_list);
+
+    std::vector<T> recv_buffer(index_list.size());
+
+    MPI_Datatype dtype;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &dtype);
+    MPI_Type_commit(&dtype);
+
+    if (hila::myrank() == root) {
+        int nn = lattice->nodes.number;
+        std::vector<int> counts(nn), displs(nn);
+        std::vector<size_t> allpos;
+        allpos.reserve(n);
+        for (int r = 0; r < nn; r++) {
+            displs[r] = allpos.size();
+            lattice->box_sites_on_node(lattice->nodes.nodeinfo(r), cmin, cmax, first, n, allpos);
+            counts[r] = allpos.size() - displs[r];
+        }
+
+        std::vector<T> send_buffer(allpos.size());
+        for (size_t i = 0; i < allpos.size(); i++)
+            send_buffer[i] = buffer[allpos[i]];
+
+        MPI_Scatterv((char *)send_buffer.data(), counts.data(), displs.data(), dtype,
+                     (char *)recv_buffer.data(), recv_buffer.size(), dtype, root,
+                     lattice->mpi_comm_lat);
+    } else {
+        MPI_Scatterv(nullptr, nullptr, nullptr, dtype, (char *)recv_buffer.data(),
+                     recv_buffer.size(), dtype, root, lattice->mpi_comm_lat);
+    }
+
+    MPI_Type_free(&dtype);
+
+    payload.place_elements((T *)recv_buffer.data(), index_list.data(), index_list.size(),
+                           lattice);
+}
+
+
 template <typename T>
 void Field<T>::set_elements(const std::vector<T> &elements,
                             const std::vector<CoordinateVector> &coord_list) {
@@ -680,14 +830,16 @@ std::vector<T> Field<T>::get_subvolume(const CoordinateVector &cmin, const Coord
         vol *= cmax[d] - cmin[d] + 1;
         assert(cmax[d] >= cmin[d] && cmin[d] >= 0 && cmax[d] < lattice.size(d));
     }
-    std::vector<CoordinateVector> clist(vol);
-    CoordinateVector c;
 
-    size_t i = 0;
-    forcoordinaterange(c, cmin, cmax) {
-        clist[i++] = c;
-    }
-    return get_elements(clist, bcast);
+    std::vector<T> res;
+    if (hila::myrank() == 0)
+        res.resize(vol);
+
+    fs->gather_box_elements(res.data(), cmin, cmax, 0, vol);
+    if (bcast)
+        hila::broadcast(res);
+
+    return res;
 }
 
 
@@ -934,21 +1086,21 @@ void Field<T>::block_from(Field<T> &orig) {
 
     assert(blocklat->parent == parentlat && "blocking must happen from parent lattice Field");
 
-    // If no sites on this node there's nothing to do
-    if (blocklat->mynode.volume == 0)
+    // If no sites on this node there's nothing to do, unless sites are moved between nodes
+    if (blocklat->mynode.volume == 0 && !blocklat->agglomerated)
         return;
 
 
-    // alloc temp array, size of the blocked lattice
-    size_t bufsize = blocklat->mynode.volume;
+    // alloc temp array, size of the blocked sites of the parent node
+    size_t bufsize = blocklat->parent_box.volume;
     T *buf = (T *)d_malloc(bufsize * sizeof(T));
 
     // switch to parent if needed
     lattice.switch_to(parentlat);
 
     CoordinateVector blockfactor = parentlat->l_size.element_div(blocklat->l_size);
-    CoordinateVector cvmin = blocklat->mynode.min;
-    auto size_factor = blocklat->mynode.size_factor;
+    CoordinateVector cvmin = blocklat->parent_box.min;
+    auto size_factor = blocklat->parent_box.size_factor;
 
 #pragma hila direct_access(buf)
     onsites(ALL) {
@@ -961,6 +1113,11 @@ void Field<T>::block_from(Field<T> &orig) {
 
     lattice.switch_to(blocklat);
 
+    // with agglomerated blocked lattice move to the nodes of blocklat
+    blocklat->move_blocked_sites(buf, false);
+    cvmin = blocklat->mynode.min;
+    size_factor = blocklat->mynode.size_factor;
+
 #pragma hila direct_access(buf)
     onsites(ALL) {
         // get blocked coords logically on this node
@@ -987,8 +1144,8 @@ void Field<T>::unblock_to(Field<T> &target) const {
 
     assert(blocklat->parent == parentlat && "unblocking must happen to parent lattice Field");
 
-    // If no sites on this node there's nothing to do
-    if (blocklat->mynode.volume == 0)
+    // If no sites on this node there's nothing to do, unless sites are moved between nodes
+    if (blocklat->mynode.volume == 0 && !blocklat->agglomerated)
         return;
 
     // alloc temp array, size of the blocked lattice
@@ -1008,6 +1165,11 @@ void Field<T>::unblock_to(Field<T> &target) const {
         buf[cv.dot(size_factor)] = (*this)[X];
     }
 
+    // with agglomerated blocked lattice move back to the parent nodes
+    blocklat->move_blocked_sites(buf, true);
+    cvmin = blocklat->parent_box.min;
+    size_factor = blocklat->parent_box.size_factor;
+
     lattice.switch_to(parentlat);
 
 #pragma hila direct_access(buf)
@@ -1039,20 +1201,20 @@ void Field<T>::block_to_current_lattice() {
     assert(currentlat->parent == thislat &&
            "blocking must happen to the next lattice blocked from thislat");
 
-    // If no sites on this node there's nothing to do
-    if (currentlat->mynode.volume == 0)
+    // If no sites on this node there's nothing to do, unless sites are moved between nodes
+    if (currentlat->mynode.volume == 0 && !currentlat->agglomerated)
         return;
 
-    // alloc temp array, size of the blocked lattice
-    size_t bufsize = currentlat->mynode.volume;
+    // alloc temp array, size of the blocked sites of the parent node
+    size_t bufsize = currentlat->parent_box.volume;
     T *buf = (T *)d_malloc(bufsize * sizeof(T));
 
     // switch to this fields lattice
     lattice.switch_to(thislat);
 
     CoordinateVector blockfactor = thislat->l_size.element_div(currentlat->l_size);
-    CoordinateVector cvmin = currentlat->mynode.min;
-    auto size_factor = currentlat->mynode.size_factor;
+    CoordinateVector cvmin = currentlat->parent_box.min;
+    auto size_factor = currentlat->parent_box.size_factor;
 
 #pragma hila direct_access(buf)
     onsites(ALL) {
@@ -1065,6 +1227,10 @@ void Field<T>::block_to_current_lattice() {
 
     lattice.switch_to(currentlat);
     (*this).clear();
+
+    currentlat->move_blocked_sites(buf, false);
+    cvmin = currentlat->mynode.min;
+    size_factor = currentlat->mynode.size_factor;
     
 #pragma hila direct_access(buf)
     onsites(ALL) {
@@ -0,0 +1,550 @@
+#ifndef HILA_FIELD_COMPRESS_H_
+#define HILA_FIELD_COMPRESS_H_
+
+//////////////////////////////////////////////////////////////////////
+/// Compressed Field files
+///
+/// File layout (all integers int64):
+///    compressed_flag, version, NDIM, sizeof(T), lattice size[NDIM],
+///    n_fields, real size, reals stored per site, link_params, codec,
+///    lossy_error (double), sites_per_chunk, n_chunks (per field),
+///    chunk byte sizes [n_fields * n_chunks],
+///    chunk data
+///
+/// Chunk c of a field holds sites c*sites_per_chunk ... in lattice (x fastest) order.
+/// Each site is stored as "reals": the numbers of the element, or for SU(N) links the
+/// reduced parametrisation (SU(3): 12 = two rows, 8 = Clark's 8 parameters in a row and
+/// column order chosen for each link so that the reconstruction is well conditioned;
+/// SU(2): 4 = first row).  With lossy_error > 0 the reals are quantised to
+/// integers  q = round(x / (2 lossy_error)), so that the absolute error is at most
+/// lossy_error.  This is meant for measurement fields, not for configurations.
+/// With codec 1 the reals of a chunk go through shuffle_compress() (compress.h).
+///
+/// Chunks are distributed round robin to the MPI ranks, which compress / decompress
+/// them in parallel; rank 0 only does the file access.
+///
+/// Usage:
+///     hila::compress_options opt;
+///     opt.lossy_error = 1e-6;
+///     hila::write_compressed("phi.dat", phi, opt);
+///     hila::read_compressed("phi.dat", phi);
+///
+///     U.config_write("config.dat", hila::compress_options{12});
+///     U.config_read("config.dat");    // recognises the compressed format
+//////////////////////////////////////////////////////////////////////
+
+#include "plumbing/field.h"
+#include "plumbing/field_io.h"
+#include "plumbing/compress.h"
+#include "datatypes/sun_matrix.h"
+
+namespace hila {
+
+struct compress_options {
+    /// reduced storage of SU(N) links: 0 = all elements, SU(3): 12 or 8, SU(2): 4
+    int link_params = 0;
+    /// if > 0, quantise with this absolute error bound
+    double lossy_error = 0;
+    /// byte-shuffle + Huffman coding of the stored reals
+    bool entropy_coding = true;
+};
+
+// fingerprint of compressed files, next to GaugeField config_flag = 394824242
+constexpr int64_t compressed_flag = 394824243;
+constexpr int64_t compressed_version = 1;
+
+struct compressed_header {
+    int64_t flag, version, ndim, element_size;
+    int64_t size[NDIM];
+    int64_t n_fields, real_size, n_reals, link_params, codec;
+    double lossy_error;
+    int64_t sites_per_chunk, n_chunks;
+};
+
+namespace compress_detail {
+
+template <typename T>
+struct su_rank {
+    static constexpr int value = 0;
+};
+template <int N, typename R>
+struct su_rank<SU<N, R>> {
+    static constexpr int value = N;
+};
+
+template <typename T>
+bool valid_link_params(int p) {
+    constexpr int n = su_rank<T>::value;
+    return p == 0 || (n == 3 && (p == 12 || p == 8)) || (n == 2 && p == 4);
+}
+
+/// Orientation of the 8 parameter form of SU(3) matrix u: k is the column of the largest
+/// element of row 0, and s = 1 if rows 1 and 2 are swapped.  Returns true if row 0 has
+/// only one non-zero element (e.g. unit or diagonal links)
+template <typename T>
+bool orient_su3(const T &u, int &k, int &s) {
+    using R = hila::arithmetic_type<T>;
+    // below this |a1|^2 + |a2|^2 could lose precision, the elements are negligible
+    const R tiny = sqrt(std::numeric_limits<R>::min());
+
+    k = 0;
+    for (int j = 1; j < 3; j++)
+        if (u.e(0, j).squarenorm() > u.e(0, k).squarenorm())
+            k = j;
+    int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+    bool single = (u.e(0, k1).squarenorm() + u.e(0, k2).squarenorm() < tiny);
+    if (single)
+        s = (u.e(1, k2).squarenorm() < u.e(1, k1).squarenorm());
+    else
+        s = (u.e(2, k).squarenorm() < u.e(1, k).squarenorm());
+    return single;
+}
+
+/// element to p[0 .. n_reals-1]
+template <typename T, typename R = hila::arithmetic_type<T>>
+void to_reals(const T &u, int params, R *p) {
+    if constexpr (su_rank<T>::value == 3) {
+        if (params == 12) {
+            for (int i = 0; i < 2; i++)
+                for (int j = 0; j < 3; j++) {
+                    *p++ = u.e(i, j).re;
+                    *p++ = u.e(i, j).im;
+                }
+            return;
+        } else if (params == 8) {
+            // Clark's parametrisation of the rows a, b, c: a1, a2, b0 and the phases
+            // of a0 and c0.  The columns are rotated and rows b, c swapped (determinant
+            // kept 1) so that a0 is the largest element of row a and |c0| >= |b0|; then
+            // |a0|, |c0| and the rest follow from unitarity without cancellations.
+            // If a1 = a2 = 0 the lower 2x2 block is stored as b1 and the phase of b2,
+            // with |b2| >= |b1|.  The orientation is stored in the phases p[0], p[1]
+            // as multiples of 4 pi
+            int k, s;
+            bool single = orient_su3(u, k, s);
+            auto v = [&](int i, int j) {
+                int row = (i == 0) ? 0 : (i == 1) ? 1 + s : 2 - s;
+                return (s == 1 && i == 2) ? -u.e(row, (j + k) % 3) : u.e(row, (j + k) % 3);
+            };
+            p[0] = v(0, 0).arg() + 4 * M_PI * (k - 1);
+            for (int i = 4; i < 8; i++)
+                p[i] = 0;
+            if (single) {
+                p[1] = v(1, 2).arg() + 4 * M_PI * (s + 1);
+                p[2] = v(1, 1).re;
+                p[3] = v(1, 1).im;
+            } else {
+                p[1] = v(2, 0).arg() + 4 * M_PI * (s - 1);
+                p[2] = v(0, 1).re;
+                p[3] = v(0, 1).im;
+                p[4] = v(0, 2).re;
+                p[5] = v(0, 2).im;
+                p[6] = v(1, 0).re;
+                p[7] = v(1, 0).im;
+            }
+            return;
+        }
+    } else if constexpr (su_rank<T>::value == 2) {
+        if (params == 4) {
+            p[0] = u.e(0, 0).re;
+            p[1] = u.e(0, 0).im;
+            p[2] = u.e(0, 1).re;
+            p[3] = u.e(0, 1).im;
+            return;
+        }
+    }
+    for (int i = 0; i < sizeof(T) / sizeof(R); i++)
+        p[i] = hila::get_number_in_var(u, i);
+}
+
+/// inverse of to_reals.  Reduced links are reconstructed from unitarity
+template <typename T, typename R = hila::arithmetic_type<T>>
+void from_reals(const R *p, int params, T &u) {
+    if constexpr (su_rank<T>::value == 3) {
+        if (params == 12 || params == 8) {
+            Complex<R> a[3], b[3], c[3];
+            for (int j = 0; j < 3; j++)
+                a[j] = b[j] = 0;
+            int k = 0, s = 0;
+            if (params == 12) {
+                for (int j = 0; j < 3; j++) {
+                    a[j] = Complex<R>(p[2 * j], p[2 * j + 1]);
+                    b[j] = Complex<R>(p[6 + 2 * j], p[7 + 2 * j]);
+                }
+            } else {
+                // columns and rows have unit norm, third row is conj(a x b).
+                // The orientation from to_reals() keeps |a0|^2 >= 1/3, |c0|^2 >= n/2
+                int c0 = std::min(std::max((int)std::lround(p[0] / (4 * M_PI)), -1), 1);
+                int c1 = std::min(std::max((int)std::lround(p[1] / (4 * M_PI)), -1), 2);
+                k = c0 + 1;
+                s = (c1 + 1) % 2;
+                R phase0 = p[0] - 4 * M_PI * c0;
+                R phase1 = p[1] - 4 * M_PI * c1;
+                if (c1 <= 0) {
+                    a[1] = Complex<R>(p[2], p[3]);
+                    a[2] = Complex<R>(p[4], p[5]);
+                    b[0] = Complex<R>(p[6], p[7]);
+                    R n = a[1].squarenorm() + a[2].squarenorm();
+                    a[0] = polar<R>(sqrt(std::max<R>(0, 1 - n)), phase0);
+                    c[0] = polar<R>(sqrt(std::max<R>(0, n - b[0].squarenorm())), phase1);
+                    if (n > 0) {
+                        b[1] = -(c[0].conj() * a[2].conj() + a[1] * b[0] * a[0].conj()) / n;
+                        b[2] = (a[1].conj() * c[0].conj() - a[2] * b[0] * a[0].conj()) / n;
+                    }
+                } else {
+                    // a = (a0, 0, 0)
+                    a[0] = polar<R>(1, phase0);
+                    b[1] = Complex<R>(p[2], p[3]);
+                    b[2] = polar<R>(sqrt(std::max<R>(0, 1 - b[1].squarenorm())), phase1);
+                }
+            }
+            c[0] = (a[1] * b[2] - a[2] * b[1]).conj();
+            c[1] = (a[2] * b[0] - a[0] * b[2]).conj();
+            c[2] = (a[0] * b[1] - a[1] * b[0]).conj();
+            for (int j = 0; j < 3; j++) {
+                u.e(0, (j + k) % 3) = a[j];
+                u.e(1 + s, (j + k) % 3) = b[j];
+                u.e(2 - s, (j + k) % 3) = (s == 1) ? -c[j] : c[j];
+            }
+            return;
+        }
+    } else if constexpr (su_rank<T>::value == 2) {
+        if (params == 4) {
+            Complex<R> a(p[0], p[1]), b(p[2], p[3]);
+            u.e(0, 0) = a;
+            u.e(0, 1) = b;
+            u.e(1, 0) = -b.conj();
+            u.e(1, 1) = a.conj();
+            return;
+        }
+    }
+    for (int i = 0; i < sizeof(T) / sizeof(R); i++)
+        hila::set_number_in_var(u, i, p[i]);
+}
+
+/// Compress n elements of buf, appending to out
+template <typename T, typename R = hila::arithmetic_type<T>>
+void encode_chunk(const T *buf, size_t n, const compressed_header &h, std::vector<uint8_t> &out) {
+    size_t nr = n * h.n_reals;
+    std::vector<R> reals(nr);
+    for (size_t i = 0; i < n; i++)
+        to_reals(buf[i], h.link_params, reals.data() + i * h.n_reals);
+
+    const void *data = reals.data();
+    int width = sizeof(R);
+    std::vector<uint64_t> q;
+    if (h.lossy_error > 0) {
+        // zigzag encoded quantised values, small magnitudes have zero high bytes
+        q.resize(nr);
+        double scale = 1.0 / (2 * h.lossy_error);
+        for (size_t i = 0; i < nr; i++) {
+            int64_t v = llround(reals[i] * scale);
+            q[i] = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+        }
+        data = q.data();
+        width = sizeof(uint64_t);
+    }
+
+    if (h.codec == 1) {
+        hila::shuffle_compress(data, nr, width, out);
+    } else {
+        const uint8_t *d = static_cast<const uint8_t *>(data);
+        out.insert(out.end(), d, d + nr * width);
+    }
+}
+
+/// Decompress n elements to buf, returns false on corrupt data
+template <typename T, typename R = hila::arithmetic_type<T>>
+bool decode_chunk(const uint8_t *in, size_t in_bytes, T *buf, size_t n,
+                  const compressed_header &h) {
+    size_t nr = n * h.n_reals;
+    std::vector<R> reals(nr);
+    std::vector<uint64_t> q;
+    void *data = reals.data();
+    int width = sizeof(R);
+    if (h.lossy_error > 0) {
+        q.resize(nr);
+        data = q.data();
+        width = sizeof(uint64_t);
+    }
+
+    if (h.codec == 1) {
+        if (!hila::shuffle_decompress(in, in_bytes, data, nr, width))
+            return false;
+    } else {
+        if (in_bytes != nr * width)
+            return false;
+        std::memcpy(data, in, in_bytes);
+    }
+
+    if (h.lossy_error > 0) {
+        for (size_t i = 0; i < nr; i++) {
+            int64_t v = (int64_t)(q[i] >> 1) ^ -(int64_t)(q[i] & 1);
+            reals[i] = v * (2 * h.lossy_error);
+        }
+    }
+
+    for (size_t i = 0; i < n; i++)
+        from_reals(reals.data() + i * h.n_reals, h.link_params, buf[i]);
+    return true;
+}
+
+} // namespace compress_detail
+
+/// Write fields of the same type and lattice to a compressed stream
+template <typename T>
+void write_compressed(std::ofstream &outputfile, const std::vector<const Field<T> *> &fields,
+                      const compress_options &opt = compress_options()) {
+    static int trace_id = hila::trace_register("Field write_compressed");
+    hila::trace_scope trace_io(trace_id);
+
+    using R = hila::arithmetic_type<T>;
+
+    if (!compress_detail::valid_link_params<T>(opt.link_params) ||
+        ((opt.link_params > 0 || opt.lossy_error > 0) && !std::is_floating_point<R>::value)) {
+        hila::out0 << "write_compressed: link_params " << opt.link_params << " / lossy_error "
+                   << opt.lossy_error << " not possible for this field type\n";
+        hila::terminate(1);
+    }
+
+    Lattice lat = fields[0]->fs->mylattice;
+    compressed_header h;
+    h.flag = compressed_flag;
+    h.version = compressed_version;
+    h.ndim = NDIM;
+    h.element_size = sizeof(T);
+    foralldir(d) h.size[d] = lat.size(d);
+    h.n_fields = fields.size();
+    h.real_size = sizeof(R);
+    h.n_reals = (opt.link_params > 0) ? opt.link_params : sizeof(T) / sizeof(R);
+    h.link_params = opt.link_params;
+    h.codec = opt.entropy_coding ? 1 : 0;
+    h.lossy_error = opt.lossy_error;
+    h.sites_per_chunk = WRITE_BUFFER_SIZE / sizeof(T);
+    h.n_chunks = (lat.volume() + h.sites_per_chunk - 1) / h.sites_per_chunk;
+
+    std::vector<int64_t> chunk_bytes(h.n_fields * h.n_chunks, 0);
+    std::streampos table_pos;
+    if (hila::myrank() == 0) {
+        outputfile.write(reinterpret_cast<char *>(&h), sizeof(h));
+        table_pos = outputfile.tellp();
+        outputfile.write(reinterpret_cast<char *>(chunk_bytes.data()),
+                         chunk_bytes.size() * sizeof(int64_t));
+    }
+
+    int nn = hila::number_of_nodes();
+    int myrank = hila::myrank();
+    CoordinateVector cmin(0), cmax;
+    foralldir(d) cmax[d] = lat.size(d) - 1;
+
+    std::vector<T> chunk(h.sites_per_chunk);
+    std::vector<uint8_t> bytes, allbytes;
+    std::vector<int> counts(nn), displs(nn);
+
+    for (int fi = 0; fi < h.n_fields; fi++) {
+        for (int64_t c0 = 0; c0 < h.n_chunks; c0 += nn) {
+
+            // chunk c0 + q is gathered to rank q
+            for (int q = 0; q < nn && c0 + q < h.n_chunks; q++) {
+                size_t first = (c0 + q) * h.sites_per_chunk;
+                size_t n = std::min<size_t>(h.sites_per_chunk, lat.volume() - first);
+                fields[fi]->fs->gather_box_elements(chunk.data(), cmin, cmax, first, n, q);
+            }
+
+            bytes.clear();
+            if (c0 + myrank < h.n_chunks) {
+                size_t first = (c0 + myrank) * h.sites_per_chunk;
+                size_t n = std::min<size_t>(h.sites_per_chunk, lat.volume() - first);
+                compress_detail::encode_chunk(chunk.data(), n, h, bytes);
+            }
+
+            int nbytes = bytes.size();
+            MPI_Gather(&nbytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, lat.ptr()->mpi_comm_lat);
+            if (myrank == 0) {
+                size_t total = 0;
+                for (int q = 0; q < nn; q++) {
+                    displs[q] = total;
+                    total += counts[q];
+                }
+                allbytes.resize(total);
+            }
+            MPI_Gatherv(bytes.data(), nbytes, MPI_BYTE, allbytes.data(), counts.data(),
+                        displs.data(), MPI_BYTE, 0, lat.ptr()->mpi_comm_lat);
+
+            if (myrank == 0) {
+                outputfile.write(reinterpret_cast<char *>(allbytes.data()), allbytes.size());
+                for (int q = 0; q < nn && c0 + q < h.n_chunks; q++)
+                    chunk_bytes[fi * h.n_chunks + c0 + q] = counts[q];
+            }
+        }
+    }
+
+    if (myrank == 0) {
+        outputfile.seekp(table_pos);
+        outputfile.write(reinterpret_cast<char *>(chunk_bytes.data()),
+                         chunk_bytes.size() * sizeof(int64_t));
+        outputfile.seekp(0, std::ios::end);
+    }
+}
+
+/// Read fields written by write_compressed.  The stored lattice may be smaller than the
+/// current one, if it divides it; then the stored lattice is replicated as in
+/// Field::read(std::ifstream &, const CoordinateVector &)
+template <typename T>
+void read_compressed(std::ifstream &inputfile, const std::vector<Field<T> *> &fields,
+                     const std::string &filename = "") {
+    static int trace_id = hila::trace_register("Field read_compressed");
+    hila::trace_scope trace_io(trace_id);
+
+    Lattice lat = (fields[0]->fs == nullptr) ? lattice : fields[0]->fs->mylattice;
+    std::string conferr("COMPRESSED FILE ERROR in " + filename + ": ");
+
+    compressed_header h;
+    bool ok = true;
+    if (hila::myrank() == 0) {
+        // fixed part first, the rest depends on NDIM
+        inputfile.read(reinterpret_cast<char *>(&h), 4 * sizeof(int64_t));
+        if (inputfile.fail() || h.flag != compressed_flag) {
+            hila::out0 << conferr << "not a compressed field file\n";
+            ok = false;
+        } else if (h.version != compressed_version) {
+            hila::out0 << conferr << "unknown version " << h.version << '\n';
+            ok = false;
+        } else if (h.ndim != NDIM) {
+            hila::out0 << conferr << "wrong dimensionality, should be " << NDIM << " is "
+                       << h.ndim << '\n';
+            ok = false;
+        } else if (h.element_size != sizeof(T)) {
+            hila::out0 << conferr << "wrong size of field element, should be " << sizeof(T)
+                       << " is " << h.element_size << '\n';
+            ok = false;
+        }
+        if (ok) {
+            inputfile.read(reinterpret_cast<char *>(&h) + 4 * sizeof(int64_t),
+                           sizeof(h) - 4 * sizeof(int64_t));
+            foralldir(d) {
+                if (h.size[d] <= 0 || lat.size(d) % h.size[d] != 0) {
+                    hila::out0 << conferr << "incorrect lattice dimension "
+                               << hila::prettyprint(d) << " is " << h.size[d]
+                               << " should be (or divide) " << lat.size(d) << '\n';
+                    ok = false;
+                }
+            }
+            if (h.n_fields != (int64_t)fields.size()) {
+                hila::out0 << conferr << "file has " << h.n_fields << " fields, expected "
+                           << fields.size() << '\n';
+                ok = false;
+            }
+            if (h.real_size != sizeof(hila::arithmetic_type<T>) ||
+                !compress_detail::valid_link_params<T>(h.link_params)) {
+                hila::out0 << conferr << "stored element format does not match field type\n";
+                ok = false;
+            }
+        }
+    }
+    if (!hila::broadcast(ok))
+        hila::terminate(1);
+    hila::broadcast(h);
+
+    std::vector<int64_t> chunk_bytes(h.n_fields * h.n_chunks);
+    if (hila::myrank() == 0)
+        inputfile.read(reinterpret_cast<char *>(chunk_bytes.data()),
+                       chunk_bytes.size() * sizeof(int64_t));
+    hila::broadcast(chunk_bytes);
+
+    // replication of the stored lattice, see Field::read
+    CoordinateVector insize;
+    int scalef[NDIM];
+    size_t tvol = 1, scvol = 1;
+    foralldir(d) {
+        insize[d] = h.size[d];
+        scalef[d] = lat.size(d) / insize[d];
+        tvol *= insize[d];
+        scvol *= scalef[d];
+    }
+
+    int nn = hila::number_of_nodes();
+    int myrank = hila::myrank();
+    std::vector<T> chunk(h.sites_per_chunk);
+    std::vector<uint8_t> bytes, allbytes;
+    std::vector<int> counts(nn), displs(nn);
+
+    for (int fi = 0; fi < h.n_fields; fi++) {
+        Field<T> &f = *fields[fi];
+        if (!f.is_allocated())
+            f.allocate();
+        f.mark_changed(ALL);
+
+        for (int64_t c0 = 0; c0 < h.n_chunks; c0 += nn) {
+
+            size_t total = 0;
+            for (int q = 0; q < nn; q++) {
+                counts[q] = (c0 + q < h.n_chunks) ? chunk_bytes[fi * h.n_chunks + c0 + q] : 0;
+                displs[q] = total;
+                total += counts[q];
+            }
+            if (myrank == 0) {
+                allbytes.resize(total);
+                inputfile.read(reinterpret_cast<char *>(allbytes.data()), total);
+            }
+            bytes.resize(counts[myrank]);
+            MPI_Scatterv(allbytes.data(), counts.data(), displs.data(), MPI_BYTE, bytes.data(),
+                         counts[myrank], MPI_BYTE, 0, lat.ptr()->mpi_comm_lat);
+
+            if (c0 + myrank < h.n_chunks) {
+                size_t first = (c0 + myrank) * h.sites_per_chunk;
+                size_t n = std::min<size_t>(h.sites_per_chunk, tvol - first);
+                ok = ok && compress_detail::decode_chunk(bytes.data(), bytes.size(),
+                                                         chunk.data(), n, h);
+            }
+
+            // chunk c0 + q is scattered from rank q to all copies of the stored lattice
+            for (int q = 0; q < nn && c0 + q < h.n_chunks; q++) {
+                size_t first = (c0 + q) * h.sites_per_chunk;
+                size_t n = std::min<size_t>(h.sites_per_chunk, tvol - first);
+                for (size_t sci = 0; sci < scvol; ++sci) {
+                    CoordinateVector cmin, cmax;
+                    size_t ind = sci;
+                    foralldir(dir) {
+                        int tsf = ind % scalef[dir];
+                        ind /= scalef[dir];
+                        cmin[dir] = tsf * insize[dir];
+                        cmax[dir] = cmin[dir] + insize[dir] - 1;
+                    }
+                    f.fs->scatter_box_elements(chunk.data(), cmin, cmax, first, n, q);
+                }
+            }
+        }
+    }
+
+    int myok = ok, allok;
+    MPI_Allreduce(&myok, &allok, 1, MPI_INT, MPI_MIN, lat.ptr()->mpi_comm_lat);
+    if (!allok) {
+        hila::out0 << conferr << "corrupt compressed data\n";
+        hila::terminate(1);
+    }
+}
+
+/// Write a Field to a compressed file
+template <typename T>
+void write_compressed(const std::string &filename, const Field<T> &f,
+                      const compress_options &opt = compress_options()) {
+    std::ofstream outputfile;
+    hila::open_output_file(filename, outputfile);
+    std::vector<const Field<T> *> fl = {&f};
+    write_compressed(outputfile, fl, opt);
+    hila::close_file(filename, outputfile);
+}
+
+/// Read a Field from a compressed file
+template <typename T>
+void read_compressed(const std::string &filename, Field<T> &f) {
+    std::ifstream inputfile;
+    hila::open_input_file(filename, inputfile);
+    std::vector<Field<T> *> fl = {&f};
+    read_compressed(inputfile, fl, filename);
+    hila::close_file(filename, inputfile);
+}
+
+} // namespace hila
+
+#endif
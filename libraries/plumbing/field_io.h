@@ -77,26 +77,26 @@ bool close_file(const std::string &filename, S &fstream) {
 /// Write the field to a file stream
 template <typename T>
 void Field<T>::write(std::ofstream &outputfile, bool binary, int precision) const {
+    static int trace_id = hila::trace_register("Field write");
+    hila::trace_scope trace_io(trace_id);
+
     constexpr size_t sites_per_write = WRITE_BUFFER_SIZE / sizeof(T);
     constexpr size_t write_size = sites_per_write * sizeof(T);
 
     if (!binary)
         outputfile.precision(precision);
 
-    std::vector<CoordinateVector> coord_list(sites_per_write);
     T *buffer = (T *)memalloc(write_size);
     auto mylat = fs->mylattice;
     CoordinateVector size = mylat.size();
+    CoordinateVector cmin(0), cmax;
+    foralldir(d) cmax[d] = size[d] - 1;
 
     for (size_t i = 0; i < mylat.volume(); i += sites_per_write) {
         size_t sites = std::min(sites_per_write, mylat.volume() - i);
-        for (size_t j = 0; j < sites; j++)
-            coord_list[j] = mylat->global_coordinates(i + j);
-
-        if (sites < sites_per_write)
-            coord_list.resize(sites);
 
-        fs->gather_elements(buffer, coord_list);
+        // chunk i ... i+sites-1 of the full lattice, in x-fastest order
+        fs->gather_box_elements(buffer, cmin, cmax, i, sites);
         if (hila::myrank() == 0) {
             if (binary) {
                 outputfile.write((char *)buffer, sites * sizeof(T));
@@ -146,6 +146,9 @@ static void write_fields(const std::string &filename, fieldtypes &...fields) {
 /// Read the Field from a stream
 template <typename T>
 void Field<T>::read(std::ifstream &inputfile) {
+    static int trace_id = hila::trace_register("Field read");
+    hila::trace_scope trace_io(trace_id);
+
     constexpr size_t sites_per_read = WRITE_BUFFER_SIZE / sizeof(T);
     constexpr size_t read_size = sites_per_read * sizeof(T);
 
@@ -154,23 +157,19 @@ void Field<T>::read(std::ifstream &inputfile) {
 
     mark_changed(ALL);
 
-    std::vector<CoordinateVector> coord_list(sites_per_read);
     T *buffer = (T *)memalloc(read_size);
     auto mylat = fs->mylattice;
     CoordinateVector size = mylat.size();
+    CoordinateVector cmin(0), cmax;
+    foralldir(d) cmax[d] = size[d] - 1;
 
     for (size_t i = 0; i < mylat.volume(); i += sites_per_read) {
         size_t sites = std::min(sites_per_read, mylat.volume() - i);
-        for (size_t j = 0; j < sites; j++)
-            coord_list[j] = mylat->global_coordinates(i + j);
-
-        if (sites < sites_per_read)
-            coord_list.resize(sites);
 
         if (hila::myrank() == 0)
             inputfile.read((char *)buffer, sites * sizeof(T));
 
-        fs->scatter_elements(buffer, coord_list);
+        fs->scatter_box_elements(buffer, cmin, cmax, i, sites);
     }
 
     std::free(buffer);
@@ -179,6 +178,9 @@ void Field<T>::read(std::ifstream &inputfile) {
 /// Read the Field from a stream
 template <typename T>
 void Field<T>::read(std::ifstream &inputfile, const CoordinateVector& insize) {
+    static int trace_id = hila::trace_register("Field read");
+    hila::trace_scope trace_io(trace_id);
+
     constexpr size_t sites_per_read = WRITE_BUFFER_SIZE / sizeof(T);
     constexpr size_t read_size = sites_per_read * sizeof(T);
 
@@ -187,7 +189,6 @@ void Field<T>::read(std::ifstream &inputfile, const CoordinateVector& insize) {
 
     mark_changed(ALL);
 
-    std::vector<CoordinateVector> coord_list(sites_per_read);
     T *buffer = (T *)memalloc(read_size);
 
     CoordinateVector lsize = lattice.size();
@@ -205,34 +206,20 @@ void Field<T>::read(std::ifstream &inputfile, const CoordinateVector& insize) {
         if (hila::myrank() == 0) {
             inputfile.read((char *)buffer, sites * sizeof(T));
         }
-        
-        for (size_t j = 0; j < sites; j++) {
-            size_t ind = i + j;
-            foralldir(dir) {
-                coord_list[j][dir] = ind % insize[dir];
-                ind /= insize[dir];
-            }
-        }
-
-        if (sites < sites_per_read) {
-            coord_list.resize(sites);
-        }
-
-        fs->scatter_elements(buffer, coord_list);
 
         // if input lattice fits multiple times on the current lattice size,
-        // replicate input lattice to fill current lattice:
-        for (size_t sci = 1; sci < scvol; ++sci) {
-            std::vector<CoordinateVector> tcoord_list(coord_list.size());
+        // replicate input lattice to fill current lattice.  Copy sci is the box
+        // starting at tsf * insize, which fits inside the lattice
+        for (size_t sci = 0; sci < scvol; ++sci) {
+            CoordinateVector cmin, cmax;
             size_t ind = sci;
             foralldir(dir) {
                 int tsf = ind % scalef[dir];
                 ind /= scalef[dir];
-                for (size_t j = 0; j < sites; j++) {
-                    tcoord_list[j][dir] = (coord_list[j][dir] + tsf * insize[dir]) % lsize[dir];
-                }
+                cmin[dir] = tsf * insize[dir];
+                cmax[dir] = cmin[dir] + insize[dir] - 1;
             }
-            fs->scatter_elements(buffer, tcoord_list);
+            fs->scatter_box_elements(buffer, cmin, cmax, i, sites);
         }
     }
 
@@ -279,6 +266,9 @@ static void read_fields(const std::string &filename, fieldtypes &...fields) {
 template <typename T>
 void Field<T>::write_subvolume(std::ofstream &outputfile, const CoordinateVector &cmin,
                                const CoordinateVector &cmax, int precision) const {
+    static int trace_id = hila::trace_register("Field write_subvolume");
+    hila::trace_scope trace_io(trace_id);
+
 
     constexpr size_t sites_per_write = WRITE_BUFFER_SIZE / sizeof(T);
 
@@ -295,38 +285,28 @@ void Field<T>::write_subvolume(std::ofstream &outputfile, const CoordinateVector
 
     size_t n_write = std::min(sites_per_write, sites);
 
-    std::vector<CoordinateVector> coord_list(n_write);
     T *buffer = (T *)memalloc(n_write * sizeof(T));
 
-    CoordinateVector c;
-
-    size_t i = 0, j = 0;
-
     if (hila::myrank() == 0) {
         outputfile.precision(precision);
     }
 
-    forcoordinaterange(c, cmin, cmax) {
-        coord_list[i] = c;
-        i++;
-        j++;
-        if (i == n_write || j == sites) {
-            if (i < n_write)
-                coord_list.resize(i);
-
-            fs->gather_elements(buffer, coord_list);
-
-            if (hila::myrank() == 0) {
-                for (size_t k = 0; k < i; k++) {
-                    for (int l = 0; l < sizeof(T) / sizeof(hila::arithmetic_type<T>); l++) {
-                        outputfile << hila::get_number_in_var(buffer[k], l) << ' ';
-                    }
-                    outputfile << '\n';
+    for (size_t i = 0; i < sites; i += n_write) {
+        size_t n = std::min(n_write, sites - i);
+
+        fs->gather_box_elements(buffer, cmin, cmax, i, n);
+
+        if (hila::myrank() == 0) {
+            for (size_t k = 0; k < n; k++) {
+                for (int l = 0; l < sizeof(T) / sizeof(hila::arithmetic_type<T>); l++) {
+                    outputfile << hila::get_number_in_var(buffer[k], l) << ' ';
                 }
+                outputfile << '\n';
             }
-            i = 0;
         }
     }
+
+    std::free(buffer);
 }
 
 
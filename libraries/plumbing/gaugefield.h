@@ -216,6 +216,22 @@ class GaugeField {
         hila::close_file(filename, outputfile);
     }
 
+    /// config_write in the compressed format of field_compress.h, e.g. links in
+    /// reduced 12 parameter form:  U.config_write(filename, hila::compress_options{12});
+    /// config_read recognises the format from the header
+
+    void config_write(const std::string &filename, const hila::compress_options &opt) const {
+        std::ofstream outputfile;
+        hila::open_output_file(filename, outputfile);
+
+        std::vector<const Field<T> *> fields;
+        foralldir (d)
+            fields.push_back(&fdir[d]);
+        hila::write_compressed(outputfile, fields, opt);
+
+        hila::close_file(filename, outputfile);
+    }
+
     void config_read(const std::string &filename) {
         std::ifstream inputfile;
         hila::open_input_file(filename, inputfile);
@@ -224,8 +240,22 @@ class GaugeField {
         // read header
         bool ok = true;
         int64_t f;
-        if (hila::myrank() == 0) {
+        if (hila::myrank() == 0)
             inputfile.read(reinterpret_cast<char *>(&f), sizeof(int64_t));
+
+        // compressed file, header is read again by read_compressed
+        if (hila::broadcast(hila::myrank() == 0 && f == hila::compressed_flag)) {
+            if (hila::myrank() == 0)
+                inputfile.seekg(0);
+            std::vector<Field<T> *> fields;
+            foralldir (d)
+                fields.push_back(&fdir[d]);
+            hila::read_compressed(inputfile, fields, filename);
+            hila::close_file(filename, inputfile);
+            return;
+        }
+
+        if (hila::myrank() == 0) {
             ok = (f == config_flag);
             if (!ok)
                 hila::out0 << conferr << "wrong id, should be " << config_flag << " is " << f
@@ -286,13 +316,7 @@ class GaugeField {
 
         assert(blocklat->parent == parentlat && "blocking must happen from parent lattice Field");
 
-        // alloc temp array, size of the blocked lattice
-        size_t bufsize = blocklat->mynode.volume;
-        T *buf = (T *)d_malloc(bufsize * sizeof(T));
-
         CoordinateVector blockfactor = parentlat->l_size.element_div(blocklat->l_size);
-        CoordinateVector cvmin = blocklat->mynode.min;
-        auto size_factor = blocklat->mynode.size_factor;
 
         foralldir (d) {
             assert(blockfactor[d] <= 2 &&
@@ -300,6 +324,11 @@ class GaugeField {
         }
 
         foralldir (d) {
+            // alloc temp array, size of the blocked sites of the parent node
+            T *buf = (T *)d_malloc(blocklat->parent_box.volume * sizeof(T));
+            CoordinateVector cvmin = blocklat->parent_box.min;
+            auto size_factor = blocklat->parent_box.size_factor;
+
             // switch to parent
             lattice.switch_to(parentlat);
 
@@ -329,17 +358,22 @@ class GaugeField {
 
             lattice.switch_to(blocklat);
 
+            // with agglomerated blocked lattice move to the nodes of blocklat
+            blocklat->move_blocked_sites(buf, false);
+            cvmin = blocklat->mynode.min;
+            size_factor = blocklat->mynode.size_factor;
+
             #pragma hila direct_access(buf)
             onsites (ALL) {
                 // get blocked coords logically on this node
                 Vector<NDIM, unsigned> cv = X.coordinates() - cvmin;
                 (*this)[d][X] = buf[cv.dot(size_factor)];
             }
+
+            d_free(buf);
         } // directions
 
         lattice.switch_to(currentlat);
-
-        d_free(buf);
     }
 
     /**
@@ -365,13 +399,7 @@ class GaugeField {
         // blocked field straight to the new field. This requires some hilapp magic to get the
         // indices right on each different platform. WIP.
 
-        // alloc temp array, size of the blocked lattice
-        size_t bufsize = currentlat->mynode.volume;
-        T *buf = (T *)d_malloc(bufsize * sizeof(T));
-
         CoordinateVector blockfactor = thislat->l_size.element_div(currentlat->l_size);
-        CoordinateVector cvmin = currentlat->mynode.min;
-        auto size_factor = currentlat->mynode.size_factor;
 
         foralldir (d) {
             assert(blockfactor[d] <= 2 &&
@@ -379,6 +407,11 @@ class GaugeField {
         }
 
         foralldir (d) {
+            // alloc temp array, size of the blocked sites of the parent node
+            T *buf = (T *)d_malloc(currentlat->parent_box.volume * sizeof(T));
+            CoordinateVector cvmin = currentlat->parent_box.min;
+            auto size_factor = currentlat->parent_box.size_factor;
+
             // switch to this fields lattice
             lattice.switch_to(thislat);
 
@@ -409,15 +442,19 @@ class GaugeField {
             lattice.switch_to(currentlat);
             (*this)[d].clear();
 
+            currentlat->move_blocked_sites(buf, false);
+            cvmin = currentlat->mynode.min;
+            size_factor = currentlat->mynode.size_factor;
+
             #pragma hila direct_access(buf)
             onsites (ALL) {
                 // get blocked coords logically on this node
                 Vector<NDIM, unsigned> cv = X.coordinates() - cvmin;
                 (*this)[d][X] = buf[cv.dot(size_factor)];
             }
-        } // directions
 
-        d_free(buf);
+            d_free(buf);
+        } // directions
     }
 
     /////////////////////////////////////////////////////////////////////////////////////////
@@ -21,6 +21,8 @@
 #include "plumbing/site_index.h"
 #include "plumbing/field.h"
 #include "plumbing/field_io.h"
+#include "plumbing/field_compress.h"
+#include "plumbing/block_file.h"
 #include "plumbing/reduction.h"
 #include "plumbing/reductionvector.h"
 #include "plumbing/site_select.h"
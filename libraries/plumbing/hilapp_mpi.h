@@ -41,12 +41,25 @@ typedef void *MPI_Comm;
 typedef int MPI_Fint;
 typedef int MPI_Aint;
 typedef void *MPI_Errhandler;
+typedef void *MPI_Info;
+typedef void *MPI_File;
+typedef void *MPI_Win;
+typedef long long MPI_Offset;
 #define MPI_IN_PLACE nullptr
 #define MPI_COMM_WORLD nullptr
 #define MPI_STATUS_IGNORE nullptr
 #define MPI_ERRORS_RETURN nullptr
 #define MPI_REQUEST_NULL nullptr
 #define MPI_SUCCESS 1
+#define MPI_COMM_NULL nullptr
+#define MPI_WIN_NULL nullptr
+#define MPI_INFO_NULL nullptr
+#define MPI_ANY_SOURCE (-1)
+#define MPI_ANY_TAG (-1)
+#define MPI_COMM_TYPE_SHARED 1
+#define MPI_MODE_RDONLY 2
+#define MPI_MODE_WRONLY 4
+#define MPI_MODE_CREATE 1
 
 enum MPI_thread_level : int {
     MPI_THREAD_SINGLE,
@@ -79,6 +92,13 @@ int MPI_Comm_size(MPI_Comm comm, int *size);
 
 int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm);
 
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info,
+                        MPI_Comm *newcomm);
+
+int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm);
+
+int MPI_Comm_free(MPI_Comm *comm);
+
 int MPI_Comm_set_errhandler(MPI_Comm comm, MPI_Errhandler errhandler);
 
 int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm);
@@ -95,6 +115,20 @@ int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype da
 int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
                    MPI_Op op, MPI_Comm comm, MPI_Request *request);
 
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+               int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm);
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                const int recvcounts[], const int displs[], MPI_Datatype recvtype, int root,
+                MPI_Comm comm);
+
+int MPI_Scatterv(const void *sendbuf, const int sendcounts[], const int displs[],
+                 MPI_Datatype sendtype, void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                 int root, MPI_Comm comm);
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                  int recvcount, MPI_Datatype recvtype, MPI_Comm comm);
+
 int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
              MPI_Comm comm);
 
@@ -120,6 +154,8 @@ int MPI_Cancel(MPI_Request *request);
 
 int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status);
 
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status);
+
 int MPI_Test_cancelled(const MPI_Status *status, int *flag);
 
 int MPI_Request_free(MPI_Request *request);
@@ -130,6 +166,8 @@ MPI_Fint MPI_Comm_c2f(MPI_Comm comm);
 
 int MPI_Finalize();
 
+double MPI_Wtime();
+
 int MPI_Get_address(const void *location, MPI_Aint *address);
 
 int MPI_Type_create_struct(int count,
@@ -140,9 +178,32 @@ int MPI_Type_create_struct(int count,
 
 int MPI_Type_commit(MPI_Datatype *datatype);
 
+int MPI_Type_contiguous(int count, MPI_Datatype oldtype, MPI_Datatype *newtype);
+
+int MPI_Type_free(MPI_Datatype *datatype);
+
 typedef void MPI_User_function(void *invec, void *inoutvec, int *len, MPI_Datatype *datatype);
 
 int MPI_Op_create(MPI_User_function *user_fn, int commute, MPI_Op *op);
 
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm,
+                            void *baseptr, MPI_Win *win);
+
+int MPI_Win_shared_query(MPI_Win win, int rank, MPI_Aint *size, int *disp_unit, void *baseptr);
+
+int MPI_Win_free(MPI_Win *win);
+
+int MPI_File_open(MPI_Comm comm, const char *filename, int amode, MPI_Info info, MPI_File *fh);
+
+int MPI_File_close(MPI_File *fh);
+
+int MPI_File_set_size(MPI_File fh, MPI_Offset size);
+
+int MPI_File_write_at(MPI_File fh, MPI_Offset offset, const void *buf, int count,
+                      MPI_Datatype datatype, MPI_Status *status);
+
+int MPI_File_read_at(MPI_File fh, MPI_Offset offset, void *buf, int count,
+                     MPI_Datatype datatype, MPI_Status *status);
+
 
 #endif
\ No newline at end of file
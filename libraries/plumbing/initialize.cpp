@@ -127,6 +127,44 @@ void hila::initialize(int argc, char **argv) {
                            "as '-partitions <num> <dirname>' to use '<dirname>N'.\n",
                            "<num>");
 
+    hila::cmdline.add_flag("-timer-imbalance",
+                           "flag timers whose max over ranks exceeds the mean by this fraction\n"
+                           "in the timer report (default 0.1)",
+                           "<fraction>", 1);
+    hila::cmdline.add_flag("-timer-csv", "write per-rank timer values to csv file at exit",
+                           "<filename>", 1);
+
+    hila::cmdline.add_flag("-trace",
+                           "record timers, gathers, I/O and (with LOOP_PROFILE) site loops into\n"
+                           "a Chrome trace JSON file written at exit.\n"
+                           "Optional 2nd arg: max number of events per rank (default 1048576)",
+                           "<filename> [<max events>]");
+
+    hila::cmdline.add_flag("-comm-progress",
+                           "run a helper thread which keeps halo communications progressing\n"
+                           "during computation (needs MPI_THREAD_MULTIPLE).\n"
+                           "Optional arg: polling interval in microseconds (default 10)",
+                           "[<interval>]");
+
+    hila::cmdline.add_flag("-shm-halo",
+                           "size in MB of the shared memory pool for halo exchange between\n"
+                           "ranks on the same host (default 0: use MPI for all halos)",
+                           "<MB>", 1);
+
+    hila::cmdline.add_flag("-block-min-volume",
+                           "agglomerate blocked lattices: merge nodes until the node volume is\n"
+                           "at least <sites>, leaving the other ranks idle (default 0: no merging)",
+                           "<sites>", 1);
+    hila::cmdline.add_flag("-hugepages",
+                           "back field storage with 2MB huge pages: 'thp' transparent (madvise),\n"
+                           "'explicit' reserved hugetlbfs pages, falling back to thp (default off)",
+                           "<thp|explicit|off>", 1);
+    hila::cmdline.add_flag("-layout",
+                           "force the number of nodes to each direction, instead of\n"
+                           "the automatic choice by the layout planner.\n"
+                           "Optional last arg: node remap block size (NODE_LAYOUT_BLOCK)",
+                           "<n_x> <n_y> ... [<block>]");
+
     hila::cmdline.add_flag("-p",
                            "parameter overriding the input file field <key>.\n"
                            "If fields contain spaces enclose in quotes.\n"
@@ -208,6 +246,9 @@ void hila::initialize(int argc, char **argv) {
 #endif
 #ifdef SPECIAL_BOUNDARY_CONDITIONS
         hila::out0 << " SPECIAL_BOUNDARY_CONDITIONS";
+#endif
+#ifdef CACHE_BLOCKED_LAYOUT
+        hila::out0 << " CACHE_BLOCKED_LAYOUT=" << CACHE_BLOCKED_LAYOUT;
 #endif
         hila::out0 << '\n';
 
@@ -222,6 +263,62 @@ void hila::initialize(int argc, char **argv) {
         hila::out0 << "No runtime limit given\n";
     }
 
+    if (hila::cmdline.flag_present("-timer-imbalance")) {
+        hila::set_timer_imbalance_threshold(hila::cmdline.get_double("-timer-imbalance"));
+    }
+    if (hila::cmdline.flag_present("-timer-csv")) {
+        hila::set_timer_csv_file(hila::cmdline.get_string("-timer-csv"));
+    }
+
+    if (hila::cmdline.flag_present("-trace")) {
+        if (hila::cmdline.flag_set("-trace") > 1) {
+            long max_events = hila::cmdline.get_int("-trace", 1);
+            if (max_events <= 0) {
+                hila::out0 << "-trace: max number of events must be positive\n";
+                hila::finishrun();
+            }
+            hila::setup_trace(hila::cmdline.get_string("-trace"), max_events);
+        } else
+            hila::setup_trace(hila::cmdline.get_string("-trace"));
+    }
+
+    if (hila::cmdline.flag_present("-comm-progress")) {
+        int interval = 10;
+        if (hila::cmdline.flag_set("-comm-progress") > 0)
+            interval = hila::cmdline.get_int("-comm-progress");
+        hila::start_comm_progress_thread(interval);
+    }
+
+    if (hila::cmdline.flag_present("-shm-halo"))
+        hila::shm_halo_pool_mb = hila::cmdline.get_int("-shm-halo");
+
+    if (hila::cmdline.flag_present("-block-min-volume"))
+        hila::set_block_min_volume(hila::cmdline.get_int("-block-min-volume"));
+
+    if (hila::cmdline.flag_present("-hugepages")) {
+        std::string mode = hila::cmdline.get_string("-hugepages");
+        if (mode == "thp")
+            hila::set_hugepage_mode(hila::hugepage_mode::transparent);
+        else if (mode == "explicit")
+            hila::set_hugepage_mode(hila::hugepage_mode::explicit_pages);
+        else if (mode != "off") {
+            hila::out0 << "-hugepages must be thp, explicit or off\n";
+            hila::finishrun();
+        }
+    }
+
+    if (hila::cmdline.flag_present("-layout")) {
+        int nargs = hila::cmdline.flag_set("-layout");
+        if (nargs != NDIM && nargs != NDIM + 1) {
+            hila::out0 << "-layout needs " << NDIM << " node divisions and optionally block size\n";
+            hila::finishrun();
+        }
+        std::vector<int> div(NDIM);
+        for (int d = 0; d < NDIM; d++)
+            div[d] = hila::cmdline.get_int("-layout", d);
+        hila::set_node_layout(div, (nargs > NDIM) ? hila::cmdline.get_int("-layout", NDIM) : 0);
+    }
+
     if (hila::cmdline.flag_present("-i")) {
         // Quits if '-i' given without a string argument
         hila::out0 << "Input file from command line: " << hila::cmdline.get_string("-i") << "\n";
@@ -301,6 +398,8 @@ void hila::error(const std::string &msg) {
  */
 void hila::finishrun() {
     report_timers();
+    report_loop_profiles();
+    hila::write_trace();
 
 
     int64_t gathers = hila::n_gather_done;
@@ -312,6 +411,8 @@ void hila::finishrun() {
     } else {
         hila::out0 << " No communications done from node 0\n";
     }
+    hila::report_comm_overlap();
+    hila::report_memalloc_stats();
 
 
 #if defined(CUDA) || defined(HIP)
@@ -29,7 +29,29 @@ std::vector<lattice_struct *> defined_lattices;
 // global bookkeeping
 namespace hila {
 int64_t n_gather_avoided = 0, n_gather_done = 0;
+int64_t n_receive_waited = 0, n_receive_ready = 0;
+
+// node layout given by the user, used in setup_layout() if non-empty
+std::vector<int> node_layout_divisions;
+int node_layout_block = 0;
+
+void set_node_layout(const std::vector<int> &divisions, int block) {
+    node_layout_divisions = divisions;
+    node_layout_block = block;
+}
+
+// minimum node volume of blocked lattices, 0: no agglomeration
+int64_t block_min_volume = 0;
+
+void set_block_min_volume(int64_t min_volume) {
+#if defined(CUDA) || defined(HIP)
+    if (min_volume > 0)
+        hila::out0 << "NOTE: blocked lattice agglomeration is not available on GPUs, ignored\n";
+    return;
+#endif
+    block_min_volume = min_volume;
 }
+} // namespace hila
 
 /// General lattice setup
 void lattice_struct::setup_base_lattice(const CoordinateVector &siz) {
@@ -56,6 +78,9 @@ void lattice_struct::setup_base_lattice(const CoordinateVector &siz) {
     // Initialize wait_array structures - has to be after std gathers()
     initialize_wait_arrays();
 
+    // shared memory segments for halos within a host
+    hila::setup_shm_halo(mpi_comm_lat);
+
 #ifdef SPECIAL_BOUNDARY_CONDITIONS
     // do this after std. boundary is done
     init_special_boundaries();
@@ -164,7 +189,7 @@ bool lattice_struct::is_on_mynode(const CoordinateVector &loc) const {
 
 #ifndef SUBNODE_LAYOUT
 
-#ifndef BOUNDARY_LAYER_LAYOUT
+#if !defined(BOUNDARY_LAYER_LAYOUT) && !defined(CACHE_BLOCKED_LAYOUT)
 
 unsigned lattice_struct::site_index(const CoordinateVector &loc) const {
 
@@ -182,7 +207,7 @@ unsigned lattice_struct::site_index(const CoordinateVector &loc) const {
 #endif
 }
 
-#else // Now BOUNDARY_LAYER_LAYOUT
+#else // Now BOUNDARY_LAYER_LAYOUT or CACHE_BLOCKED_LAYOUT
 
 unsigned lattice_struct::site_index(const CoordinateVector &loc) const {
 
@@ -325,6 +350,14 @@ node_info lattice_struct::allnodes::nodeinfo(int nodeid) const {
     int64_t nodevol = 1;
     node_info ninfo;
 
+    if (nodeid < 0) {
+        // rank without sites, in agglomerated blocked lattice
+        ninfo.min.fill(0);
+        ninfo.size.fill(0);
+        ninfo.evensites = ninfo.oddsites = 0;
+        return ninfo;
+    }
+
     foralldir (d) {
         int nodecoord = nodeid % n_divisions[d];
         nodeid = nodeid / n_divisions[d];
@@ -384,6 +417,86 @@ void lattice_struct::setup_nodes() {
     }
 }
 
+////////////////////////////////////////////////////////////////////////
+/// Find the sites of node ni in a range of a box, see lattice.h.
+/// Work is proportional to the number of the sites found, not the size of the range,
+/// so that all nodes can do this for structured gathers/scatters (Field I/O etc.)
+////////////////////////////////////////////////////////////////////////
+
+void lattice_struct::box_sites_on_node(const node_info &ni, const CoordinateVector &cmin,
+                                       const CoordinateVector &cmax, size_t first, size_t n,
+                                       std::vector<size_t> &pos,
+                                       std::vector<unsigned> *index) const {
+    if (n == 0)
+        return;
+
+    // intersection of the box and the node
+    CoordinateVector lo, hi;
+    size_t stride[NDIM];
+    foralldir (d) {
+        lo[d] = std::max(cmin[d], ni.min[d]);
+        hi[d] = std::min(cmax[d], ni.min[d] + ni.size[d] - 1);
+        if (lo[d] > hi[d])
+            return;
+        stride[d] = (d == 0) ? 1 : stride[d - 1] * (cmax[d - 1] - cmin[d - 1] + 1);
+    }
+    size_t last = first + n - 1;
+
+    // q runs through the x-rows of the intersection.  Start from the first row
+    // which is not before the row of site "first"
+    CoordinateVector q;
+    foralldir (d) q[d] = cmin[d] + (first / stride[d]) % (cmax[d] - cmin[d] + 1);
+
+    for (int d = NDIM - 1; d >= 1; d--) {
+        if (q[d] < lo[d]) {
+            for (int e = d; e >= 1; e--)
+                q[e] = lo[e];
+            break;
+        }
+        if (q[d] > hi[d]) {
+            // past the intersection to this dim, step the next higher dim
+            int e = d + 1;
+            while (e < NDIM && q[e] >= hi[e])
+                e++;
+            if (e >= NDIM)
+                return;
+            q[e]++;
+            for (int f = e - 1; f >= 1; f--)
+                q[f] = lo[f];
+            break;
+        }
+    }
+
+    while (true) {
+        size_t rowbase = 0;
+        for (int d = 1; d < NDIM; d++)
+            rowbase += (q[d] - cmin[d]) * stride[d];
+        if (rowbase > last)
+            break;
+
+        size_t a = std::max(rowbase + (lo[0] - cmin[0]), first);
+        size_t b = std::min(rowbase + (hi[0] - cmin[0]), last);
+        for (size_t i = a; i <= b; i++) {
+            pos.push_back(i - first);
+            if (index != nullptr) {
+                CoordinateVector c = q;
+                c[0] = cmin[0] + (i - rowbase);
+                index->push_back(site_index(c));
+            }
+        }
+
+        // next row
+        int d = 1;
+        while (d < NDIM && q[d] == hi[d]) {
+            q[d] = lo[d];
+            d++;
+        }
+        if (d >= NDIM)
+            break;
+        q[d]++;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////
 /// Obtain the "logical index" on this node from CoordinateVector c
 /// returns c_x + c_y * nx + c_z * nx * ny + ...
@@ -537,6 +650,71 @@ void lattice_struct::node_struct::construct_index_map() {
 
 #endif
 
+#ifdef CACHE_BLOCKED_LAYOUT
+
+////////////////////////////////////////////////////////////////////////
+/// @internal construct the mapping from logical to real index for the
+/// cache blocked layout: the node is divided into blocks of
+/// CACHE_BLOCKED_LAYOUT sites to each direction (smaller at the upper edges),
+/// and the sites of each parity are numbered block by block.
+///
+/// Restricted to a face of the node the order is the same on both sides of
+/// a node boundary, so the halo buffers of nn-gathers stay consistent.
+////////////////////////////////////////////////////////////////////////
+
+void lattice_struct::node_struct::construct_blocked_index_map() {
+
+    constexpr int bsize = CACHE_BLOCKED_LAYOUT;
+
+    map_site_index.resize(volume);
+
+    CoordinateVector nblocks, block;
+    size_t n_blocks = 1;
+    foralldir (d) {
+        nblocks[d] = (size[d] + bsize - 1) / bsize;
+        n_blocks *= nblocks[d];
+        block[d] = 0;
+    }
+
+    unsigned even = 0, odd = evensites;
+
+    for (size_t b = 0; b < n_blocks; b++) {
+        CoordinateVector bmin, bsz, l;
+        size_t bvol = 1;
+        foralldir (d) {
+            bmin[d] = min[d] + block[d] * bsize;
+            bsz[d] = std::min(bsize, size[d] - block[d] * bsize);
+            bvol *= bsz[d];
+        }
+
+        l = bmin;
+        for (size_t s = 0; s < bvol; s++) {
+            if (l.parity() == EVEN)
+                map_site_index[get_logical_index(l)] = even++;
+            else
+                map_site_index[get_logical_index(l)] = odd++;
+
+            // next site within the block
+            foralldir (d) {
+                if (++l[d] < bmin[d] + bsz[d])
+                    break;
+                l[d] = bmin[d];
+            }
+        }
+
+        // next block
+        foralldir (d) {
+            if (++block[d] < nblocks[d])
+                break;
+            block[d] = 0;
+        }
+    }
+
+    assert(even == evensites && odd == volume);
+}
+
+#endif
+
 ////////////////////////////////////////////////////////////////////////
 /// Fill in mynode fields -- node_rank() must be set up OK
 ////////////////////////////////////////////////////////////////////////
@@ -564,6 +742,8 @@ void lattice_struct::node_struct::setup(node_info &ni, lattice_struct &lattice)
 
 #ifdef BOUNDARY_LAYER_LAYOUT
     construct_index_map();
+#elif defined(CACHE_BLOCKED_LAYOUT)
+    construct_blocked_index_map();
 #endif
 
     // map site indexes to locations -- coordinates array
@@ -932,10 +1112,6 @@ void lattice_struct::set_lattice_globals() const {
 
 bool lattice_struct::can_block_by_factor(const CoordinateVector &blocking_factor) const {
 
-#ifdef SUBNODE_LAYOUT
-    return false; // blocking not implemented for vector layout!
-#else
-
     bool ok = true;
     foralldir (d) {
         if (blocking_factor[d] <= 0) {
@@ -944,11 +1120,130 @@ bool lattice_struct::can_block_by_factor(const CoordinateVector &blocking_factor
         }
         ok = ok && (l_size[d] % blocking_factor[d] == 0);
     }
-    return ok;
 
+#ifdef SUBNODE_LAYOUT
+    // the blocked lattice must also be divisible to subnodes
+    if (ok) {
+        CoordinateVector blockvol, subdiv;
+        Direction merged_dir;
+        foralldir (d)
+            blockvol[d] = l_size[d] / blocking_factor[d];
+        ok = blocked_subnode_divisions(blockvol, blocked_node_divisions(blockvol), subdiv,
+                                       merged_dir);
+    }
 #endif
+
+    return ok;
+}
+
+/**
+ * @internal Node division of a lattice of size vol blocked from this.  Normally the
+ * division of this lattice; with hila::set_block_min_volume() nodes are merged, to the
+ * direction where they are thinnest, until the node volume is large enough.
+ */
+
+CoordinateVector lattice_struct::blocked_node_divisions(const CoordinateVector &vol) const {
+
+    CoordinateVector div = nodes.n_divisions;
+    if (hila::block_min_volume <= 0)
+        return div;
+
+    while (true) {
+        int64_t nvol = 1;
+        foralldir (d)
+            nvol *= vol[d] / div[d];
+        if (nvol >= hila::block_min_volume)
+            break;
+
+        int md = -1;
+        foralldir (d) {
+            if (div[d] > 1 && (md < 0 || vol[d] / div[d] < vol[md] / div[md]))
+                md = d;
+        }
+        if (md < 0)
+            break; // all on one node
+
+        // divide by the smallest prime factor
+        int p = 2;
+        while (div[md] % p != 0)
+            p++;
+        div[md] /= p;
+    }
+    return div;
+}
+
+#ifdef SUBNODE_LAYOUT
+
+/**
+ * @internal Find the subnode division for a lattice of size vol, blocked from this,
+ * with node division n_div.  The subnodes follow the rules of setup_layout(): subnode
+ * size is even to the subdivided directions and to at least one other direction.
+ * Returns false if the node is too small.
+ */
+
+bool lattice_struct::blocked_subnode_divisions(const CoordinateVector &vol,
+                                               const CoordinateVector &n_div,
+                                               CoordinateVector &subdiv,
+                                               Direction &merged_dir) const {
+
+    // node sizes to each direction, must be compatible with setup_node_divisors()
+    std::vector<int> nsize[NDIM];
+    foralldir (d) {
+        if (vol[d] % 2 != 0 || vol[d] < n_div[d])
+            return false;
+        std::vector<int> divisors(n_div[d] + 1);
+        int n = -1;
+        for (int i = 0; i <= vol[d]; i++) {
+            while (n < (i * n_div[d]) / vol[d]) {
+                ++n;
+                divisors[n] = i;
+            }
+        }
+        for (int i = 0; i < n_div[d]; i++)
+            nsize[d].push_back(divisors[i + 1] - divisors[i]);
+    }
+
+    // true if all node sizes to direction d are divisible by m
+    auto divisible = [&](Direction d, int m) {
+        for (int s : nsize[d])
+            if (s % m != 0)
+                return false;
+        return true;
+    };
+
+    subdiv.fill(1);
+    unsigned n_subn = 1;
+    bool div_done;
+    do {
+        div_done = false;
+        foralldir (d) {
+            int sd = subdiv[d] * 2;
+            if (n_subn < hila::number_of_subnodes && divisible(d, 2 * sd)) {
+                subdiv[d] = sd;
+                n_subn *= 2;
+                div_done = true;
+                merged_dir = d;
+            }
+        }
+    } while (div_done && n_subn < hila::number_of_subnodes);
+
+    if (n_subn != hila::number_of_subnodes)
+        return false;
+
+    // one direction outside the subdivision must be even
+    bool extradirs = false;
+    foralldir (d) {
+        if (subdiv[d] == 1) {
+            extradirs = true;
+            if (divisible(d, 2))
+                return true;
+        }
+    }
+    return !extradirs;
 }
 
+#endif
+
 /**
  * @internal implementation of lattice.block()
  */
@@ -956,6 +1251,11 @@ bool lattice_struct::can_block_by_factor(const CoordinateVector &blocking_factor
 lattice_struct *lattice_struct::block_by_factor(const CoordinateVector &blocking_factor) {
     if (!can_block_by_factor(blocking_factor)) {
         hila::out0 << "Cannot block lattice with factor " << blocking_factor << '\n';
+#ifdef SUBNODE_LAYOUT
+        hila::out0 << "With vector layout the blocked node must be divisible to "
+                   << hila::number_of_subnodes
+                   << " subnodes of even size, see the lattice layout report\n";
+#endif
         hila::terminate(0);
     }
 
@@ -1005,15 +1305,31 @@ void lattice_struct::setup_blocked_lattice(const CoordinateVector &siz, int labe
 
     mpi_comm_lat = orig.mpi_comm_lat;
 
-    // set the layout by hand from orig lattice
-    nodes.n_divisions = orig.nodes.n_divisions;
+    // set the layout by hand from orig lattice, merging nodes if needed
+    nodes.n_divisions = orig.blocked_node_divisions(siz);
     nodes.number = orig.nodes.number;
     setup_node_divisors();
 
-    nodes.map_array = orig.nodes.map_array;
-    nodes.map_inverse = orig.nodes.map_inverse;
+    agglomerated = (nodes.n_divisions != orig.nodes.n_divisions);
+    if (!agglomerated) {
+        nodes.map_array = orig.nodes.map_array;
+        nodes.map_inverse = orig.nodes.map_inverse;
+    } else {
+        setup_agglomerated_remap(orig);
+    }
+    nodes.layout_block = orig.nodes.layout_block;
+
+#ifdef SUBNODE_LAYOUT
+    // subnodes have to be set before setup_nodes(), site_index() needs them
+    blocked_subnode_divisions(l_size, nodes.n_divisions, mynode.subnodes.divisions,
+                              mynode.subnodes.merged_subnodes_dir);
+
+    hila::out0 << "Blocked lattice " << l_size << ", node subdivision to 32bit elems "
+               << mynode.subnodes.divisions << '\n';
+#endif
 
     setup_nodes();
+    setup_parent_box(orig);
     create_std_gathers();
 
     initialize_wait_arrays();
@@ -1036,6 +1352,137 @@ void lattice_struct::setup_blocked_lattice(const CoordinateVector &siz, int labe
     test_std_gathers();
 }
 
+/**
+ * @internal Agglomerated lattice: map the logical nodes to ranks.  A node goes to the
+ * rank which has the parent of its first site, or to a free rank if that is taken.
+ * Ranks without a node have map_inverse -1.
+ */
+
+void lattice_struct::setup_agglomerated_remap(const lattice_struct &orig) {
+
+    int n_active = 1;
+    foralldir (d)
+        n_active *= nodes.n_divisions[d];
+
+    nodes.map_array = (int *)memalloc(nodes.number * sizeof(int));
+    nodes.map_inverse = (int *)memalloc(nodes.number * sizeof(int));
+    for (int i = 0; i < nodes.number; i++)
+        nodes.map_inverse[i] = -1;
+
+    CoordinateVector factor = orig.l_size.element_div(l_size);
+    std::vector<int> unmapped;
+    for (int i = 0; i < n_active; i++) {
+        // logical node index runs fastest to x, as in node_rank()
+        CoordinateVector c;
+        int k = i;
+        foralldir (d) {
+            c[d] = nodes.divisors[d][k % nodes.n_divisions[d]] * factor[d];
+            k /= nodes.n_divisions[d];
+        }
+        int r = orig.node_rank(c);
+        if (nodes.map_inverse[r] < 0) {
+            nodes.map_array[i] = r;
+            nodes.map_inverse[r] = i;
+        } else {
+            unmapped.push_back(i);
+        }
+    }
+    int r = 0;
+    for (int i : unmapped) {
+        while (nodes.map_inverse[r] >= 0)
+            r++;
+        nodes.map_array[i] = r;
+        nodes.map_inverse[r] = i;
+    }
+
+    hila::out0 << "Blocked lattice " << l_size << " agglomerated to " << n_active
+               << " nodes, node layout " << nodes.n_divisions << '\n';
+}
+
+/**
+ * @internal Set the parent_box, and for agglomerated lattices the send and receive lists
+ * of move_blocked_bytes().  The boxes are traversed x fastest on both sides
+ */
+
+void lattice_struct::setup_parent_box(const lattice_struct &orig) {
+
+    CoordinateVector factor = orig.l_size.element_div(l_size);
+
+    // the box of this lattice whose parent sites are on node pni of orig
+    auto blocked_box = [&](const node_info &pni, CoordinateVector &min, CoordinateVector &size) {
+        foralldir (d) {
+            min[d] = (pni.min[d] + factor[d] - 1) / factor[d];
+            int max = (pni.min[d] + pni.size[d] - 1) / factor[d];
+            size[d] = (pni.size[d] > 0) ? std::max(max - min[d] + 1, 0) : 0;
+        }
+    };
+
+    auto set_size_factor = [](const CoordinateVector &size, Vector<NDIM, unsigned> &sf) {
+        unsigned v = 1;
+        foralldir (d) {
+            sf[d] = v;
+            v *= size[d];
+        }
+        return (size_t)v;
+    };
+
+    if (!agglomerated) {
+        parent_box.min = mynode.min;
+        parent_box.size = mynode.size;
+        parent_box.size_factor = mynode.size_factor;
+        parent_box.volume = mynode.volume;
+        return;
+    }
+
+    blocked_box(orig.nodes.nodeinfo(hila::myrank()), parent_box.min, parent_box.size);
+    parent_box.volume = set_size_factor(parent_box.size, parent_box.size_factor);
+
+    // offsets of the intersection of boxes a and b in box a
+    auto box_offsets = [&](const CoordinateVector &amin, const CoordinateVector &asize,
+                           const Vector<NDIM, unsigned> &afactor, const CoordinateVector &bmin,
+                           const CoordinateVector &bsize, std::vector<unsigned> &offset) {
+        CoordinateVector lo, isize;
+        foralldir (d) {
+            lo[d] = std::max(amin[d], bmin[d]);
+            isize[d] = std::min(amin[d] + asize[d], bmin[d] + bsize[d]) - lo[d];
+            if (isize[d] <= 0)
+                return;
+        }
+        Vector<NDIM, unsigned> ifactor;
+        size_t n = set_size_factor(isize, ifactor);
+        offset.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            size_t k = i;
+            unsigned o = 0;
+            foralldir (d) {
+                o += (lo[d] - amin[d] + k % isize[d]) * afactor[d];
+                k /= isize[d];
+            }
+            offset[i] = o;
+        }
+    };
+
+    for (int r = 0; r < nodes.number; r++) {
+        std::vector<unsigned> offset;
+        node_info ni = nodes.nodeinfo(r);
+        box_offsets(parent_box.min, parent_box.size, parent_box.size_factor, ni.min, ni.size,
+                    offset);
+        if (offset.size() > 0) {
+            block_send.rank.push_back(r);
+            block_send.offset.push_back(std::move(offset));
+        }
+
+        offset.clear();
+        CoordinateVector pmin, psize;
+        blocked_box(orig.nodes.nodeinfo(r), pmin, psize);
+        box_offsets(mynode.min, mynode.size, mynode.size_factor, pmin, psize, offset);
+        if (offset.size() > 0) {
+            block_recv.rank.push_back(r);
+            block_recv.offset.push_back(std::move(offset));
+        }
+    }
+}
+
 
 /////////////////////////////////////////////////////////////////////
 /// Create the neighbour index arrays
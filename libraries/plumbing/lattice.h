@@ -27,6 +27,12 @@ constexpr unsigned number_of_subnodes = VECTOR_SIZE / sizeof(float);
 
 // #define BOUNDARY_LAYER_LAYOUT
 
+#ifdef CACHE_BLOCKED_LAYOUT
+#if defined(SUBNODE_LAYOUT) || defined(BOUNDARY_LAYER_LAYOUT) || !defined(EVEN_SITES_FIRST)
+#error "CACHE_BLOCKED_LAYOUT works only with the non-vectorized EVEN_SITES_FIRST layout"
+#endif
+#endif
+
 namespace hila {
 /// list of field boundary conditions - used only if SPECIAL_BOUNDARY_CONDITIONS defined
 enum class bc { PERIODIC, ANTIPERIODIC, DIRICHLET };
@@ -58,6 +64,17 @@ struct node_info {
 
 namespace hila {
 extern int64_t n_gather_done, n_gather_avoided;
+// halo receives waited for, and those of them complete already when the wait started
+extern int64_t n_receive_waited, n_receive_ready;
+
+/// Force the node division (and optionally the remap block size) used by setup_layout(),
+/// instead of the automatic layout planner.  Command line: -layout <n_x> ... [<block>]
+void set_node_layout(const std::vector<int> &divisions, int block = 0);
+
+/// Agglomerate blocked lattices: nodes of a blocked lattice are merged, leaving ranks
+/// without sites, until the node volume is at least min_volume sites.  0 (default) keeps
+/// the node division of the parent lattice.  Command line: -block-min-volume <sites>
+void set_block_min_volume(int64_t min_volume);
 }
 
 /// Some backends need specialized lattice data
@@ -82,6 +99,22 @@ class lattice_struct {
     // is this lattice derived from another, through e.g. .block()?  Pointer to parent lattice
     lattice_struct *parent;
 
+    /// Blocked lattice: the box of sites whose parent lattice sites are on this node.
+    /// Same as the mynode box unless the lattice is agglomerated (nodes merged)
+    struct parent_box_struct {
+        CoordinateVector min, size;
+        Vector<NDIM, unsigned> size_factor; // as in node_struct
+        size_t volume;
+    } parent_box;
+    bool agglomerated = false;
+
+    /// Agglomerated lattice: ranks and logical box offsets of the parent_box sites sent
+    /// to other nodes, and of the mynode sites received, used by move_blocked_bytes()
+    struct block_move_struct {
+        std::vector<int> rank;
+        std::vector<std::vector<unsigned>> offset;
+    } block_send, block_recv;
+
     /// Information about the node stored on this process
     struct node_struct {
         lattice_struct *parent; // parent lattice, for methods
@@ -97,8 +130,16 @@ class lattice_struct {
         std::vector<CoordinateVector> coordinates;
 #endif
 
-#ifdef BOUNDARY_LAYER_LAYOUT
+#if defined(BOUNDARY_LAYER_LAYOUT) || defined(CACHE_BLOCKED_LAYOUT)
+        // physical site index from the logical index
         std::vector<unsigned> map_site_index;
+#endif
+
+#ifdef CACHE_BLOCKED_LAYOUT
+        void construct_blocked_index_map();
+#endif
+
+#ifdef BOUNDARY_LAYER_LAYOUT
         // in physical layout, sites are (if EVEN_SITES_FIRST)
         // inner_even + inner_odd + boundary_even + boundary_odd
         // if not  EVEN_SITES_FIRST the _odd variables are unused
@@ -148,10 +189,15 @@ class lattice_struct {
 
         int *RESTRICT map_array;        // mapping (optional)
         int *RESTRICT map_inverse;      // inv of it
+        int layout_block = 0;           // nodes in remap block, 0: use NODE_LAYOUT_BLOCK
         void create_remap();            // create remap_node
         int remap(int i) const;         // use remap
         int inverse_remap(int i) const; // inverse remap
 
+        /// shape (nodes to each direction) of the block of nodes which create_remap()
+        /// places on consecutive ranks, for given division and block size
+        static CoordinateVector remap_block_shape(const CoordinateVector &n_divisions, int block);
+
     } nodes;
 
     /// Information necessary to communicate with a node
@@ -274,6 +320,14 @@ class lattice_struct {
     unsigned site_index(const CoordinateVector &c, const unsigned node) const;
 
     void create_std_gathers();
+
+    /// Sites of node ni which are inside box cmin..cmax (inclusive) and have box index
+    /// (x fastest, from 0 at cmin) in range first ... first+n-1.  Appends the box indexes
+    /// minus first to pos, in increasing order.  If index != nullptr, ni must be this node,
+    /// and the local site indexes are appended to it.
+    void box_sites_on_node(const node_info &ni, const CoordinateVector &cmin,
+                           const CoordinateVector &cmax, size_t first, size_t n,
+                           std::vector<size_t> &pos, std::vector<unsigned> *index = nullptr) const;
     gen_comminfo_struct create_general_gather(const CoordinateVector &r);
     std::vector<comm_node_struct> create_comm_node_vector(CoordinateVector offset, unsigned *index,
                                                           bool receive);
@@ -400,6 +454,29 @@ class lattice_struct {
     void setup_blocked_lattice(const CoordinateVector &vol, int label,
                                lattice_struct &orig_lattice);
 
+    void setup_agglomerated_remap(const lattice_struct &orig);
+    void setup_parent_box(const lattice_struct &orig);
+    CoordinateVector blocked_node_divisions(const CoordinateVector &vol) const;
+
+#ifdef SUBNODE_LAYOUT
+    bool blocked_subnode_divisions(const CoordinateVector &vol, const CoordinateVector &n_div,
+                                   CoordinateVector &subdiv, Direction &merged_dir) const;
+#endif
+
+    /// Move blocked lattice data, logically ordered in buf, from the parent_box to the
+    /// mynode box (or back if to_parent).  buf is replaced with a new d_malloc'd buffer.
+    /// Nothing is done unless the lattice is agglomerated
+    template <typename T>
+    void move_blocked_sites(T *&buf, bool to_parent) const {
+        if (agglomerated) {
+            void *p = buf;
+            move_blocked_bytes(p, sizeof(T), to_parent);
+            buf = static_cast<T *>(p);
+        }
+    }
+
+    void move_blocked_bytes(void *&buf, size_t elem_size, bool to_parent) const;
+
     void set_lattice_globals() const;
 };
 
@@ -548,7 +625,9 @@ class Lattice {
 
     /**
      * @brief Test if lattice can be blocked by factor given in argument.
-     * @details lattice.size() must be element-by-element divisible by factor
+     * @details lattice.size() must be element-by-element divisible by factor.  With the
+     * vector (AVX) layout the nodes of the blocked lattice must also be divisible to
+     * vector subnodes, which fails if the blocked lattice is too small.
      *
      * Example: lattice.can_block({2,2,2}) returns true if (3-dim) lattice dimensions are even
      */
@@ -600,6 +679,10 @@ class Lattice {
      * @endcode
      *
      *
+     * @note With hila::set_block_min_volume() (command line -block-min-volume) small nodes
+     * of the blocked lattice are merged, and the remaining ranks have no sites on it.
+     * block_from() and unblock_to() move the data between the ranks.
+     *
      * @returns blocked Lattice
      */
     Lattice block(const CoordinateVector &cv) {
@@ -27,12 +27,21 @@ void lattice_struct::allnodes::create_remap() {
     lattice.ptr()->nodes.map_inverse = nullptr;
 }
 
+// agglomerated blocked lattices set the map arrays, see setup_agglomerated_remap()
+
 int lattice_struct::allnodes::remap(int i) const {
-    return i;
+    return (map_array != nullptr) ? map_array[i] : i;
 }
 
 int lattice_struct::allnodes::inverse_remap(int i) const {
-    return i;
+    return (map_inverse != nullptr) ? map_inverse[i] : i;
+}
+
+CoordinateVector lattice_struct::allnodes::remap_block_shape(const CoordinateVector &n_divisions,
+                                                             int block) {
+    CoordinateVector blocksize;
+    blocksize.fill(1);
+    return blocksize;
 }
 
 
@@ -41,6 +50,9 @@ int lattice_struct::allnodes::inverse_remap(int i) const {
 ////////////////////////////////////////////////////////////////////
 // Arrange nodes so that NODE_LAYOUT_BLOCK nodes are "close"
 //
+// The block size is NODE_LAYOUT_BLOCK unless setup_layout() has chosen
+// nodes.layout_block (e.g. the number of ranks on a shared memory node).
+//
 // For example, in 2d and NODE_LAYOUT_BLOCK = 4 the MPI indices run as
 //
 //  1  2 |  5  6 | 9  10
@@ -51,14 +63,13 @@ int lattice_struct::allnodes::inverse_remap(int i) const {
 //
 ////////////////////////////////////////////////////////////////////
 
-void lattice_struct::allnodes::create_remap() {
-
-    hila::out0 << "Node remapping: NODE_LAYOUT_BLOCK with blocksize " << NODE_LAYOUT_BLOCK << '\n';
+CoordinateVector lattice_struct::allnodes::remap_block_shape(const CoordinateVector &n_divisions,
+                                                             int block) {
 
-    // let us allow only factors of 5,3 and 2 in NODE_LAYOUT_BLOCK
+    // let us allow only factors of 5,3 and 2 in block
     CoordinateVector blocksize;
-    CoordinateVector blockdivs = lattice->nodes.n_divisions;
-    int nblocks = NODE_LAYOUT_BLOCK;
+    CoordinateVector blockdivs = n_divisions;
+    int nblocks = block;
     blocksize.fill(1);
 
     bool found = true;
@@ -79,6 +90,20 @@ void lattice_struct::allnodes::create_remap() {
             }
         }
     }
+    return blocksize;
+}
+
+void lattice_struct::allnodes::create_remap() {
+
+    // block size may have been chosen by setup_layout()
+    if (layout_block <= 0)
+        layout_block = NODE_LAYOUT_BLOCK;
+
+    hila::out0 << "Node remapping: NODE_LAYOUT_BLOCK with blocksize " << layout_block << '\n';
+
+    CoordinateVector blocksize = remap_block_shape(this->n_divisions, layout_block);
+    CoordinateVector blockdivs;
+    foralldir(d) blockdivs[d] = this->n_divisions[d] / blocksize[d];
 
     hila::out0 << "Node block size " << blocksize << "  block division " << blockdivs << '\n';
 
@@ -89,7 +114,7 @@ void lattice_struct::allnodes::create_remap() {
     this->map_inverse = (int *)memalloc(this->number * sizeof(int));
     // nodes.map_inverse = nullptr;
 
-    nblocks = 1;
+    int nblocks = 1;
     foralldir(d) nblocks *= blocksize[d];
 
     // Loop over the "logical" node indices (i.e.)
@@ -1,4 +1,16 @@
 #include "plumbing/memalloc.h"
+#include "plumbing/lattice.h"
+#include "plumbing/com_mpi.h"
+
+#include <sys/mman.h>
+#include <unordered_map>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+
+#if defined(OPENMP) && !defined(HILAPP)
+#include <omp.h>
+#endif
 
 
 /// Memory allocator -- gives back aligned memory, if ALIGN defined
@@ -30,10 +42,10 @@ void *memalloc(std::size_t size, const char *filename, const unsigned line) {
 #else
 
     void *p;
-    // align to 32 bytes (parameter?)
-    // make size multiple of 32 too
-    size = ((size + 31) / 32) * 32;
-    int e = posix_memalign(&p, (std::size_t)32, size);
+    // align to MEMALLOC_ALIGNMENT bytes, make size multiple of it too
+    constexpr std::size_t align = MEMALLOC_ALIGNMENT;
+    size = ((size + align - 1) / align) * align;
+    int e = posix_memalign(&p, align, size);
     if (e != 0) {
         if (filename != nullptr) {
             hila::out << " *** memalloc failure in file " << filename << " at line "
@@ -86,3 +98,216 @@ void d_free(void *dptr) {
 #endif
 
 }
+
+
+//////////////////////////////////////////////////////////////////////////////////
+/// Field payload allocation
+
+namespace {
+
+constexpr std::size_t hugepage_size = 2 * 1024 * 1024;
+
+hila::hugepage_mode hugepages = hila::hugepage_mode::off;
+
+// backing of an allocation
+enum class backing { normal, transparent, explicit_pages };
+
+struct field_alloc_info {
+    std::size_t size;
+    backing type;
+};
+
+// live field allocations, needed for munmap() and statistics
+std::unordered_map<void *, field_alloc_info> field_allocs;
+
+struct {
+    int64_t allocs = 0, frees = 0, fallbacks = 0;
+    std::size_t bytes = 0, peak = 0;
+    std::size_t peak_by_type[3] = {0, 0, 0}, bytes_by_type[3] = {0, 0, 0};
+    double first_touch_time = 0;
+} field_stats;
+
+void field_memalloc_failure(std::size_t size, int e) {
+    hila::out << " *** field memory allocation failure, requested " << size << " bytes";
+    if (e != 0)
+        hila::out << ", error code " << e;
+    hila::out << "\n *********************************" << std::endl;
+    exit(1);
+}
+
+#if defined(OPENMP) && !defined(HILAPP)
+/// Touch bytes [0, n) in the static partition of an omp parallel for over it:
+/// thread t of nt gets bytes [t*n/nt, (t+1)*n/nt)
+void touch_partitioned(char *p, std::size_t n) {
+#pragma omp parallel
+    {
+        std::size_t nt = omp_get_num_threads();
+        std::size_t t = omp_get_thread_num();
+        std::size_t begin = n * t / nt;
+        std::size_t end = n * (t + 1) / nt;
+        if (end > begin)
+            std::memset(p + begin, 0, end - begin);
+    }
+}
+#endif
+
+/// First touch of the local sites, matching the partition of the omp site loops.
+/// With EVEN_SITES_FIRST the even and odd sites are touched as separate blocks,
+/// as the EVEN and ODD loops partition them; ALL loops then match approximately.
+void parallel_first_touch(char *p, std::size_t even_bytes, std::size_t odd_bytes) {
+#if defined(OPENMP) && !defined(HILAPP)
+    double t0 = omp_get_wtime();
+#ifdef EVEN_SITES_FIRST
+    touch_partitioned(p, even_bytes);
+    touch_partitioned(p + even_bytes, odd_bytes);
+#else
+    touch_partitioned(p, even_bytes + odd_bytes);
+#endif
+    field_stats.first_touch_time += omp_get_wtime() - t0;
+#endif
+}
+
+/// Fresh anonymous mapping of size bytes (a multiple of hugepage_size), aligned
+/// to hugepage_size: map one huge page extra and unmap the ends
+void *map_hugepage_aligned(std::size_t size) {
+    char *p = (char *)mmap(nullptr, size + hugepage_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+    std::size_t head = (hugepage_size - (uintptr_t)p % hugepage_size) % hugepage_size;
+    if (head > 0)
+        munmap(p, head);
+    munmap(p + head + size, hugepage_size - head);
+    return p + head;
+}
+
+} // namespace
+
+void hila::set_hugepage_mode(hila::hugepage_mode mode) {
+    hugepages = mode;
+}
+
+void *field_memalloc(std::size_t size, std::size_t even_bytes, std::size_t odd_bytes) {
+
+    void *p = nullptr;
+    backing type = backing::normal;
+
+    // huge pages only for allocations of at least one huge page
+    bool huge = hugepages != hila::hugepage_mode::off && size >= hugepage_size;
+    if (huge)
+        size = ((size + hugepage_size - 1) / hugepage_size) * hugepage_size;
+
+    if (huge && hugepages == hila::hugepage_mode::explicit_pages) {
+#ifdef MAP_HUGETLB
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED)
+            p = nullptr;
+#endif
+        if (p != nullptr) {
+            type = backing::explicit_pages;
+        } else {
+            // no (more) huge pages reserved, use transparent ones
+            if (field_stats.fallbacks++ == 0)
+                hila::out << " *** rank " << hila::myrank()
+                          << ": explicit huge pages not available, using transparent\n";
+        }
+    }
+
+    if (p == nullptr && huge) {
+        p = map_hugepage_aligned(size);
+        if (p == nullptr)
+            field_memalloc_failure(size, errno);
+#ifdef MADV_HUGEPAGE
+        madvise(p, size, MADV_HUGEPAGE);
+#endif
+        type = backing::transparent;
+    }
+
+    if (p == nullptr) {
+        size = ((size + MEMALLOC_ALIGNMENT - 1) / MEMALLOC_ALIGNMENT) * MEMALLOC_ALIGNMENT;
+        int e = posix_memalign(&p, MEMALLOC_ALIGNMENT, size);
+        if (e != 0)
+            field_memalloc_failure(size, e);
+    } else {
+        // freshly mapped, no page placed yet: first touch places them.  Memory from
+        // posix_memalign may be reused from the heap and is left as is
+        even_bytes = std::min(even_bytes, size);
+        odd_bytes = std::min(odd_bytes, size - even_bytes);
+        parallel_first_touch((char *)p, even_bytes, odd_bytes);
+    }
+
+    field_allocs[p] = {size, type};
+    int t = static_cast<int>(type);
+    field_stats.allocs++;
+    field_stats.bytes += size;
+    field_stats.bytes_by_type[t] += size;
+    field_stats.peak = std::max(field_stats.peak, field_stats.bytes);
+    field_stats.peak_by_type[t] =
+        std::max(field_stats.peak_by_type[t], field_stats.bytes_by_type[t]);
+
+    return p;
+}
+
+void field_memfree(void *p) {
+    if (p == nullptr)
+        return;
+
+    auto it = field_allocs.find(p);
+    assert(it != field_allocs.end() && "field_memfree() of memory not from field_memalloc()");
+
+    field_alloc_info info = it->second;
+    field_allocs.erase(it);
+
+    if (info.type != backing::normal)
+        munmap(p, info.size);
+    else
+        free(p);
+
+    field_stats.frees++;
+    field_stats.bytes -= info.size;
+    field_stats.bytes_by_type[static_cast<int>(info.type)] -= info.size;
+}
+
+/// Report field allocations: numbers and peak sizes, summed over ranks, and the
+/// huge page backing of the process as seen by the kernel (rank 0)
+
+void hila::report_memalloc_stats() {
+    if (!hila::is_comm_initialized() || field_stats.allocs == 0)
+        return;
+
+    double v[6] = {(double)field_stats.allocs,          (double)field_stats.peak,
+                   (double)field_stats.peak_by_type[1], (double)field_stats.peak_by_type[2],
+                   (double)field_stats.fallbacks,       field_stats.first_touch_time};
+    MPI_Allreduce(MPI_IN_PLACE, v, 6, MPI_DOUBLE, MPI_SUM, lattice->mpi_comm_lat);
+    double maxpeak = field_stats.peak;
+    MPI_Allreduce(MPI_IN_PLACE, &maxpeak, 1, MPI_DOUBLE, MPI_MAX, lattice->mpi_comm_lat);
+
+    constexpr double MB = 1024.0 * 1024.0;
+    hila::out0 << " MEMORY fields: " << (int64_t)v[0] << " allocations, peak " << v[1] / MB
+               << " MB total, max " << maxpeak / MB << " MB/rank, alignment "
+               << MEMALLOC_ALIGNMENT << '\n';
+
+    if (hugepages != hila::hugepage_mode::off) {
+        hila::out0 << " MEMORY huge pages: peak " << v[3] / MB << " MB explicit, " << v[2] / MB
+                   << " MB transparent (madvise)";
+        if (v[4] > 0)
+            hila::out0 << ", " << (int64_t)v[4] << " explicit allocations fell back";
+        hila::out0 << '\n';
+
+        // how much the kernel actually backs with huge pages
+        if (hila::myrank() == 0) {
+            std::ifstream smaps("/proc/self/smaps_rollup");
+            std::string line;
+            while (std::getline(smaps, line)) {
+                if (line.rfind("AnonHugePages:", 0) == 0)
+                    hila::out0 << " MEMORY rank 0 " << line << '\n';
+            }
+        }
+
+#if defined(OPENMP) && !defined(HILAPP)
+        hila::out0 << " MEMORY parallel first touch " << v[5] / hila::number_of_nodes()
+                   << " s/rank\n";
+#endif
+    }
+}
@@ -1,3 +1,6 @@
+#ifndef HILA_MEMALLOC_H_
+#define HILA_MEMALLOC_H_
+
 /// Memory allocator -- gives back aligned memory, if ALIGN defined
 
 #include "plumbing/defs.h"
@@ -9,6 +12,16 @@
 #define ALIGNED_MEMALLOC
 #endif
 
+/// Alignment of aligned allocations in bytes: the vector size for AVX512
+/// (VECTOR_SIZE=64), otherwise 32.  Field payloads are always aligned.
+#ifndef MEMALLOC_ALIGNMENT
+#if defined(VECTOR_SIZE) && VECTOR_SIZE > 32
+#define MEMALLOC_ALIGNMENT VECTOR_SIZE
+#else
+#define MEMALLOC_ALIGNMENT 32
+#endif
+#endif
+
 void *memalloc(std::size_t size);
 void *memalloc(std::size_t size, const char *filename, const unsigned line);
 
@@ -16,3 +29,26 @@ void *memalloc(std::size_t size, const char *filename, const unsigned line);
 /// depending on the target.  Free with d_free()
 void *d_malloc(std::size_t size);
 void d_free(void * dptr);
+
+/// Allocate field payload storage of size bytes.  The memory is aligned to
+/// MEMALLOC_ALIGNMENT, or placed on freshly mapped 2MB huge pages if set with
+/// hila::set_hugepage_mode().  With OpenMP, huge page storage is first touched by
+/// the threads in the same static partition as the site loops, so that the pages
+/// are placed on the NUMA domain of the thread using them.  even_bytes and
+/// odd_bytes are the sizes of the even and odd local sites, stored in this order
+/// with EVEN_SITES_FIRST.  Free with field_memfree()
+void *field_memalloc(std::size_t size, std::size_t even_bytes, std::size_t odd_bytes);
+void field_memfree(void *p);
+
+namespace hila {
+/// Backing of field payloads: normal pages, transparent huge pages (madvise) or
+/// explicit huge pages (mmap MAP_HUGETLB, falls back to transparent if none available)
+enum class hugepage_mode { off, transparent, explicit_pages };
+void set_hugepage_mode(hugepage_mode mode);
+
+/// Print field allocation statistics, called by all ranks in finishrun()
+void report_memalloc_stats();
+} // namespace hila
+
+
+#endif
@@ -50,6 +50,20 @@
 #undef EVEN_SITES_FIRST
 #endif
 
+#ifdef CACHE_BLOCKED_LAYOUT
+/**
+ * @brief Cache blocked site layout, -DCACHE_BLOCKED_LAYOUT=n
+ * @details Sites of each parity are stored in blocks of n^NDIM sites (clipped at the node
+ * edges), blocks in typewriter order.  The default typewriter order places the neighbours
+ * to the slowest direction a full node slice apart in memory; in the blocked order they are
+ * mostly within the same or the neighbouring block, improving cache reuse in stencil loops.
+ * Only for the non-vectorized layout with EVEN_SITES_FIRST.  -DCACHE_BLOCKED_LAYOUT=0 is off.
+ */
+#if CACHE_BLOCKED_LAYOUT == 0
+#undef CACHE_BLOCKED_LAYOUT
+#endif
+#endif
+
 /// NODE_LAYOUT_TRIVIAL or NODE_LAYOUT_BLOCK determine how MPI ranks are laid out on logical
 /// lattice.  TRIVIAL lays out the lattice on logical order where x-direction runs fastest etc.
 /// if NODE_LAYOUT_BLOCK is defined, NODE_LAYOUT_BLOCK consecutive MPI ranks are laid out so that
@@ -1,23 +1,168 @@
 /// Setup layout does the node division.  This version
-/// first tries an even distribution, with equally sized
-/// nodes, and if that fails allows slightly different
-/// node sizes.
+/// chooses the division with the smallest halo communication
+/// cost among the divisions with equally sized nodes, and
+/// if there are none allows slightly different node sizes.
+
+#include <algorithm>
 
 #include "plumbing/defs.h"
 #include "plumbing/lattice.h"
 
+#include "plumbing/com_mpi.h"
+
+namespace hila {
+// set with hila::set_node_layout(), see lattice.cpp
+extern std::vector<int> node_layout_divisions;
+extern int node_layout_block;
+} // namespace hila
+
 /***************************************************************/
 
-/* number of primes to be used in factorization */
-#define NPRIMES 12
-const static int prime[NPRIMES] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+/* Layout planner: enumerate all node divisions of the lattice, and estimate the
+ * halo communication cost of each.  Halo faces between ranks on the same shared
+ * memory node (host) are weighted with the measured relative cost of intra-host messages.
+ * Which ranks end up on the same host depends on the node remapping (map_node_layout.cpp),
+ * thus the remap block size is chosen together with the division.
+ */
+
+namespace {
+struct layout_candidate {
+    CoordinateVector div;  // nodes to each direction
+    int block;             // remap block size
+    int64_t max_volume;    // sites on the largest node
+    int64_t halo;          // halo sites of the largest node
+    double inter_fraction; // fraction of halo sites communicated to other hosts
+    double cost;           // halo weighted with link costs
+};
+} // namespace
+
+// Find all divisions of n nodes to directions d ... NDIM-1.  Accept divisions where
+// nodes have at least 2 sites to each direction, and at most one direction is
+// divided unevenly
+static void enumerate_divisions(int n, int d, int uneven, CoordinateVector &div,
+                                const CoordinateVector &lsize,
+                                std::vector<CoordinateVector> &list) {
+    for (int k = (d == NDIM - 1) ? n : 1; k <= n; k++) {
+        if (n % k != 0 || lsize[d] / k < 2)
+            continue;
+        int unev = uneven + (lsize[d] % k != 0);
+        if (unev > 1)
+            continue;
+        div[d] = k;
+        if (d == NDIM - 1)
+            list.push_back(div);
+        else
+            enumerate_divisions(n / k, d + 1, unev, div, lsize, list);
+    }
+}
+
+// If n consecutive nodes, counted in x-fastest order in division div, form a box,
+// return true and its shape
+static bool consecutive_shape(const CoordinateVector &div, int n, CoordinateVector &shape) {
+    shape.fill(1);
+    foralldir(d) {
+        if (n == 1)
+            break;
+        if (n % div[d] == 0) {
+            shape[d] = div[d];
+            n /= div[d];
+        } else if (div[d] % n == 0) {
+            shape[d] = n;
+            n = 1;
+        } else {
+            return false;
+        }
+    }
+    return n == 1;
+}
+
+// Shape of the box of nodes placed on one host by the remapping, when each host
+// has nhost consecutive ranks.  Returns false if the host does not hold a box
+static bool host_shape(const CoordinateVector &div, int block, int nhost,
+                       CoordinateVector &shape) {
+    CoordinateVector bsize = lattice_struct::allnodes::remap_block_shape(div, block);
+    int nb = 1;
+    foralldir(d) nb *= bsize[d];
+
+    if (nb % nhost == 0)
+        return consecutive_shape(bsize, nhost, shape);
+
+    if (nhost % nb == 0) {
+        // host holds several consecutive blocks
+        CoordinateVector bdiv, bshape;
+        foralldir(d) bdiv[d] = div[d] / bsize[d];
+        if (!consecutive_shape(bdiv, nhost / nb, bshape))
+            return false;
+        foralldir(d) shape[d] = bsize[d] * bshape[d];
+        return true;
+    }
+    return false;
+}
+
+static void evaluate_layout(layout_candidate &c, const CoordinateVector &lsize,
+                            const hila::node_topology_struct &topo) {
+    CoordinateVector nsize;
+    c.max_volume = 1;
+    foralldir(d) {
+        nsize[d] = (lsize[d] + c.div[d] - 1) / c.div[d];
+        c.max_volume *= nsize[d];
+    }
+
+    CoordinateVector hshape;
+    bool host_box = topo.contiguous && topo.ranks_per_host > 1 &&
+                    host_shape(c.div, c.block, topo.ranks_per_host, hshape);
+
+    double inter = 0;
+    c.halo = 0;
+    c.cost = 0;
+    foralldir(d) if (c.div[d] > 1) {
+        int64_t h = 2 * (c.max_volume / nsize[d]);
+
+        // fraction of faces to direction d which cross host boundary
+        double f;
+        if (topo.number_of_hosts == 1 || (host_box && hshape[d] == c.div[d]))
+            f = 0;
+        else if (host_box)
+            f = 1.0 / hshape[d];
+        else
+            f = 1;
+
+        c.halo += h;
+        inter += h * f;
+        c.cost += h * (f + (1 - f) * topo.intra_host_cost);
+    }
+    c.inter_fraction = (c.halo > 0) ? inter / c.halo : 0;
+}
+
+// ordering: smallest largest node first (even divisions), then cost.  For equal costs
+// prefer dividing the last directions, as the original layout does.  Otherwise keep the
+// order, i.e. NODE_LAYOUT_BLOCK first
+static bool layout_less(const layout_candidate &a, const layout_candidate &b) {
+    if (a.max_volume != b.max_volume)
+        return a.max_volume < b.max_volume;
+    if (a.cost != b.cost)
+        return a.cost < b.cost;
+    for (int d = NDIM - 1; d >= 0; d--)
+        if (a.div[d] != b.div[d])
+            return a.div[d] > b.div[d];
+    return false;
+}
+
+static std::string division_string(const CoordinateVector &div) {
+    std::stringstream ss;
+    foralldir(d) {
+        if (d > 0)
+            ss << " x ";
+        ss << div[d];
+    }
+    return ss.str();
+}
 
 /* Set up now squaresize and nsquares - arrays
  * Print info to outf as we proceed
  */
 
 void lattice_struct::setup_layout() {
-    int nfactors[NPRIMES];
     CoordinateVector nodesiz;
 
     hila::print_dashed_line();
@@ -30,119 +175,111 @@ void lattice_struct::setup_layout() {
     hila::out0 << "  =  " << l_volume << " sites\n";
     hila::out0 << "Dividing to " << hila::number_of_nodes() << " nodes\n";
 
-    // foralldir(d) if (l_size[d] % 2 != 0) {
-    //     hila::out0 << "Lattice must be even to all directions (odd size:TODO)\n";
-    //     hila::finishrun();
-    // }
-
-    // Factorize the node number in primes
-    // These factors must be used in slicing the lattice!
     int nn = hila::number_of_nodes();
 
-    int i = nn;
-    for (int n = 0; n < NPRIMES; n++) {
-        nfactors[n] = 0;
-        while (i % prime[n] == 0) {
-            i /= prime[n];
-            nfactors[n]++;
+    hila::node_topology_struct topo = hila::measure_node_topology();
+
+    // remap block sizes to try
+    std::vector<int> blocks;
+#if defined(NODE_LAYOUT_BLOCK)
+    if (hila::node_layout_block > 0) {
+        blocks.push_back(hila::node_layout_block);
+    } else {
+        blocks.push_back(NODE_LAYOUT_BLOCK);
+        if (topo.contiguous && topo.ranks_per_host > 1 && topo.ranks_per_host != NODE_LAYOUT_BLOCK)
+            blocks.push_back(topo.ranks_per_host);
+    }
+#else
+    blocks.push_back(0);
+#endif
+
+    std::vector<CoordinateVector> divisions;
+    bool forced = !hila::node_layout_divisions.empty();
+    if (forced) {
+        CoordinateVector div;
+        int64_t prod = 1;
+        bool ok = (hila::node_layout_divisions.size() == NDIM);
+        if (ok) {
+            foralldir(d) {
+                div[d] = hila::node_layout_divisions[d];
+                prod *= div[d];
+                if (div[d] < 1 || div[d] > l_size[d])
+                    ok = false;
+            }
+        }
+        if (!ok || prod != nn) {
+            hila::out0 << "Invalid node layout given with -layout: need " << NDIM
+                       << " divisions, with product " << nn
+                       << " and no more divisions than lattice size\n";
+            hila::finishrun();
+        }
+        divisions.push_back(div);
+    } else {
+        CoordinateVector div;
+        enumerate_divisions(nn, 0, 0, div, l_size, divisions);
+        if (divisions.size() == 0) {
+            hila::out0 << "Could not successfully lay out the lattice with " << nn << " nodes\n";
+            hila::finishrun();
         }
     }
-    if (i != 1) {
-        hila::out0 << "Cannot factorize " << nn << " nodes with primes up to " << prime[NPRIMES - 1]
-                   << '\n';
-        hila::finishrun();
+
+    std::vector<layout_candidate> candidates;
+    for (auto &div : divisions)
+        for (int b : blocks) {
+            layout_candidate c;
+            c.div = div;
+            c.block = b;
+            evaluate_layout(c, l_size, topo);
+            candidates.push_back(c);
+        }
+    std::stable_sort(candidates.begin(), candidates.end(), layout_less);
+
+    const layout_candidate &best = candidates[0];
+
+    // print the cost table of the best candidates
+    if (topo.number_of_hosts > 1 && topo.ranks_per_host > 1) {
+        hila::out0 << "Ranks on " << topo.number_of_hosts << " hosts, " << topo.ranks_per_host
+                   << " ranks per host" << (topo.contiguous ? "" : " (not consecutive)")
+                   << ", intra-host link cost " << std::setprecision(3) << topo.intra_host_cost
+                   << " relative to inter-host\n";
+    } else if (topo.ranks_per_host == 0) {
+        hila::out0 << "Ranks on " << topo.number_of_hosts
+                   << " hosts, unequal number of ranks per host\n";
     }
+    if (forced)
+        hila::out0 << "Node division forced with -layout\n";
+
+    hila::out0 << "Layout candidates (halo sites of the largest node):\n";
+    hila::out0 << "  " << std::left << std::setw(20) << "division" << std::right << std::setw(7)
+               << "block" << std::setw(14) << "node volume" << std::setw(12) << "halo"
+               << std::setw(12) << "inter-host" << std::setw(14) << "cost" << '\n';
+    for (int i = 0; i < candidates.size() && i < 8; i++) {
+        const auto &c = candidates[i];
+        hila::out0 << (i == 0 ? "* " : "  ") << std::left << std::setw(20)
+                   << division_string(c.div) << std::right << std::setw(7) << c.block
+                   << std::setw(14) << c.max_volume << std::setw(12) << c.halo << std::setw(11)
+                   << std::fixed << std::setprecision(1) << 100 * c.inter_fraction << '%'
+                   << std::setw(14) << std::setprecision(0) << c.cost << '\n';
+        hila::out0.unsetf(std::ios::fixed);
+    }
+    if (candidates.size() > 8)
+        hila::out0 << "  (" << candidates.size() - 8 << " more)\n";
+    hila::out0 << std::setprecision(6);
 
-    // strategy: try to increase the box size to one of the directions until rem = 0
-    // find the optimal direction to do it
-    // Use simple heuristic: take the dim with the least amount of added "ghost sites"
+    // take the best one
+    nodes.n_divisions = best.div;
+    nodes.layout_block = best.block;
 
+    // mdir is the direction where we do uneven division (if done)
+    int mdir = 0;
     CoordinateVector nsize;
-    int64_t ghosts[NDIM]; // int is too small
-
     foralldir(d) {
-        int64_t cosize = l_volume / l_size[d];
-        int64_t n = l_size[d];
-        while ((n * cosize) % nn != 0)
-            n++; // virtual size can be odd
-        // now nsize is the new would-be size
-        ghosts[d] = (n - l_size[d]) * cosize;
-        nsize[d] = n;
+        nodesiz[d] = (l_size[d] + nodes.n_divisions[d] - 1) / nodes.n_divisions[d];
+        nsize[d] = nodesiz[d] * nodes.n_divisions[d];
+        if (nsize[d] != l_size[d])
+            mdir = d;
     }
 
-    int mdir = 0;
-    bool secondtime = false;
-    do {
-        // try the division a couple of times, if the 1st fails
-
-        foralldir(j) if (ghosts[mdir] > ghosts[j]) mdir = j;
-        // mdir is the direction where we do uneven division (if done)
-        // hila::out0 << "MDIR " << mdir << " ghosts mdir " << ghosts[mdir] << " nsize " <<
-        // nsize[mdir] << '\n';
-
-        foralldir(i) {
-            nodesiz[i] = (i == mdir) ? nsize[i] : l_size[i]; // start with ghosted lattice size
-            nodes.n_divisions[i] = 1;
-        }
-
-        for (int n = NPRIMES - 1; n >= 0; n--)
-            for (int i = 0; i < nfactors[n]; i++) {
-                // figure out which direction to divide -- start from the largest prime,
-                // because we don't want this to be last divisor! (would probably wind up
-                // with size 1)
-
-                // find largest divisible dimension of h-cubes - start from last, because
-                int msize = 1, dir;
-                for (dir = 0; dir < NDIM; dir++)
-                    if (nodesiz[dir] > msize && nodesiz[dir] % prime[n] == 0)
-                        msize = nodesiz[dir];
-
-                // if one direction with largest dimension has already been
-                // divided, divide it again.  Otherwise divide first direction
-                // with largest dimension.
-
-                // Switch here to first divide along t-direction, in
-                // order to
-                // a) minimize spatial blocks
-                // b) In sf t-division is cheaper (1 non-communicating slice)
-
-                for (dir = NDIM - 1; dir >= 0; dir--)
-                    if (nodesiz[dir] == msize && nodes.n_divisions[dir] > 1 &&
-                        nodesiz[dir] % prime[n] == 0)
-                        break;
-
-                // If not previously sliced, take one direction to slice
-                if (dir < 0)
-                    for (dir = NDIM - 1; dir >= 0; dir--)
-                        if (nodesiz[dir] == msize && nodesiz[dir] % prime[n] == 0)
-                            break;
-
-                if (dir < 0) {
-                    // This cannot happen
-                    hila::out0 << "CANNOT HAPPEN! in setup_layout_generic.c\n";
-                    hila::finishrun();
-                }
-
-                // Now slice it
-                nodesiz[dir] /= prime[n];
-                nodes.n_divisions[dir] *= prime[n];
-            }
-
-        // now check that the div makes sens
-        bool fail = false;
-        foralldir(dir) if (nodesiz[dir] < 2) fail = true; // don't allow nodes of size 1
-        if (fail && !secondtime) {
-            secondtime = true;
-            ghosts[mdir] =
-                (1ULL << 62); // this short-circuits direction mdir, some other taken next
-        } else if (fail) {
-            hila::out0 << "Could not successfully lay out the lattice with "
-                       << hila::number_of_nodes() << " nodes\n";
-            hila::finishrun();
-        }
-
-    } while (secondtime);
-
     // set up struct nodes variables
     nodes.number = hila::number_of_nodes();
     setup_node_divisors();
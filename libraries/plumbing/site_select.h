@@ -15,6 +15,10 @@
 /// SiteSelect s;
 /// SiteValueSelect<T> sv;
 ///
+/// After the loop the selected sites are collected to rank 0 in rank order, at most
+/// max_size(n) sites (default: lattice volume), the rest are counted in overflow().
+/// With s.distributed() the sites stay on their own ranks instead.
+///
 /// To be used within site loops as
 ///   onsites(ALL ) {
 ///       if ( condition1 )
@@ -46,6 +50,10 @@ class SiteSelect {
     size_t previous_site = SIZE_MAX;
     size_t n_overflow = 0;
 
+    // in distributed mode selected sites are not collected to rank 0
+    bool distributed_mode = false;
+    size_t global_count = 0, global_offset = 0;
+
   public:
     /// Initialize to zero by default (? exception to other variables)
     /// allreduce = true by default
@@ -86,6 +94,14 @@ class SiteSelect {
         return *this;
     }
 
+    /// Keep the selected sites on the ranks which own them, for parallel processing.
+    /// size(), coordinates() etc. then refer to the local sites, global_size() gives
+    /// the total.  The nmax cap and overflow count are global as usual
+    SiteSelect &distributed() {
+        distributed_mode = true;
+        return *this;
+    }
+
     SiteSelect &max_size(size_t _max) {
         nmax = _max;
         return *this;
@@ -132,66 +148,106 @@ class SiteSelect {
         }
     }
 
-    /// For delayed collect, joining starts or completes the reduction operation
+    /// Gather the first counts[r] elements of v from all ranks to rank 0, in rank order
+    template <typename U>
+    static void gather_to_root(std::vector<U> &v, const std::vector<size_t> &counts) {
+        int nn = hila::number_of_nodes();
+        std::vector<int> icounts(nn), displs(nn);
+        size_t total = 0;
+        for (int r = 0; r < nn; r++) {
+            icounts[r] = counts[r];
+            displs[r] = total;
+            total += counts[r];
+        }
+        assert(total < (1ULL << 31) && "Too many selected sites to gather");
+
+        MPI_Datatype dtype;
+        MPI_Type_contiguous(sizeof(U), MPI_BYTE, &dtype);
+        MPI_Type_commit(&dtype);
+
+        if (hila::myrank() == 0) {
+            // rank 0 data is already in place at the start
+            v.resize(total);
+            MPI_Gatherv(MPI_IN_PLACE, icounts[0], dtype, v.data(), icounts.data(),
+                        displs.data(), dtype, 0, lattice->mpi_comm_lat);
+        } else {
+            MPI_Gatherv(v.data(), icounts[hila::myrank()], dtype, nullptr, nullptr, nullptr,
+                        dtype, 0, lattice->mpi_comm_lat);
+        }
+        MPI_Type_free(&dtype);
+    }
+
+    /// For delayed collect, joining starts or completes the reduction operation.
+    /// Counts and overflows are exchanged with one allgather, after which every rank knows
+    /// how many of its sites fit under the nmax cap (sites are taken in rank order).
+    /// Then the sites (and values) are collected to rank 0 with MPI_Gatherv, or, in
+    /// distributed mode, left on the ranks.
     template <typename T>
     void join_data_vectors(std::vector<T> &dp) {
-        if (hila::myrank() == 0) {
-            for (int n = 1; n < hila::number_of_nodes(); n++) {
-                size_t nsend = nmax - sites.size();
-                hila::send_to(n, nsend);
-
-                if (nsend > 0) {
-                    std::vector<SiteIndex> s;
-                    hila::receive_from(n, s);
-
-                    // last element of s contains the overflow number
-                    n_overflow += s.back().value;
-                    s.pop_back();
-
-                    sites.reserve(sites.size() + s.size());
-                    sites.insert(sites.end(), s.begin(), s.end());
-
-                    if constexpr (!std::is_same<T, std::nullptr_t>::value) {
-                        std::vector<T> recvdata;
-                        hila::receive_from(n, recvdata);
-                        dp.reserve(sites.size());
-                        dp.insert(dp.end(), recvdata.begin(), recvdata.end());
-                    }
-                } else {
-                    // get the overflow number in any case
-                    size_t over;
-                    hila::receive_from(n, over);
-                    n_overflow += over;
-                }
-            }
 
-        } else {
-            // now rank /= 0
-            // wait for the number to be sent
-            size_t nsend;
-            hila::receive_from(0, nsend);
-            if (nsend > 0) {
-                if (nsend < sites.size()) {
-                    n_overflow += sites.size() - nsend;
-                    sites.resize(nsend);
-                }
+        int nn = hila::number_of_nodes();
+        if (nn == 1 || hila::check_input) {
+            global_count = sites.size();
+            return;
+        }
+
+        int myrank = hila::myrank();
+
+        static hila::timer join_timer("SiteSelect join");
+        join_timer.start();
+
+        // local count and overflow of all ranks
+        uint64_t mycount[2] = {sites.size(), n_overflow};
+        std::vector<uint64_t> allcount(2 * nn);
+        MPI_Allgather(mycount, 2, MPI_UINT64_T, allcount.data(), 2, MPI_UINT64_T,
+                      lattice->mpi_comm_lat);
 
-                // append overflow info
-                sites.push_back(n_overflow);
-                hila::send_to(0, sites);
+        // number of sites taken from each rank
+        std::vector<size_t> take(nn);
+        size_t total = 0;
+        n_overflow = 0;
+        for (int r = 0; r < nn; r++) {
+            size_t c = allcount[2 * r];
+            take[r] = (total < nmax) ? std::min(c, nmax - total) : 0;
+            if (r == myrank)
+                global_offset = total;
+            total += take[r];
+            n_overflow += allcount[2 * r + 1] + c - take[r];
+        }
+        global_count = total;
+
+        sites.resize(take[myrank]);
+        if constexpr (!std::is_same<T, std::nullptr_t>::value) {
+            dp.resize(take[myrank]);
+        }
 
+        if (!distributed_mode) {
+            gather_to_root(sites, take);
+            if constexpr (!std::is_same<T, std::nullptr_t>::value) {
+                gather_to_root(dp, take);
+            }
+
+            if (myrank != 0) {
+                // empty data to release space
+                clear();
                 if constexpr (!std::is_same<T, std::nullptr_t>::value) {
-                    dp.resize(sites.size() - 1);
-                    hila::send_to(0, dp);
+                    dp.clear();
                 }
-
-            } else {
-                // send overflow
-                hila::send_to(0, sites.size() + n_overflow);
             }
-            // empty data to release space
-            clear();
         }
+
+        join_timer.stop();
+    }
+
+    /// total number of selected sites over all ranks (after the nmax cap)
+    size_t global_size() const {
+        return global_count;
+    }
+
+    /// In distributed mode, the position of the first site on this rank
+    /// in the rank-ordered global list
+    size_t global_offset_of_rank() const {
+        return global_offset;
     }
 
     size_t overflow() {
@@ -6,6 +6,45 @@
 
 extern hila::timer binning_timer;
 
+//////////////////////////////////////////////////////////////////////////////////
+/// Forward FFT of input to all directions, binning the square norm of the result:
+///   returns s, where s[b] = sum_{k: bin_index[k] == b} |f(k)|^2,  b = 0 .. n_bins-1
+/// Sites with bin_index < 0 are not included.  The binning is done while the
+/// transformed data is copied out of the pencil buffers, so no result field is
+/// needed.  Result is valid on rank 0 only.
+/// Used by k_binning::spectraldensity()
+//////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+std::vector<double> FFT_field_squarenorm_binned(const Field<T> &input,
+                                                const Field<int> &bin_index, int n_bins) {
+
+    static_assert(hila::contains_complex<T>::value,
+                  "FFT_field_squarenorm_binned argument field must contain complex type");
+
+    using cmplx_t = Complex<hila::arithmetic_type<T>>;
+    constexpr size_t elements = sizeof(T) / sizeof(cmplx_t);
+
+    extern hila::timer fft_timer;
+    fft_timer.start();
+
+    hila_fft<cmplx_t> fft(elements, fft_direction::forward);
+
+    CoordinateVector dirs;
+    dirs.fill(true);
+    fft.transform_to_buffer(input, dirs);
+
+    ReductionVector<double> s(n_bins);
+    s.allreduce(false);
+    s = 0;
+    fft.bin_squarenorm(bin_index, s);
+
+    fft_timer.stop();
+
+    return s.vector();
+}
+
+
 /// sd_k_bin_parameters holds the parameters to define binning.
 
 struct sd_k_bin_parameters {
@@ -65,6 +104,9 @@ namespace hila {
 ///   std::vector<double> spectraldensity(const Field<T> &f)
 ///                            FFT real-space field f and bin the result in squarenorm
 ///
+///   const Field<int> & bin_index()   bin of each k-space site (-1 if outside the bins).
+///                            Computed once and cached until the binning is changed
+///
 ///   double k(int b)                  return the average k within bin b
 ///   long count(int b)                return the number of points within bin b
 ///   double bin_min(int b)            return the minimum k of bin b
@@ -75,6 +117,10 @@ class k_binning {
     std::vector<double> k_avg;
     std::vector<size_t> bin_count;
 
+    // cached bin of each site, valid if index_lattice is the current lattice
+    Field<int> k_bin_index;
+    const lattice_struct *index_lattice = nullptr;
+
   public:
     k_binning() {
         par.max = M_PI;
@@ -104,6 +150,7 @@ class k_binning {
         par.bins = n;
         par.bins_set = true;
         par.binwidth = par.max / par.bins;
+        index_lattice = nullptr;
         return *this;
     }
 
@@ -119,6 +166,7 @@ class k_binning {
             par.bins = ceil(par.max / par.binwidth);
             par.max = par.binwidth * par.bins;
         }
+        index_lattice = nullptr;
         return *this;
     }
 
@@ -132,6 +180,7 @@ class k_binning {
         par.bins = ceil(par.max / w);
         par.max = par.binwidth * par.bins;
         par.bins_set = false;
+        index_lattice = nullptr;
         return *this;
     }
 
@@ -143,6 +192,7 @@ class k_binning {
     k_binning &power(double p) {
         assert(p > 0);
         par.power = p;
+        index_lattice = nullptr;
         return *this;
     }
 
@@ -166,10 +216,9 @@ class k_binning {
     template <typename T>
     std::vector<T> bin_k_field(const Field<T> &f) {
 
-        binning_timer.start();
+        const Field<int> &bi = bin_index();
 
-        if (k_avg.size() != par.bins)
-            sd_calculate_bin_info();
+        binning_timer.start();
 
         ReductionVector<T> s(par.bins);
         s.allreduce(false);
@@ -177,8 +226,8 @@ class k_binning {
 
         onsites(ALL) {
 
-            int b = sd_get_k_bin(X.coordinates(), par);
-            if (b >= 0 && b < par.bins) {
+            int b = bi[X];
+            if (b >= 0) {
                 s[b] += f[X];
             }
         }
@@ -196,10 +245,9 @@ class k_binning {
         using float_t = hila::arithmetic_type<T>;
         constexpr int n_float = sizeof(T) / sizeof(float_t);
 
-        binning_timer.start();
+        const Field<int> &bi = bin_index();
 
-        if (k_avg.size() != par.bins)
-            sd_calculate_bin_info();
+        binning_timer.start();
 
         ReductionVector<double> s(par.bins);
         s.allreduce(false);
@@ -207,8 +255,8 @@ class k_binning {
 
         onsites(ALL) {
 
-            int b = sd_get_k_bin(X.coordinates(), par);
-            if (b >= 0 && b < par.bins) {
+            int b = bi[X];
+            if (b >= 0) {
                 double ps = 0;
                 for (int i = 0; i < n_float; i++) {
                     auto a = hila::get_number_in_var(f[X], i);
@@ -226,15 +274,15 @@ class k_binning {
 
     //////////////////////////////////////////////////////////////////////////////////
     /// Spectral density
-    /// This version takes in complex field
+    /// This version takes in complex field.  The square norm is binned directly from
+    /// the FFT buffers, see FFT_field_squarenorm_binned()
 
     template <typename T, std::enable_if_t<hila::contains_complex<T>::value, int> = 0>
     std::vector<double> spectraldensity(const Field<T> &f) {
 
-        Field<T> ftrans;
-        FFT_field(f, ftrans);
+        const Field<int> &bi = bin_index();
 
-        return bin_k_field_squarenorm(ftrans);
+        return FFT_field_squarenorm_binned(f, bi, par.bins);
     }
 
     //////////////////////////////////////////////////////////////////////////////////
@@ -272,10 +320,16 @@ class k_binning {
     }
 
 
-    /// Data structure to hold the binning info - two vectors,
-    /// holding average k value in a bin and count of lattice points
+    /// Bin index of each site, and the binning info - two vectors,
+    /// holding average k value in a bin and count of lattice points.
+    /// Recomputed only if the binning parameters or the lattice change
+
+    const Field<int> &bin_index() {
 
-    void sd_calculate_bin_info() {
+        if (index_lattice == lattice.ptr() && k_avg.size() == par.bins)
+            return k_bin_index;
+
+        binning_timer.start();
 
         k_avg.resize(par.bins);
         bin_count.resize(par.bins);
@@ -285,6 +339,12 @@ class k_binning {
         s = 0;
         count = 0;
 
+        // field of a previous lattice cannot be reused
+        if (index_lattice != lattice.ptr())
+            k_bin_index.clear();
+
+        Field<int> &bi = k_bin_index;
+
         onsites(ALL) {
 
             double kr = X.coordinates().convert_to_k().norm();
@@ -293,6 +353,9 @@ class k_binning {
             if (b >= 0 && b < par.bins) {
                 s[b] += kr;
                 count[b] += 1;
+                bi[X] = b;
+            } else {
+                bi[X] = -1;
             }
         }
 
@@ -300,15 +363,19 @@ class k_binning {
             bin_count[i] = count[i];
             k_avg[i] = s[i] / count[i];
         }
+
+        index_lattice = lattice.ptr();
+
+        binning_timer.stop();
+
+        return k_bin_index;
     }
 
     /// Get the average k-value of bin i
 
     double k(int i) {
 
-        if (k_avg.size() == 0) {
-            sd_calculate_bin_info();
-        }
+        bin_index();
 
         if (i >= 0 && i < par.bins)
             return k_avg[i];
@@ -320,9 +387,7 @@ class k_binning {
 
     long count(int i) {
 
-        if (bin_count.size() == 0) {
-            sd_calculate_bin_info();
-        }
+        bin_index();
 
         if (i >= 0 && i < par.bins)
             return bin_count[i];
@@ -14,6 +14,7 @@
 // these includes need to be outside namespace hila
 #include <csignal>
 #include <cstring>
+#include <algorithm>
 
 namespace hila {
 
@@ -74,6 +75,12 @@ double timer::start() {
     gpuStreamSynchronize(0);
 #endif
 
+    if (hila::trace_on) {
+        if (trace_id < 0)
+            trace_id = hila::trace_register(label);
+        hila::trace_record(trace_id, 'B');
+    }
+
     t_start = hila::gettime();
     return t_start;
 }
@@ -90,6 +97,10 @@ double timer::stop() {
     double e = hila::gettime();
     t_total += (e - t_start);
     count++;
+
+    if (hila::trace_on && trace_id >= 0)
+        hila::trace_record(trace_id, 'E');
+
     return e;
 }
 
@@ -157,6 +168,295 @@ void report_timers() {
             hila::out << "No timers defined\n";
         }
     }
+
+    if (!hila::check_input && hila::is_comm_initialized() && hila::number_of_nodes() > 1)
+        report_timer_balance();
+}
+
+/////////////////////////////////////////////////////////////////
+/// Cross-rank timer statistics.  report_timer_balance() collects all timers
+/// (matched by label) from all ranks and prints min/mean/max and the rank of the
+/// max, flagging timers where (max - mean)/mean exceeds the imbalance threshold.
+/// The combined MPI wait time (gather waits + reduction waits) is reported as
+/// an extra entry.  Optionally the per-rank values are written to a csv-file.
+///
+/// Threshold and csv-file are set with command line flags
+///    -timer-imbalance <fraction>  (default 0.1)
+///    -timer-csv <filename>
+/// or with the functions below.  Must be called by all ranks.
+/////////////////////////////////////////////////////////////////
+
+static double timer_imbalance_threshold = 0.1;
+static std::string timer_csv_filename;
+
+void set_timer_imbalance_threshold(double fraction) {
+    timer_imbalance_threshold = fraction;
+}
+
+void set_timer_csv_file(const std::string &filename) {
+    timer_csv_filename = filename;
+}
+
+void report_timer_balance() {
+
+    MPI_Comm comm = lattice->mpi_comm_lat;
+    int nodes = hila::number_of_nodes();
+    int myrank = hila::myrank();
+
+    // first collect the union of timer labels, in the order of rank 0 timers
+    std::string mylabels;
+    for (auto tp : timer_list) {
+        if (tp->count > 0 && !tp->is_error)
+            mylabels += tp->label + '\n';
+    }
+
+    int mysize = mylabels.size();
+    std::vector<int> sizes(nodes), displs(nodes);
+    MPI_Gather(&mysize, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, comm);
+
+    std::string all_labels;
+    if (myrank == 0) {
+        int total = 0;
+        for (int i = 0; i < nodes; i++) {
+            displs[i] = total;
+            total += sizes[i];
+        }
+        all_labels.resize(total);
+    }
+    MPI_Gatherv(mylabels.data(), mysize, MPI_CHAR, all_labels.data(), sizes.data(),
+                displs.data(), MPI_CHAR, 0, comm);
+
+    std::vector<std::string> labels;
+    if (myrank == 0) {
+        size_t pos = 0, next;
+        while ((next = all_labels.find('\n', pos)) != std::string::npos) {
+            std::string l = all_labels.substr(pos, next - pos);
+            if (std::find(labels.begin(), labels.end(), l) == labels.end())
+                labels.push_back(l);
+            pos = next + 1;
+        }
+    }
+    hila::broadcast(labels);
+
+    // values of this rank, last entry is the total MPI wait time
+    int n = labels.size() + 1;
+    std::vector<double> times(n, 0.0), counts(n, 0.0);
+    for (auto tp : timer_list) {
+        if (tp->count > 0 && !tp->is_error) {
+            auto it = std::find(labels.begin(), labels.end(), tp->label);
+            times[it - labels.begin()] += tp->t_total;
+            counts[it - labels.begin()] += tp->count;
+        }
+    }
+    times[n - 1] = gather_wait_time() + reduction_wait_timer.value().time;
+    counts[n - 1] = wait_receive_timer.value().count + reduction_wait_timer.value().count;
+    labels.push_back("MPI wait (total)");
+
+    struct double_int {
+        double val;
+        int rank;
+    };
+    std::vector<double_int> mymax(n), maxloc(n);
+    for (int i = 0; i < n; i++) {
+        mymax[i].val = times[i];
+        mymax[i].rank = myrank;
+    }
+
+    std::vector<double> tmin(n), tsum(n);
+    MPI_Reduce(times.data(), tmin.data(), n, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(times.data(), tsum.data(), n, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(mymax.data(), maxloc.data(), n, MPI_DOUBLE_INT, MPI_MAXLOC, 0, comm);
+
+    if (myrank == 0) {
+        char line[202];
+        double ttime = gettime();
+
+        hila::out << "TIMER BALANCE over " << nodes
+                  << " ranks (imbalance = max/mean - 1, flagged if > " << timer_imbalance_threshold
+                  << "):\n";
+        hila::out << "                        min(sec)      mean(sec)       max(sec)  max rank  "
+                     "imbalance\n";
+        hila::out << "------------------------------------------------------------"
+                     "------------------------\n";
+        for (int i = 0; i < n; i++) {
+            double mean = tsum[i] / nodes;
+            double imbalance = (mean > 0) ? maxloc[i].val / mean - 1.0 : 0.0;
+            // flag only timers which are a noticeable fraction of the run time
+            bool flag = imbalance > timer_imbalance_threshold && maxloc[i].val > 0.01 * ttime;
+            std::snprintf(line, 200, "%-20s: %14.5f %14.5f %14.5f %9d %10.4f%s\n",
+                          labels[i].c_str(), tmin[i], mean, maxloc[i].val, maxloc[i].rank,
+                          imbalance, flag ? "  <-- IMBALANCE" : "");
+            hila::out << line;
+        }
+        hila::out << "------------------------------------------------------------"
+                     "------------------------\n";
+    }
+
+    // per-rank dump for post-mortem analysis
+    int do_csv = timer_csv_filename.size() > 0;
+    hila::broadcast(do_csv);
+    if (do_csv) {
+        std::vector<double> all_times, all_counts;
+        if (myrank == 0) {
+            all_times.resize((size_t)n * nodes);
+            all_counts.resize((size_t)n * nodes);
+        }
+        MPI_Gather(times.data(), n, MPI_DOUBLE, all_times.data(), n, MPI_DOUBLE, 0, comm);
+        MPI_Gather(counts.data(), n, MPI_DOUBLE, all_counts.data(), n, MPI_DOUBLE, 0, comm);
+
+        if (myrank == 0) {
+            std::ofstream csv(timer_csv_filename);
+            if (csv.fail()) {
+                hila::out << "Cannot open timer csv file " << timer_csv_filename << '\n';
+            } else {
+                csv << "rank,timer,total_sec,calls\n";
+                csv << std::setprecision(8);
+                for (int r = 0; r < nodes; r++)
+                    for (int i = 0; i < n; i++)
+                        csv << r << ",\"" << labels[i] << "\"," << all_times[r * n + i] << ','
+                            << (int64_t)all_counts[r * n + i] << '\n';
+                hila::out << "Per-rank timer values written to " << timer_csv_filename << '\n';
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+/// Loop profiling probes, inserted by hilapp -loop-profile
+/////////////////////////////////////////////////////////////////
+
+// store all probes in use
+static std::vector<loop_profile *> loop_profile_list = {};
+
+void loop_profile::remove() {
+    for (auto it = loop_profile_list.begin(); it != loop_profile_list.end(); ++it) {
+        if (*it == this) {
+            loop_profile_list.erase(it);
+            return;
+        }
+    }
+}
+
+double gather_wait_time() {
+    return wait_receive_timer.value().time + wait_send_timer.value().time;
+}
+
+void loop_profile::start() {
+    // store on 1st use, see timer::start()
+    if (!is_listed) {
+        loop_profile_list.push_back(this);
+        is_listed = true;
+    }
+
+#ifdef GPU_SYNCHRONIZE_TIMERS
+    gpuStreamSynchronize(0);
+#endif
+
+    if (hila::trace_on) {
+        if (trace_id < 0) {
+            std::string fname = file;
+            trace_id = hila::trace_register(fname.substr(fname.find_last_of('/') + 1) + ':' +
+                                            std::to_string(line));
+        }
+        hila::trace_record(trace_id, 'B');
+    }
+
+    t_wait_start = gather_wait_time();
+    t_start = hila::gettime();
+}
+
+void loop_profile::stop(size_t sites, size_t read_bytes_per_site, size_t write_bytes_per_site) {
+
+#ifdef GPU_SYNCHRONIZE_TIMERS
+    gpuStreamSynchronize(0);
+#endif
+
+    t_total += hila::gettime() - t_start;
+    t_wait += gather_wait_time() - t_wait_start;
+    bytes_read += (double)sites * read_bytes_per_site;
+    bytes_written += (double)sites * write_bytes_per_site;
+    count++;
+
+    if (hila::trace_on && trace_id >= 0)
+        hila::trace_record(trace_id, 'E');
+}
+
+// report helpers, in anonymous namespace to keep hila::swap out of std::sort
+namespace {
+struct profile_loop_entry {
+    std::string location;
+    double time, wait, bytes;
+    int64_t count;
+};
+struct profile_function_entry {
+    std::string name;
+    double time;
+    std::vector<profile_loop_entry> loops;
+};
+} // namespace
+
+void report_loop_profiles() {
+    if (hila::myrank() != 0 || loop_profile_list.size() == 0)
+        return;
+
+    // merge probes of the same loop (template instantiations) and group by function
+    std::vector<profile_function_entry> functions;
+
+    for (auto lp : loop_profile_list) {
+        if (lp->count == 0)
+            continue;
+
+        std::string fname = lp->file;
+        auto slash = fname.find_last_of('/');
+        if (slash != std::string::npos)
+            fname = fname.substr(slash + 1);
+        std::string location = fname + ':' + std::to_string(lp->line);
+
+        auto fit = std::find_if(functions.begin(), functions.end(),
+                                [&](const profile_function_entry &f) { return f.name == lp->function; });
+        if (fit == functions.end()) {
+            functions.push_back({lp->function, 0.0, {}});
+            fit = functions.end() - 1;
+        }
+        fit->time += lp->t_total;
+
+        auto lit = std::find_if(fit->loops.begin(), fit->loops.end(),
+                                [&](const profile_loop_entry &l) { return l.location == location; });
+        if (lit == fit->loops.end()) {
+            fit->loops.push_back({location, 0.0, 0.0, 0.0, 0});
+            lit = fit->loops.end() - 1;
+        }
+        lit->time += lp->t_total;
+        lit->wait += lp->t_wait;
+        lit->bytes += lp->bytes_read + lp->bytes_written;
+        lit->count += lp->count;
+    }
+
+    std::sort(functions.begin(), functions.end(),
+              [](const profile_function_entry &a, const profile_function_entry &b) { return a.time > b.time; });
+
+    char line[202];
+    hila::out << "LOOP PROFILE (node 0):      calls       total(s)     time/call   comm wait(s)"
+                 "      GB/s\n";
+    hila::out << "------------------------------------------------------------"
+                 "------------------------------\n";
+    for (auto &f : functions) {
+        std::snprintf(line, 200, "%-28s %16.5f\n", f.name.c_str(), f.time);
+        hila::out << line;
+
+        std::sort(f.loops.begin(), f.loops.end(),
+                  [](const profile_loop_entry &a, const profile_loop_entry &b) { return a.time > b.time; });
+        for (auto &l : f.loops) {
+            double bw = (l.time > 0) ? 1e-9 * l.bytes / l.time : 0.0;
+            std::snprintf(line, 200, "  %-24s %8ld %14.5f %10.3f us %14.5f %9.3f\n",
+                          l.location.c_str(), (long)l.count, l.time, 1e6 * l.time / l.count,
+                          l.wait, bw);
+            hila::out << line;
+        }
+    }
+    hila::out << "------------------------------------------------------------"
+                 "------------------------------\n";
+    hila::out << "GB/s is field bytes read + written by the loop on node 0 / loop time\n";
 }
 
 /////////////////////////////////////////////////////////////////
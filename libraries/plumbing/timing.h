@@ -2,6 +2,7 @@
 #define TIMING_H
 
 #include "plumbing/defs.h"
+#include "plumbing/trace.h"
 
 namespace hila {
 
@@ -25,7 +26,9 @@ struct timer_value {
 ///         loop_timer.stop();
 ///
 /// All timer values are automatically reported on program exit (hila::finishrun calls
-/// report_timers())
+/// report_timers()).  With more than one MPI rank report_timers() prints also the
+/// min/mean/max of each timer over ranks, flagging load imbalance (command line flags
+/// -timer-imbalance <fraction> and -timer-csv <filename>, see timing.cpp)
 ///
 /// Timer can be reset with
 ///       loop_timer.reset();
@@ -60,6 +63,7 @@ class timer {
     int64_t count; // need more than 32 bits
     std::string label;
     bool is_on, is_error;
+    int trace_id = -1; // event id if tracing is on
 
   public:
     // initialize timer to this timepoint
@@ -83,10 +87,68 @@ class timer {
     void report(bool print_not_timed = false);
 
     timer_value value();
+
+    friend void report_timer_balance();
 };
 
 void report_timers();
 
+// cross-rank statistics of timers, called from report_timers()
+void report_timer_balance();
+void set_timer_imbalance_threshold(double fraction);
+void set_timer_csv_file(const std::string &filename);
+
+
+////////////////////////////////////////////////////////////////
+///
+/// loop_profile is a per-site-loop probe.  These are not meant to be used by hand:
+/// hilapp inserts one static probe around each onsites()-loop when given the
+/// option -loop-profile (make LOOP_PROFILE=1).  Probe records the number of calls,
+/// wall time, bytes moved by field reads and writes (site count times element size,
+/// neighbour reads counted separately) and the time spent in MPI waits of
+/// the gathers during the loop.
+///
+/// Probes are reported at hila::finishrun() (report_loop_profiles()), grouped by the
+/// function where the loop is.  Probes from different template instantiations of the
+/// same loop are merged.
+///
+////////////////////////////////////////////////////////////////
+
+class loop_profile {
+  private:
+    const char *file, *function;
+    int line;
+    double t_start, t_total, t_wait_start, t_wait;
+    double bytes_read, bytes_written;
+    int64_t count;
+    bool is_listed;
+    int trace_id = -1;
+
+  public:
+    loop_profile(const char *file_, int line_, const char *func_)
+        : file(file_), function(func_), line(line_) {
+        t_start = t_total = t_wait_start = t_wait = 0.0;
+        bytes_read = bytes_written = 0.0;
+        count = 0;
+        is_listed = false;
+    }
+
+    ~loop_profile() {
+        remove();
+    }
+
+    void remove();
+    void start();
+    void stop(size_t sites, size_t read_bytes_per_site, size_t write_bytes_per_site);
+
+    friend void report_loop_profiles();
+};
+
+void report_loop_profiles();
+
+/// Total time spent in MPI waits of field gathers (wait_gather) on this rank
+double gather_wait_time();
+
 //////////////////////////////////////////////////////////////////
 // Prototypes
 //////////////////////////////////////////////////////////////////
@@ -0,0 +1,166 @@
+#include <atomic>
+#include <mutex>
+
+#include "plumbing/defs.h"
+#include "plumbing/com_mpi.h"
+#include "plumbing/trace.h"
+
+//////////////////////////////////////////////////////////////////
+// Event tracing to Chrome Trace JSON -format.  See trace.h for details
+//////////////////////////////////////////////////////////////////
+
+namespace hila {
+
+bool trace_on = false;
+
+struct trace_event {
+    double time;
+    int id;
+    char phase;
+};
+
+// ring buffer of events and the running event counter
+static std::vector<trace_event> trace_buffer;
+static std::atomic<uint64_t> trace_head(0);
+
+// event names, id is the index to this list
+static std::vector<std::string> trace_names;
+static std::mutex trace_names_mutex;
+
+static std::string trace_filename;
+static double trace_start_time = 0.0;
+
+int trace_register(const std::string &name) {
+    std::lock_guard<std::mutex> lock(trace_names_mutex);
+    for (int i = 0; i < trace_names.size(); i++) {
+        if (trace_names[i] == name)
+            return i;
+    }
+    trace_names.push_back(name);
+    return trace_names.size() - 1;
+}
+
+void trace_record(int id, char phase) {
+    // reserve the slot atomically, so that this is safe also from threads
+    uint64_t i = trace_head.fetch_add(1, std::memory_order_relaxed);
+    trace_event &e = trace_buffer[i % trace_buffer.size()];
+    e.time = hila::gettime();
+    e.id = id;
+    e.phase = phase;
+}
+
+void setup_trace(const std::string &filename, size_t max_events) {
+    if (hila::check_input || max_events == 0)
+        return;
+
+    // check that the file can be written before recording anything
+    bool ok = true;
+    if (hila::myrank() == 0) {
+        std::ofstream out(filename, std::ios::out | std::ios::trunc);
+        ok = !out.fail();
+    }
+    hila::broadcast(ok);
+    if (!ok) {
+        hila::out0 << "Cannot open trace file '" << filename << "', tracing is off\n";
+        return;
+    }
+
+    trace_filename = filename;
+    trace_buffer.resize(max_events);
+    trace_head = 0;
+
+    // common time origin for all ranks, up to barrier latency
+    hila::barrier();
+    trace_start_time = hila::gettime();
+    trace_on = true;
+
+    hila::out0 << "Tracing events to file '" << filename << "', max " << max_events
+               << " events per rank\n";
+}
+
+static std::string json_escape(const std::string &s) {
+    std::string r;
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            r += '\\';
+        r += c;
+    }
+    return r;
+}
+
+void write_trace() {
+    if (!trace_on)
+        return;
+
+    // stop recording, so that the MPI calls below do not add events
+    trace_on = false;
+
+    int rank = hila::myrank();
+    uint64_t head = trace_head;
+    uint64_t n = std::min<uint64_t>(head, trace_buffer.size());
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+       << ",\"args\":{\"name\":\"rank " << rank << "\"}}";
+
+    // begin events may have been overwritten in the ring, skip unmatched ends
+    std::vector<int> depth(trace_names.size(), 0);
+    for (uint64_t i = head - n; i < head; i++) {
+        const trace_event &e = trace_buffer[i % trace_buffer.size()];
+        if (e.phase == 'E') {
+            if (depth[e.id] == 0)
+                continue;
+            depth[e.id]--;
+        } else if (e.phase == 'B') {
+            depth[e.id]++;
+        }
+        ss << ",\n{\"name\":\"" << json_escape(trace_names[e.id]) << "\",\"cat\":\"hila\",\"ph\":\""
+           << e.phase << "\",\"ts\":" << 1e6 * (e.time - trace_start_time) << ",\"pid\":" << rank
+           << ",\"tid\":0";
+        if (e.phase == 'i')
+            ss << ",\"s\":\"t\"";
+        ss << '}';
+    }
+
+    std::string s = ss.str();
+    std::vector<char> block(s.begin(), s.end());
+
+    // collect the ranks one at a time to rank 0, which writes the file
+    std::ofstream out;
+    bool ok = true;
+    if (rank == 0) {
+        out.open(trace_filename, std::ios::out | std::ios::trunc);
+        ok = !out.fail();
+    }
+    hila::broadcast(ok);
+    if (!ok) {
+        hila::out0 << "Cannot open trace file '" << trace_filename << "', trace not written\n";
+        trace_buffer.clear();
+        return;
+    }
+
+    if (rank == 0) {
+        out << "{\"traceEvents\":[\n";
+        out.write(block.data(), block.size());
+        for (int r = 1; r < hila::number_of_nodes(); r++) {
+            hila::receive_from(r, block);
+            out << ",\n";
+            out.write(block.data(), block.size());
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        out.close();
+
+        hila::out0 << "Trace written to '" << trace_filename << "'";
+        if (head > trace_buffer.size())
+            hila::out0 << " (ring buffer overflow on rank 0, " << head - trace_buffer.size()
+                       << " oldest events lost)";
+        hila::out0 << '\n';
+    } else {
+        hila::send_to(0, block);
+    }
+
+    trace_buffer.clear();
+}
+
+} // namespace hila
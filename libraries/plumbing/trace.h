@@ -0,0 +1,87 @@
+#ifndef HILA_TRACE_H_
+#define HILA_TRACE_H_
+
+#include <string>
+#include <cstdint>
+
+namespace hila {
+
+// clang-format off
+////////////////////////////////////////////////////////////////
+///
+/// Event tracing: timestamped begin/end events are recorded per rank into a
+/// lock-free ring buffer, and written out in Chrome Trace JSON format
+/// (chrome://tracing, https://ui.perfetto.dev) at hila::finishrun().
+/// Each MPI rank is shown as a separate process.
+///
+/// Tracing is off by default.  It is turned on with the command line flag
+///
+///       -trace <filename> [<max events per rank>]
+///
+/// or calling hila::setup_trace(filename, max_events) after hila::initialize().
+/// If the ring buffer fills up, the oldest events are overwritten.
+///
+/// Recorded automatically are all hila::timer start/stop intervals (this includes
+/// MPI send/receive/wait, reductions, broadcasts and FFT phases), field gathers
+/// (start_gather / wait_gather), Field and gauge config I/O and, if the program
+/// is compiled with hilapp -loop-profile (make LOOP_PROFILE=1), all site loops.
+///
+/// User events can be added with
+///
+///       static int my_id = hila::trace_register("my event");
+///       hila::trace_begin(my_id);
+///          < traced section >
+///       hila::trace_end(my_id);
+///
+/// or with a scope guard  hila::trace_scope ts(my_id);
+///
+////////////////////////////////////////////////////////////////
+// clang-format on
+
+/// is tracing on - check this before calling trace_record()
+extern bool trace_on;
+
+/// get event id for the name, registering the name if not yet known
+int trace_register(const std::string &name);
+
+/// record event with phase 'B' (begin), 'E' (end) or 'i' (instant)
+void trace_record(int id, char phase);
+
+inline void trace_begin(int id) {
+    if (trace_on)
+        trace_record(id, 'B');
+}
+
+inline void trace_end(int id) {
+    if (trace_on)
+        trace_record(id, 'E');
+}
+
+inline void trace_instant(int id) {
+    if (trace_on)
+        trace_record(id, 'i');
+}
+
+/// begin/end event for the lifetime of the object
+class trace_scope {
+  private:
+    int id;
+
+  public:
+    trace_scope(int i) : id(i) {
+        trace_begin(id);
+    }
+    ~trace_scope() {
+        trace_end(id);
+    }
+};
+
+/// turn tracing on, all ranks must call this
+void setup_trace(const std::string &filename, size_t max_events = 1 << 20);
+
+/// write the trace file and turn tracing off, called from hila::finishrun()
+void write_trace();
+
+} // namespace hila
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file cluster_update.h
+ * @brief Swendsen-Wang and Wolff cluster updates for Ising, XY and O(N) spin models
+ *
+ */
+#ifndef CLUSTER_UPDATE_H
+#define CLUSTER_UPDATE_H
+
+#include "hila.h"
+#include "clusters.h"
+
+/// Cluster updates are done with embedded Ising variables sigma_x:  the spin itself for
+/// Ising models, and for O(N) models the projection  sigma_x = s_x . r  to a random
+/// unit vector r.  Action is
+///      S = -beta sum_<xy> s_x s_y      (Ising:  s_x = +-1,  XY: s_x . s_y = cos(t_x - t_y))
+///
+/// The update has 3 phases, timed separately:
+///   1. bonds:  link xy is activated with probability 1 - exp(-2 beta sigma_x sigma_y)
+///              if sigma_x sigma_y > 0
+///   2. labels: clusters connected by active bonds are labelled with hila::clusters
+///   3. flip:   Swendsen-Wang: every cluster is flipped with probability 1/2, decided by a
+///              hash of the cluster label, so that no communication is needed.
+///              Wolff: only the cluster containing a random site is flipped.
+///              Flip of embedded Ising variable is the reflection  s -> s - 2 (s.r) r.
+///
+/// Usage:
+///      Field<double> spin;   // +-1
+///      hila::cluster_update(spin, beta, hila::cluster_algorithm::swendsen_wang);
+///      Field<double> angle;  // XY model angles
+///      hila::cluster_update_xy(angle, beta, hila::cluster_algorithm::wolff);
+///      Field<Vector<3,double>> s;   // O(3) unit vectors
+///      hila::cluster_update(s, beta, hila::cluster_algorithm::swendsen_wang);
+///
+/// All return the number of flipped sites.
+
+namespace hila {
+
+enum class cluster_algorithm { swendsen_wang, wolff };
+
+/// splitmix64 hash, used to give random flips to clusters
+inline uint64_t cluster_hash(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/// @brief Find the sites to flip in embedded Ising cluster update
+/// @param sigma embedded Ising variable
+/// @param beta coupling
+/// @param alg swendsen_wang or wolff
+/// @param flip on output 1 on sites to be flipped, 0 otherwise
+/// @return number of sites to flip
+inline int64_t embedded_cluster_flips(const Field<double> &sigma, double beta,
+                                      cluster_algorithm alg, Field<uint8_t> &flip) {
+
+    static hila::timer bond_timer("cluster bonds");
+    static hila::timer label_timer("cluster labels");
+    static hila::timer flip_timer("cluster flip");
+
+    bond_timer.start();
+    Field<uint8_t> bonds;
+    onsites(ALL) {
+        uint8_t b = 0;
+        foralldir(d) {
+            double ss = sigma[X] * sigma[X + d];
+            if (ss > 0 && hila::random() < 1.0 - exp(-2.0 * beta * ss))
+                b |= (1 << d);
+        }
+        bonds[X] = b;
+    }
+    bond_timer.stop();
+
+    label_timer.start();
+    Field<uint8_t> type = 0;
+    hila::clusters cl;
+    cl.make_labels(type, bonds);
+    const auto &labels = cl.get_labels();
+    label_timer.stop();
+
+    flip_timer.start();
+    int64_t nflip = 0;
+    if (alg == cluster_algorithm::swendsen_wang) {
+        // same random seed on all ranks
+        uint64_t seed = hila::broadcast((uint64_t)(hila::random() * (1ULL << 53)));
+        onsites(ALL) {
+            uint8_t f = cluster_hash(labels[X] ^ seed) & 1;
+            flip[X] = f;
+            nflip += f;
+        }
+    } else {
+        // label of a random site
+        CoordinateVector c;
+        foralldir(d) c[d] = hila::random() * lattice.size(d);
+        c = hila::broadcast(c);
+        uint64_t la = labels[c];
+        onsites(ALL) {
+            uint8_t f = (labels[X] == la);
+            flip[X] = f;
+            nflip += f;
+        }
+    }
+    flip_timer.stop();
+
+    return nflip;
+}
+
+/// Ising model, spin values +-1
+template <typename T, std::enable_if_t<hila::is_arithmetic<T>::value, int> = 0>
+int64_t cluster_update(Field<T> &spin, double beta, cluster_algorithm alg) {
+    Field<double> sigma;
+    Field<uint8_t> flip;
+    onsites(ALL) sigma[X] = spin[X];
+    int64_t n = embedded_cluster_flips(sigma, beta, alg, flip);
+    onsites(ALL) {
+        if (flip[X])
+            spin[X] = -spin[X];
+    }
+    return n;
+}
+
+/// XY model, spins given as angles
+inline int64_t cluster_update_xy(Field<double> &angle, double beta, cluster_algorithm alg) {
+    // random reflection axis r = (cos phi, sin phi)
+    double phi = hila::broadcast(2 * M_PI * hila::random());
+    Field<double> sigma;
+    Field<uint8_t> flip;
+    onsites(ALL) sigma[X] = cos(angle[X] - phi);
+    int64_t n = embedded_cluster_flips(sigma, beta, alg, flip);
+    onsites(ALL) {
+        if (flip[X]) {
+            // reflection t -> 2 phi + pi - t, back to range (-pi, pi]
+            double t = 2 * phi + M_PI - angle[X];
+            t -= 2 * M_PI * floor((t + M_PI) / (2 * M_PI));
+            angle[X] = t;
+        }
+    }
+    return n;
+}
+
+/// O(N) model, unit vector spins
+template <int N, typename T>
+int64_t cluster_update(Field<Vector<N, T>> &spin, double beta, cluster_algorithm alg) {
+    Vector<N, T> r;
+    r.gaussian_random();
+    r = hila::broadcast(r / r.norm());
+    Field<double> sigma;
+    Field<uint8_t> flip;
+    onsites(ALL) sigma[X] = spin[X].dot(r);
+    int64_t n = embedded_cluster_flips(sigma, beta, alg, flip);
+    onsites(ALL) {
+        if (flip[X])
+            spin[X] -= 2 * sigma[X] * r;
+    }
+    return n;
+}
+
+} // namespace hila
+
+#endif
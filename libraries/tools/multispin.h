@@ -0,0 +1,164 @@
+/**
+ * @file multispin.h
+ * @brief Multispin coded Ising model: 64 spin systems packed in one bit each of a word
+ *
+ */
+#ifndef MULTISPIN_H
+#define MULTISPIN_H
+
+#include "hila.h"
+
+/// Multispin coding: Field<SpinWord> holds 64 independent Ising systems (replicas),
+/// bit r of the word at site X is the spin of replica r at X, 0 = +1 and 1 = -1.
+/// All neighbour access goes through the normal halo exchange, but 1 bit per spin
+/// is moved instead of a double.  Replicas are updated simultaneously with bitwise
+/// operations:
+///   - antiparallel neighbours are counted with a bit-sliced adder
+///   - acceptance is decided with a bitwise comparison of random words against
+///     the precomputed fixed point acceptance table, one lane per replica.
+///     Most lanes are decided after a few random words.
+///
+/// Usage:
+///     hila::msc_table table(beta, hila::msc_update::metropolis);
+///     Field<SpinWord> spin;
+///     hila::msc_set_random(spin);
+///     hila::msc_sweep(spin, table);
+///     hila::msc_measure(spin, magnetisation, energy);   // per replica
+
+using SpinWord = uint64_t;
+
+namespace hila {
+
+enum class msc_update { metropolis, heatbath };
+
+/// Acceptance probabilities of a spin flip, indexed by the number of antiparallel
+/// nearest neighbours n = 0 ... 2*NDIM.  Action  S = -beta sum_<xy> s_x s_y,
+/// flip changes it by  dS = 4 beta (NDIM - n)
+struct msc_table {
+    static constexpr int nclass = 2 * NDIM + 1;
+    static constexpr int bits = 32;
+    // 32-bit fixed point acceptance, used if always[n] == 0
+    uint32_t threshold[nclass];
+    uint8_t always[nclass];
+
+    msc_table(double beta, msc_update type = msc_update::metropolis) {
+        for (int n = 0; n < nclass; n++) {
+            double dS = 4 * beta * (NDIM - n);
+            double p;
+            if (type == msc_update::metropolis)
+                p = (dS <= 0) ? 1.0 : exp(-dS);
+            else
+                p = 1.0 / (1.0 + exp(dS));
+
+            always[n] = (p >= 1.0);
+            double t = p * 4294967296.0;
+            threshold[n] = (t >= 4294967295.0) ? 0xffffffffU : (uint32_t)t;
+        }
+    }
+};
+
+/// 64 random bits
+inline SpinWord msc_random_word() {
+    SpinWord hi = (SpinWord)(hila::random() * 4294967296.0);
+    SpinWord lo = (SpinWord)(hila::random() * 4294967296.0);
+    return (hi << 32) | lo;
+}
+
+/// add 1-bit values of x to the bit-sliced counter c[]
+inline void msc_count(SpinWord x, SpinWord &c0, SpinWord &c1, SpinWord &c2, SpinWord &c3) {
+    SpinWord t = c0 & x;
+    c0 ^= x;
+    x = t;
+    t = c1 & x;
+    c1 ^= x;
+    x = t;
+    t = c2 & x;
+    c2 ^= x;
+    c3 ^= t;
+}
+
+/// Update spins of parity par, all 64 replicas at once
+inline void msc_update_parity(Field<SpinWord> &spin, Parity par, const msc_table &table) {
+
+    onsites(par) {
+        SpinWord s = spin[X];
+
+        // number of antiparallel neighbours, bit-sliced
+        SpinWord c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+        foralldir(d) {
+            msc_count(s ^ spin[X + d], c0, c1, c2, c3);
+            msc_count(s ^ spin[X - d], c0, c1, c2, c3);
+        }
+
+        // flip accepted surely, and the threshold bits of the undecided lanes
+        SpinWord flip = 0, undecided = 0;
+        SpinWord lane[msc_table::nclass];
+        for (int n = 0; n < msc_table::nclass; n++) {
+            SpinWord eq = ((n & 1) ? c0 : ~c0) & ((n & 2) ? c1 : ~c1) & ((n & 4) ? c2 : ~c2) &
+                          ((n & 8) ? c3 : ~c3);
+            lane[n] = eq;
+            if (table.always[n])
+                flip |= eq;
+            else if (table.threshold[n] > 0)
+                undecided |= eq;
+        }
+
+        // compare random u < threshold bitwise, starting from the most significant bit.
+        // Lane is decided at the first bit where u and threshold differ
+        for (int b = msc_table::bits - 1; b >= 0 && undecided != 0; b--) {
+            SpinWord tbit = 0;
+            for (int n = 0; n < msc_table::nclass; n++) {
+                if ((table.threshold[n] >> b) & 1)
+                    tbit |= lane[n];
+            }
+            SpinWord u = msc_random_word();
+            SpinWord differ = undecided & (u ^ tbit);
+            flip |= differ & tbit;
+            undecided &= ~differ;
+        }
+
+        spin[X] = s ^ flip;
+    }
+}
+
+/// Full sweep: even sites, then odd sites
+inline void msc_sweep(Field<SpinWord> &spin, const msc_table &table) {
+    msc_update_parity(spin, EVEN, table);
+    msc_update_parity(spin, ODD, table);
+}
+
+/// Independent random start for all replicas
+inline void msc_set_random(Field<SpinWord> &spin) {
+    onsites(ALL) spin[X] = msc_random_word();
+}
+
+/// Magnetisation  sum_x s_x / V  and energy  -sum_<xy> s_x s_y / V  of each replica
+inline void msc_measure(const Field<SpinWord> &spin, std::vector<double> &magnetisation,
+                        std::vector<double> &energy) {
+
+    ReductionVector<int64_t> down(64), anti(64);
+    down = 0;
+    anti = 0;
+
+    onsites(ALL) {
+        SpinWord s = spin[X];
+        SpinWord a[NDIM];
+        foralldir(d) a[d] = s ^ spin[X + d];
+        for (int r = 0; r < 64; r++) {
+            down[r] += (s >> r) & 1;
+            foralldir(d) anti[r] += (a[d] >> r) & 1;
+        }
+    }
+
+    magnetisation.resize(64);
+    energy.resize(64);
+    for (int r = 0; r < 64; r++) {
+        magnetisation[r] = 1.0 - 2.0 * down[r] / lattice.volume();
+        // NDIM*V bonds, antiparallel ones contribute +1 and parallel -1
+        energy[r] = (2.0 * anti[r] - NDIM * (double)lattice.volume()) / lattice.volume();
+    }
+}
+
+} // namespace hila
+
+#endif
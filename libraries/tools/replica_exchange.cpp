@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file replica_exchange.cpp
+/// @brief Implementation of replica exchange between partitions, see replica_exchange.h
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include "hila.h"
+#include "tools/replica_exchange.h"
+
+namespace hila {
+
+static hila::timer rex_timer("replica exchange");
+
+replica_exchange::replica_exchange(const std::vector<double> &c) : couplings(c) {
+
+    int np = couplings.size();
+    if (np != hila::partitions.number()) {
+        hila::out0 << "replica_exchange: number of couplings " << np
+                   << " must equal the number of partitions " << hila::partitions.number()
+                   << '\n';
+        hila::finishrun();
+    }
+
+    replica_at.resize(np);
+    coupling_of.resize(np);
+    for (int i = 0; i < np; i++) {
+        replica_at[i] = i;
+        coupling_of[i] = i;
+    }
+
+    n_attempt.assign(np, 0);
+    n_accept.assign(np, 0);
+    direction.assign(np, 0);
+    n_up.assign(np, 0);
+    n_down.assign(np, 0);
+    trip_start.assign(np, -1);
+    n_trips.assign(np, 0);
+    trip_time.assign(np, 0);
+
+    update_statistics();
+}
+
+int replica_exchange::coupling_index() const {
+    return coupling_of[hila::partitions.mylattice()];
+}
+
+bool replica_exchange::exchange(const std::function<double(double)> &action) {
+
+    int np = couplings.size();
+    if (np < 2)
+        return false;
+
+    rex_timer.start();
+
+    // pairs (k,k+1) with k even or odd, alternating
+    int parity = n_exchange % 2;
+    int k = coupling_index();
+    int partner = (k % 2 == parity) ? k + 1 : k - 1;
+
+    // action at own and partner coupling, and a random number for accept/reject.
+    // Evaluated on all ranks, action() may contain site loops
+    double mydata[3];
+    mydata[0] = action(couplings[k]);
+    mydata[1] = (partner >= 0 && partner < np) ? action(couplings[partner]) : 0;
+    mydata[2] = hila::random();
+
+    std::vector<double> data(3 * np);
+    if (hila::myrank() == 0 && !hila::check_input) {
+        MPI_Allgather(mydata, 3, MPI_DOUBLE, data.data(), 3, MPI_DOUBLE,
+                      hila::partitions.comm_between());
+    }
+    hila::broadcast(data);
+
+    // all ranks now do the same decisions
+    for (int i = parity; i + 1 < np; i += 2) {
+        int a = replica_at[i];
+        int b = replica_at[i + 1];
+        double dS = data[3 * a + 1] + data[3 * b + 1] - data[3 * a] - data[3 * b];
+
+        n_attempt[i]++;
+        // the lower coupling replica's random number decides
+        if (dS <= 0 || data[3 * a + 2] < exp(-dS)) {
+            n_accept[i]++;
+            replica_at[i] = b;
+            replica_at[i + 1] = a;
+            coupling_of[a] = i + 1;
+            coupling_of[b] = i;
+        }
+    }
+
+    n_exchange++;
+    update_statistics();
+
+    rex_timer.stop();
+
+    return coupling_index() != k;
+}
+
+void replica_exchange::update_statistics() {
+    int np = couplings.size();
+    for (int p = 0; p < np; p++) {
+        int k = coupling_of[p];
+        if (k == 0) {
+            // a round trip is completed when the replica returns to coupling 0
+            // after visiting the last one
+            if (direction[p] == -1 && trip_start[p] >= 0) {
+                n_trips[p]++;
+                trip_time[p] += n_exchange - trip_start[p];
+            }
+            if (direction[p] != 1)
+                trip_start[p] = n_exchange;
+            direction[p] = 1;
+        } else if (k == np - 1) {
+            direction[p] = -1;
+        }
+
+        if (direction[p] == 1)
+            n_up[k]++;
+        else if (direction[p] == -1)
+            n_down[k]++;
+    }
+}
+
+double replica_exchange::acceptance(int k) const {
+    if (k < 0 || k + 1 >= couplings.size() || n_attempt[k] == 0)
+        return 0;
+    return ((double)n_accept[k]) / n_attempt[k];
+}
+
+void replica_exchange::report() const {
+    int np = couplings.size();
+
+    hila::print_dashed_line("REPLICA EXCHANGE");
+    hila::out0 << n_exchange << " exchange steps, " << np << " couplings\n";
+    hila::out0 << "This partition is now at coupling " << coupling_index() << ": " << coupling()
+               << '\n';
+    hila::out0 << " index      coupling   acceptance(k,k+1)   up-fraction\n";
+    for (int k = 0; k < np; k++) {
+        hila::out0 << std::setw(6) << k << std::setw(14) << couplings[k];
+        if (k + 1 < np)
+            hila::out0 << std::setw(20) << acceptance(k);
+        else
+            hila::out0 << std::setw(20) << "";
+        int64_t nv = n_up[k] + n_down[k];
+        if (nv > 0)
+            hila::out0 << std::setw(14) << ((double)n_up[k]) / nv;
+        hila::out0 << '\n';
+    }
+
+    hila::out0 << " partition   round trips   mean round trip time\n";
+    int64_t trips = 0, time = 0;
+    for (int p = 0; p < np; p++) {
+        hila::out0 << std::setw(10) << p << std::setw(14) << n_trips[p];
+        if (n_trips[p] > 0)
+            hila::out0 << std::setw(23) << ((double)trip_time[p]) / n_trips[p];
+        hila::out0 << '\n';
+        trips += n_trips[p];
+        time += trip_time[p];
+    }
+    if (trips > 0)
+        hila::out0 << "Mean round trip time " << ((double)time) / trips << " exchange steps\n";
+    else
+        hila::out0 << "No completed round trips\n";
+
+    hila::print_dashed_line();
+}
+
+} // namespace hila
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file replica_exchange.h
+/// @brief Replica exchange (parallel tempering) between hila partitions
+/// @details
+/// Each partition (command line -partitions N) runs one replica of the system.
+/// The replicas exchange coupling parameters, not configurations: the partition
+/// keeps its own fields and only the coupling it uses changes.  Exchanges are
+/// attempted between neighbouring couplings, alternating the even and odd pairs,
+/// and accepted with probability  min(1, exp(-dS)), where
+///
+///     dS = S_a(c_j) + S_b(c_i) - S_a(c_i) - S_b(c_j)
+///
+/// is the action change when replica a at coupling c_i and replica b at c_j swap.
+/// Only rank 0 of each partition communicates, through
+/// hila::partitions.comm_between(), so an exchange costs one small allgather.
+///
+/// Usage:
+/// @code{.cpp}
+///     hila::replica_exchange rex({5.70, 5.72, 5.74, 5.76});  // one coupling per partition
+///     for (int traj = 0; traj < n_traj; traj++) {
+///         update(U, rex.coupling());
+///         // action linear in coupling: S = coupling * E
+///         rex.exchange(E(U));
+///         // or in general, give the action at any coupling c:
+///         //   rex.exchange([&](double c) { return action(U, c); });
+///     }
+///     rex.report();
+/// @endcode
+///
+/// Measurements from a partition belong to the coupling rex.coupling(), which
+/// changes in exchanges.  report() prints the swap acceptance of each coupling pair,
+/// the fraction of replicas moving "up" at each coupling and the round-trip times of
+/// the replicas (from the first coupling to the last and back).
+////////////////////////////////////////////////////////////////////////////////
+#ifndef REPLICA_EXCHANGE_H_
+#define REPLICA_EXCHANGE_H_
+
+#include <vector>
+#include <functional>
+
+namespace hila {
+
+class replica_exchange {
+  private:
+    std::vector<double> couplings;
+
+    // replica_at[k]: partition which has coupling k, and coupling_of[p] the inverse
+    std::vector<int> replica_at, coupling_of;
+
+    // statistics, for coupling pairs (k,k+1)
+    std::vector<int64_t> n_attempt, n_accept;
+
+    // direction of replicas: +1 if last visited coupling 0, -1 if last coupling, 0 neither
+    std::vector<int> direction;
+    // at each coupling, number of visits of replicas moving up / down
+    std::vector<int64_t> n_up, n_down;
+    // round trips: time of the last visit to coupling 0 and the completed round trips
+    std::vector<int64_t> trip_start, n_trips, trip_time;
+
+    int64_t n_exchange = 0;
+
+    void update_statistics();
+
+  public:
+    /// Couplings in increasing or decreasing order, one for each partition.
+    /// Partition p starts with coupling p.  All ranks must construct it
+    replica_exchange(const std::vector<double> &couplings);
+
+    /// coupling of this partition
+    double coupling() const {
+        return couplings[coupling_index()];
+    }
+
+    /// index of the coupling of this partition
+    int coupling_index() const;
+
+    /// Attempt exchanges.  The argument returns the action of the current configuration
+    /// at coupling c.  Must be called from all ranks of all partitions.
+    /// Returns true if this partition changed coupling.
+    bool exchange(const std::function<double(double)> &action);
+
+    /// Exchange with action S = coupling * E
+    bool exchange(double E) {
+        return exchange([=](double c) { return c * E; });
+    }
+
+    /// exchange acceptance of coupling pair (k, k+1)
+    double acceptance(int k) const;
+
+    /// print the statistics
+    void report() const;
+};
+
+} // namespace hila
+
+#endif